@@ -33,7 +33,7 @@
 
 import time
 import numpy as np
-from machine import Pin, PWM
+from machine import Pin, PWM, SPI
 
 class BaseLcd:
     def __init__(self, spi, dc, rst, cs, bl, bl_freq=1000):
@@ -61,6 +61,8 @@ class BaseLcd:
         self.CS_PIN.init(Pin.OUT, Pin.HIGH)
         #Initialize SPI
         self.SPI = spi
+        # CS and DC driven by the firmware around each write_display()
+        self.SPI.display_pins(self.CS_PIN, self.DC_PIN)
         # if self.SPI!=None :
         #     self.SPI.max_speed_hz = spi_freq
         #     self.SPI.mode = 0b00
@@ -113,18 +115,10 @@ class Lcd(BaseLcd):
     height = 240
 
     def command(self, cmd):
-        #self.digital_write(self.DC_PIN, self.GPIO.LOW)
-        self.CS_PIN.value(Pin.LOW)
-        self.DC_PIN.value(Pin.LOW)
-        self.spi_writebyte([cmd])
-        self.CS_PIN.value(Pin.HIGH)
+        self.SPI.write_display([(SPI.COMMAND, [cmd])])
 
     def data(self, val):
-        #self.digital_write(self.DC_PIN, self.GPIO.HIGH)
-        self.CS_PIN.value(Pin.LOW)
-        self.DC_PIN.value(Pin.HIGH)
-        self.spi_writebyte([val])
-        self.CS_PIN.value(Pin.HIGH)
+        self.SPI.write_display([(SPI.DATA, [val])])
 
     def reset(self):
         """Reset the display"""
@@ -378,22 +372,17 @@ class Lcd(BaseLcd):
         self.command(0x29)
         time.sleep(0.02)
 
-    def SetWindows(self, Xstart, Ystart, Xend, Yend):
-        #set the X coordinates
-        self.command(0x2A)
-        self.data(0x00)               #Set the horizontal starting point to the high octet
-        self.data(Xstart)      #Set the horizontal starting point to the low octet
-        self.data(0x00)               #Set the horizontal end to the high octet
-        self.data(Xend - 1) #Set the horizontal end to the low octet
-
-        #set the Y coordinates
-        self.command(0x2B)
-        self.data(0x00)
-        self.data(Ystart)
-        self.data(0x00)
-        self.data(Yend - 1)
+    def _window_entries(self, Xstart, Ystart, Xend, Yend):
+        return [
+            (SPI.COMMAND, [0x2A]),                      #set the X coordinates
+            (SPI.DATA, [0x00, Xstart, 0x00, Xend - 1]), #start and end, high octet first
+            (SPI.COMMAND, [0x2B]),                      #set the Y coordinates
+            (SPI.DATA, [0x00, Ystart, 0x00, Yend - 1]),
+            (SPI.COMMAND, [0x2C]),                      #memory write
+        ]
 
-        self.command(0x2C)
+    def SetWindows(self, Xstart, Ystart, Xend, Yend):
+        self.SPI.write_display(self._window_entries(Xstart, Ystart, Xend, Yend))
 
     def ShowImage(self,Image):
         """Set buffer to value of Python Imaging Library image."""
@@ -402,29 +391,16 @@ class Lcd(BaseLcd):
         if imwidth != self.width or imheight != self.height:
             raise ValueError('Image must be same dimensions as display \
                 ({0}x{1}).' .format(self.width, self.height))
-        img = self.np.asarray(Image)
-        pix = self.np.zeros((self.width,self.height,2), dtype = self.np.uint8)
-        pix[...,[0]] = self.np.add(self.np.bitwise_and(img[...,[0]],0xF8),self.np.right_shift(img[...,[1]],5))
-        pix[...,[1]] = self.np.add(self.np.bitwise_and(self.np.left_shift(img[...,[1]],3),0xE0),self.np.right_shift(img[...,[2]],3))
-        pix = pix.flatten().tolist()
-        self.SetWindows ( 0, 0, self.width, self.height)
-        #self.digital_write(self.DC_PIN,self.GPIO.HIGH)
-        self.CS_PIN.value(Pin.LOW)
-        self.DC_PIN.value(Pin.HIGH)
-        #for i in range(0,len(pix),4096):
-        #    self.spi_writebyte(pix[i:i+4096])
-        self.spi_writebyte(pix)
-        self.CS_PIN.value(Pin.HIGH)
+        img = self.np.asarray(Image).astype(self.np.uint16)
+        # RGB565 as uint16, sent MSB first by the 16-bit SPI frames
+        pix = ((img[...,0] & 0xF8) << 8) | ((img[...,1] & 0xFC) << 3) | (img[...,2] >> 3)
+        # Window and pixels: one report and one CDC stream
+        self.SPI.write_display(self._window_entries(0, 0, self.width, self.height),
+                               data=pix.astype(self.np.uint16), frame16=True)
 
     def clear(self):
         """Clear contents of image buffer"""
-        _buffer = [0xff]*(self.width * self.height * 2)
-        self.SetWindows ( 0, 0, self.width, self.height)
-        #self.digital_write(self.DC_PIN,self.GPIO.HIGH)
-        self.CS_PIN.value(Pin.LOW)
-        self.DC_PIN.value(Pin.HIGH)
-        #for i in range(0,len(_buffer),4096):
-        #    self.spi_writebyte(_buffer[i:i+4096])
-        self.spi_writebyte(_buffer)
-        self.CS_PIN.value(Pin.HIGH)
+        _buffer = self.np.full(self.width * self.height, 0xFFFF, dtype=self.np.uint16)
+        self.SPI.write_display(self._window_entries(0, 0, self.width, self.height),
+                               data=_buffer, frame16=True)
 
@@ -163,6 +163,12 @@ class _SSD1306(framebuf.FrameBuffer):
 
     def show(self):
         """Update the display"""
+        for cmd in self._show_cmds():
+            self.write_cmd(cmd)
+        self.write_framebuf()
+
+    def _show_cmds(self):
+        """Commands setting the window written by show()"""
         xpos0 = 0
         xpos1 = self.width - 1
         if self.width == 64:
@@ -173,13 +179,7 @@ class _SSD1306(framebuf.FrameBuffer):
             # displays with width of 72 pixels are shifted by 28
             xpos0 += 28
             xpos1 += 28
-        self.write_cmd(SET_COL_ADDR)
-        self.write_cmd(xpos0)
-        self.write_cmd(xpos1)
-        self.write_cmd(SET_PAGE_ADDR)
-        self.write_cmd(0)
-        self.write_cmd(self.pages - 1)
-        self.write_framebuf()
+        return [SET_COL_ADDR, xpos0, xpos1, SET_PAGE_ADDR, 0, self.pages - 1]
 
 
 class SSD1306_I2C(_SSD1306):
@@ -269,6 +269,8 @@ class SSD1306_SPI(_SSD1306):
         self.spi_device = spi
         self.dc_pin = dc
         self.cs_pin = cs
+        # CS and DC driven by the firmware around each write_display()
+        self.spi_device.display_pins(cs, dc)
         self.buffer = bytearray((height // 8) * width)
         super().__init__(
             memoryview(self.buffer),
@@ -280,18 +282,12 @@ class SSD1306_SPI(_SSD1306):
 
     def write_cmd(self, cmd):
         """Send a command to the SPI device"""
-        self.dc_pin.value(0)
-        #with self.spi_device as spi:
-        #    spi.write(bytearray([cmd]))
-        self.cs_pin.value(0)
-        self.spi_device.write(bytearray([cmd]))
-        self.cs_pin.value(1)
+        self.spi_device.write_display([(self.spi_device.COMMAND, [cmd])])
 
     def write_framebuf(self):
         """write to the frame buffer via SPI"""
-        self.dc_pin.value(1)
-        #with self.spi_device as spi:
-        #    spi.write(self.buffer)
-        self.cs_pin.value(0)
-        self.spi_device.write(self.buffer)
-        self.cs_pin.value(1)
+        self.spi_device.write_display([], data=self.buffer)
+
+    def show(self):
+        """Update the display: window commands and frame buffer in one report and one CDC stream"""
+        self.spi_device.write_display([(self.spi_device.COMMAND, self._show_cmds())], data=self.buffer)
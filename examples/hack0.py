@@ -13,7 +13,7 @@ from enum import Enum
 from icecream import ic
 
 VID_U2IF_PICO = 0xCAFE
-PID_U2IF_PICO = 0x4005
+PID_U2IF_PICO = 0x4015
 CTRL_SIGS: dict = {
     's1_on': u2if.GP10,
     's2_on': u2if.GP11,
@@ -1,6 +1,7 @@
 from machine import I2C, SPI, u2if, Pin
 
 # Run a scan on the second I2C (i2_index=1)
+# The firmware probes the addresses (0x08 to 0x77 by default) and returns them in one report
 
 
 i2c = I2C(i2c_index=0, frequency=400000) # , pullup=True
@@ -0,0 +1,14 @@
+from machine import I2CTarget
+
+# I2C1 emulates a peripheral at address 0x42: the firmware answers the bus master from a map of 256 registers
+# (the first byte written selects the register, auto-increment). WHO_AM_I (0x0F) is read-only.
+
+
+target = I2CTarget(i2c_index=1, addr=0x42, read_only=[0x0F])  # , pullup=True
+target.write_registers(0x0F, b"\xA5")
+target.write_registers(0x10, bytes([0x00, 0x7F]))  # status, value
+
+while True:
+    nb_writes, changed = target.changes(wait=True)
+    print("%d write(s), registers %s: %s" % (nb_writes, [hex(r) for r in changed],
+                                             target.read_registers(0x20, 4).hex()))
@@ -0,0 +1,803 @@
+#include "HostPlatform.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/spi.h"
+#include "hardware/uart.h"
+#include "pico/time.h"
+
+//--------------------------------------------------------------------+
+// IRQ
+//--------------------------------------------------------------------+
+
+static irq_handler_t irqHandlers[NUM_IRQS];
+static std::vector<irq_handler_t> irqSharedHandlers[NUM_IRQS];
+static bool irqEnabled[NUM_IRQS];
+
+extern "C" void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    hard_assert(irqSharedHandlers[num].empty());
+    irqHandlers[num] = handler;
+}
+
+extern "C" void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    (void)order_priority;
+    hard_assert(irqHandlers[num] == nullptr);
+    irqSharedHandlers[num].push_back(handler);
+}
+
+extern "C" void irq_remove_handler(uint num, irq_handler_t handler) {
+    if(irqHandlers[num] == handler)
+        irqHandlers[num] = nullptr;
+    std::vector<irq_handler_t> &shared = irqSharedHandlers[num];
+    shared.erase(std::remove(shared.begin(), shared.end(), handler), shared.end());
+}
+
+extern "C" void irq_set_enabled(uint num, bool enabled) {
+    irqEnabled[num] = enabled;
+}
+
+extern "C" bool irq_is_enabled(uint num) {
+    return irqEnabled[num];
+}
+
+void HostPlatform::raiseIrq(uint num) {
+    if(!irqEnabled[num])
+        return;
+    if(irqHandlers[num] != nullptr)
+        runIrq(irqHandlers[num]);
+    for(irq_handler_t handler : irqSharedHandlers[num]) {
+        runIrq(handler);
+    }
+}
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+
+struct GpioPad {
+    bool out;
+    bool value;
+    bool pullUp;
+    uint32_t irqEvents;
+};
+
+static GpioPad gpioPads[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpioCallback = nullptr;
+
+extern "C" void gpio_init(uint gpio) {
+    gpio_set_dir(gpio, false);
+    gpio_put(gpio, false);
+}
+
+extern "C" void gpio_init_mask(uint gpio_mask) {
+    for(uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if(gpio_mask & (1u << gpio))
+            gpio_init(gpio);
+    }
+}
+
+extern "C" void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+extern "C" void gpio_set_dir(uint gpio, bool out) {
+    if(gpio < NUM_BANK0_GPIOS)
+        gpioPads[gpio].out = out;
+}
+
+extern "C" void gpio_set_dir_out_masked(uint32_t mask) {
+    for(uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if(mask & (1u << gpio))
+            gpio_set_dir(gpio, true);
+    }
+}
+
+extern "C" void gpio_pull_up(uint gpio) {
+    if(gpio < NUM_BANK0_GPIOS)
+        gpioPads[gpio].pullUp = true;
+}
+
+extern "C" void gpio_pull_down(uint gpio) {
+    if(gpio < NUM_BANK0_GPIOS)
+        gpioPads[gpio].pullUp = false;
+}
+
+extern "C" void gpio_disable_pulls(uint gpio) {
+    gpio_pull_down(gpio);
+}
+
+extern "C" void gpio_set_outover(uint gpio, uint value) {
+    (void)gpio;
+    (void)value;
+}
+
+extern "C" bool gpio_get(uint gpio) {
+    if(gpio >= NUM_BANK0_GPIOS)
+        return false;
+    return gpioPads[gpio].out ? gpioPads[gpio].value : gpioPads[gpio].pullUp;
+}
+
+extern "C" uint32_t gpio_get_all(void) {
+    uint32_t values = 0;
+    for(uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if(gpio_get(gpio))
+            values |= 1u << gpio;
+    }
+    return values;
+}
+
+// Edges of an output pin raise its IRQ
+extern "C" void gpio_put(uint gpio, bool value) {
+    if(gpio >= NUM_BANK0_GPIOS)
+        return;
+    const bool previous = gpio_get(gpio);
+    gpioPads[gpio].value = value;
+    const bool current = gpio_get(gpio);
+    const uint32_t event = current ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if(previous != current && (gpioPads[gpio].irqEvents & event) && gpioCallback != nullptr) {
+        HostPlatform::disableInterrupts();
+        gpioCallback(gpio, event);
+        HostPlatform::enableInterrupts();
+        HostPlatform::wakeCores();
+    }
+}
+
+extern "C" void gpio_put_masked(uint32_t mask, uint32_t value) {
+    for(uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if(mask & (1u << gpio))
+            gpio_put(gpio, value & (1u << gpio));
+    }
+}
+
+extern "C" void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if(gpio >= NUM_BANK0_GPIOS)
+        return;
+    if(enabled)
+        gpioPads[gpio].irqEvents |= events;
+    else
+        gpioPads[gpio].irqEvents &= ~events;
+}
+
+extern "C" void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, events, enabled);
+    if(enabled)
+        gpioCallback = callback;
+}
+
+//--------------------------------------------------------------------+
+// I2C
+//--------------------------------------------------------------------+
+
+i2c_inst_t i2c0_inst = {0, 0, false};
+i2c_inst_t i2c1_inst = {1, 0, false};
+
+// Memory of each bus, its pointer is set by the first byte written after a stop
+struct I2cMemory {
+    uint8_t data[256];
+    uint8_t pointer;
+    bool pointerSet;
+};
+
+static I2cMemory i2cMemories[2];
+
+// Transaction of each bus: started by an acknowledged address, ended by a stop
+struct I2cBus {
+    bool active;
+    bool reading;
+    int target; // I2C in slave mode addressed, -1: the memory
+};
+
+static I2cBus i2cBuses[2] = {{false, false, -1}, {false, false, -1}};
+static i2c_hw_t i2cHws[2];
+
+static void dmaPacedWrite(uint rxDreq, uint8_t data);
+
+static const uint32_t I2C_CON_RESET = I2C_IC_CON_MASTER_MODE_BITS | I2C_IC_CON_IC_SLAVE_DISABLE_BITS;
+
+host_i2c_hw::host_i2c_hw()
+    : con(I2C_CON_RESET),
+      enable(0),
+      tar(0x55),
+      sar(0x55),
+      intr_mask(0),
+      data_cmd(),
+      rxflr(data_cmd),
+      raw_intr_stat(I2C_IC_RAW_INTR_STAT_TX_EMPTY_BITS), // commands run as soon as they are written
+      intr_stat(raw_intr_stat, intr_mask, data_cmd),
+      tx_abrt_source(0),
+      clr_intr(raw_intr_stat, I2C_IC_RAW_INTR_STAT_STOP_DET_BITS | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_RAW_INTR_STAT_RD_REQ_BITS),
+      clr_tx_abrt(raw_intr_stat, I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS),
+      clr_stop_det(raw_intr_stat, I2C_IC_RAW_INTR_STAT_STOP_DET_BITS),
+      clr_rd_req(raw_intr_stat, I2C_IC_RAW_INTR_STAT_RD_REQ_BITS) {
+}
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    return &i2cHws[i2c->index];
+}
+
+extern "C" uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return i2c->index == 0 ? (is_tx ? DREQ_I2C0_TX : DREQ_I2C0_RX) : (is_tx ? DREQ_I2C1_TX : DREQ_I2C1_RX);
+}
+
+// I2C in slave mode at the address on the other bus, -1 if none
+static int i2cTarget(uint index, uint32_t address) {
+    const uint other = index ^ 1;
+    const i2c_hw_t &hw = i2cHws[other];
+    const uint baudrate = other == 0 ? i2c0_inst.baudrate : i2c1_inst.baudrate;
+    if(baudrate == 0 || hw.enable == 0 || (hw.con & I2C_IC_CON_MASTER_MODE_BITS) || hw.sar != address)
+        return -1;
+    return static_cast<int>(other);
+}
+
+// Byte of a transaction addressed to an I2C in slave mode: its IRQ answers each read request (clock stretching),
+// a request not answered reads 0xFF
+static uint8_t i2cTargetByte(uint target, bool read, uint8_t data) {
+    i2c_hw_t &hw = i2cHws[target];
+    if(read) {
+        hw.data_cmd.txData = -1;
+        hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_RD_REQ_BITS;
+    } else {
+        hw.data_cmd.rxFifo.push_back(data | (hw.data_cmd.firstDataByte ? I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS : 0));
+        hw.data_cmd.firstDataByte = false;
+    }
+    HostPlatform::raiseIrq(target == 0 ? I2C0_IRQ : I2C1_IRQ);
+    return read && hw.data_cmd.txData >= 0 ? static_cast<uint8_t>(hw.data_cmd.txData) : 0xFF;
+}
+
+// IC_DATA_CMD command written by a DMA channel. An address not acknowledged aborts the transfer (STOP sent), the
+// next commands are dropped until IC_CLR_TX_ABRT is read.
+static void i2cCommand(uint index, uint32_t command) {
+    i2c_hw_t &hw = i2cHws[index];
+    I2cBus &bus = i2cBuses[index];
+    I2cMemory &memory = i2cMemories[index];
+    if(hw.raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)
+        return;
+    const bool read = (command & I2C_IC_DATA_CMD_CMD_BITS) != 0;
+    if(!bus.active || (command & I2C_IC_DATA_CMD_RESTART_BITS) || read != bus.reading) {
+        // Start or repeated start: address phase
+        const uint baudrate = index == 0 ? i2c0_inst.baudrate : i2c1_inst.baudrate;
+        const int target = baudrate == 0 ? -1 : i2cTarget(index, hw.tar);
+        if(baudrate == 0 || (target < 0 && hw.tar != HOST_I2C_MEMORY_ADDR)) {
+            bus.active = false;
+            memory.pointerSet = false;
+            hw.tx_abrt_source = I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS;
+            hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+            return;
+        }
+        bus.active = true;
+        bus.reading = read;
+        bus.target = target;
+        if(target >= 0)
+            i2cHws[target].data_cmd.firstDataByte = true;
+    }
+    if(bus.target >= 0) {
+        const uint8_t data = i2cTargetByte(static_cast<uint>(bus.target), read, static_cast<uint8_t>(command));
+        if(read)
+            dmaPacedWrite(index == 0 ? DREQ_I2C0_RX : DREQ_I2C1_RX, data);
+    } else if(read) {
+        dmaPacedWrite(index == 0 ? DREQ_I2C0_RX : DREQ_I2C1_RX, memory.data[memory.pointer++]);
+        memory.pointerSet = false;
+    } else if(!memory.pointerSet) {
+        memory.pointer = static_cast<uint8_t>(command);
+        memory.pointerSet = true;
+    } else {
+        memory.data[memory.pointer++] = static_cast<uint8_t>(command);
+    }
+    if(command & I2C_IC_DATA_CMD_STOP_BITS) {
+        bus.active = false;
+        memory.pointerSet = false;
+        hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+        if(bus.target >= 0) {
+            i2cHws[bus.target].raw_intr_stat |= I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+            HostPlatform::raiseIrq(bus.target == 0 ? I2C0_IRQ : I2C1_IRQ);
+        }
+    }
+}
+
+extern "C" uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    i2c_deinit(i2c); // master mode
+    i2cHws[i2c->index].enable = 1;
+    i2c->restart_on_next = false;
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+extern "C" void i2c_deinit(i2c_inst_t *i2c) {
+    // Reset of the block
+    i2c_hw_t &hw = i2cHws[i2c->index];
+    i2c->baudrate = 0;
+    hw.con = I2C_CON_RESET;
+    hw.enable = 0;
+    hw.intr_mask = 0;
+    hw.data_cmd.rxFifo.clear();
+}
+
+extern "C" void i2c_set_slave_mode(i2c_inst_t *i2c, bool slave, uint8_t addr) {
+    i2c_hw_t &hw = i2cHws[i2c->index];
+    hw.enable = 0;
+    if(slave) {
+        hw.con = hw.con & ~(I2C_IC_CON_MASTER_MODE_BITS | I2C_IC_CON_IC_SLAVE_DISABLE_BITS);
+        hw.sar = addr;
+    } else {
+        hw.con = hw.con | I2C_IC_CON_MASTER_MODE_BITS | I2C_IC_CON_IC_SLAVE_DISABLE_BITS;
+    }
+    hw.enable = 1;
+}
+
+extern "C" uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+extern "C" int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us) {
+    (void)timeout_us;
+    I2cMemory &memory = i2cMemories[i2c->index];
+    if(i2c->baudrate == 0 || addr != HOST_I2C_MEMORY_ADDR)
+        return PICO_ERROR_GENERIC;
+    for(size_t it = 0; it < len; it++) {
+        if(!memory.pointerSet) {
+            memory.pointer = src[it];
+            memory.pointerSet = true;
+        } else {
+            memory.data[memory.pointer++] = src[it];
+        }
+    }
+    i2c->restart_on_next = nostop;
+    if(!nostop)
+        memory.pointerSet = false;
+    return static_cast<int>(len);
+}
+
+extern "C" int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+    (void)timeout_us;
+    I2cMemory &memory = i2cMemories[i2c->index];
+    if(i2c->baudrate == 0 || addr != HOST_I2C_MEMORY_ADDR)
+        return PICO_ERROR_GENERIC;
+    for(size_t it = 0; it < len; it++) {
+        dst[it] = memory.data[memory.pointer++];
+    }
+    i2c->restart_on_next = nostop;
+    memory.pointerSet = false;
+    return static_cast<int>(len);
+}
+
+extern "C" int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    return i2c_write_timeout_us(i2c, addr, src, len, nostop, 0);
+}
+
+extern "C" int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    return i2c_read_timeout_us(i2c, addr, dst, len, nostop, 0);
+}
+
+//--------------------------------------------------------------------+
+// SPI
+//--------------------------------------------------------------------+
+
+struct spi_inst {
+    uint index;
+    uint baudrate;
+    spi_hw_t hw;
+};
+
+static spi_inst spiInsts[2] = {{0, 0, {}}, {1, 0, {}}};
+spi_inst_t * const host_spi0 = &spiInsts[0];
+spi_inst_t * const host_spi1 = &spiInsts[1];
+
+extern "C" spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+    return &spi->hw;
+}
+
+extern "C" uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+    return spi->index == 0 ? (is_tx ? DREQ_SPI0_TX : DREQ_SPI0_RX) : (is_tx ? DREQ_SPI1_TX : DREQ_SPI1_RX);
+}
+
+extern "C" uint spi_init(spi_inst_t *spi, uint baudrate) {
+    return spi_set_baudrate(spi, baudrate);
+}
+
+extern "C" void spi_deinit(spi_inst_t *spi) {
+    spi->baudrate = 0;
+}
+
+extern "C" uint spi_set_baudrate(spi_inst_t *spi, uint baudrate) {
+    spi->baudrate = baudrate;
+    return baudrate;
+}
+
+extern "C" uint spi_get_baudrate(const spi_inst_t *spi) {
+    return spi->baudrate;
+}
+
+extern "C" uint spi_get_index(const spi_inst_t *spi) {
+    return spi->index;
+}
+
+extern "C" void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+    (void)spi;
+    (void)data_bits;
+    (void)cpol;
+    (void)cpha;
+    (void)order;
+}
+
+extern "C" int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len) {
+    (void)spi;
+    (void)src;
+    return static_cast<int>(len);
+}
+
+extern "C" int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+    (void)spi;
+    memset(dst, repeated_tx_data, len);
+    return static_cast<int>(len);
+}
+
+extern "C" int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len) {
+    (void)spi;
+    memmove(dst, src, len);
+    return static_cast<int>(len);
+}
+
+extern "C" int spi_write16_read16_blocking(spi_inst_t *spi, const uint16_t *src, uint16_t *dst, size_t len) {
+    (void)spi;
+    memmove(dst, src, len * sizeof(uint16_t));
+    return static_cast<int>(len);
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+
+// dma_channel_config.ctrl
+static const uint32_t DMA_CTRL_SIZE_MASK = 0x3;
+static const uint32_t DMA_CTRL_READ_INCR = 1u << 2;
+static const uint32_t DMA_CTRL_WRITE_INCR = 1u << 3;
+static const uint DMA_CTRL_DREQ_LSB = 8;
+static const uint32_t DMA_CTRL_DREQ_MASK = 0x3fu << DMA_CTRL_DREQ_LSB;
+
+struct DmaChannel {
+    bool claimed;
+    uint32_t ctrl;
+    const volatile uint8_t *readAddr;
+    volatile uint8_t *writeAddr;
+    uint32_t count;
+    std::atomic<bool> busy;
+    bool irq0;
+    bool irq1;
+    alarm_id_t alarm;
+};
+
+static dma_hw_t dmaHw;
+dma_hw_t * const host_dma_hw = &dmaHw;
+static DmaChannel dmaChannels[NUM_DMA_CHANNELS];
+
+static inline uint dmaDreq(const DmaChannel &channel) {
+    return (channel.ctrl & DMA_CTRL_DREQ_MASK) >> DMA_CTRL_DREQ_LSB;
+}
+
+static inline uint dmaElementSize(const DmaChannel &channel) {
+    return 1u << (channel.ctrl & DMA_CTRL_SIZE_MASK);
+}
+
+// Called with interrupts disabled
+static void dmaComplete(uint index) {
+    DmaChannel &channel = dmaChannels[index];
+    channel.alarm = 0;
+    channel.busy = false;
+    if(channel.irq0) {
+        dmaHw.ints0.set(1u << index);
+        HostPlatform::raiseIrq(DMA_IRQ_0);
+    }
+    if(channel.irq1) {
+        dmaHw.ints1.set(1u << index);
+        HostPlatform::raiseIrq(DMA_IRQ_1);
+    }
+}
+
+// Byte received by a SPI (MISO looped back) or an I2C, written by its RX channel if any (else lost as an RX FIFO overrun)
+static void dmaPacedWrite(uint rxDreq, uint8_t data) {
+    for(uint index = 0; index < NUM_DMA_CHANNELS; index++) {
+        DmaChannel &channel = dmaChannels[index];
+        if(!channel.busy || dmaDreq(channel) != rxDreq || channel.count == 0)
+            continue;
+        *channel.writeAddr = data;
+        if(channel.ctrl & DMA_CTRL_WRITE_INCR)
+            channel.writeAddr += dmaElementSize(channel);
+        if(--channel.count == 0)
+            dmaComplete(index);
+        return;
+    }
+}
+
+static int64_t dmaAlarmCallback(alarm_id_t id, void *user_data) {
+    (void)id;
+    const uint index = static_cast<uint>(reinterpret_cast<uintptr_t>(user_data));
+    DmaChannel &channel = dmaChannels[index];
+    const uint dreq = dmaDreq(channel);
+    const uint size = dmaElementSize(channel);
+    for(; channel.count > 0; channel.count--) {
+        if(dreq == DREQ_SPI0_TX || dreq == DREQ_SPI1_TX) {
+            dmaPacedWrite(dreq + 1, *channel.readAddr);
+        } else if(dreq == DREQ_I2C0_TX || dreq == DREQ_I2C1_TX) {
+            uint32_t command = 0;
+            memcpy(&command, const_cast<const uint8_t*>(channel.readAddr), size);
+            i2cCommand(dreq == DREQ_I2C0_TX ? 0 : 1, command);
+        } else if(dreq == DREQ_FORCE) {
+            for(uint byte = 0; byte < size; byte++) {
+                channel.writeAddr[byte] = channel.readAddr[byte];
+            }
+        }
+        if(channel.ctrl & DMA_CTRL_READ_INCR)
+            channel.readAddr += size;
+        if(channel.ctrl & DMA_CTRL_WRITE_INCR)
+            channel.writeAddr += size;
+    }
+    dmaComplete(index);
+    return 0;
+}
+
+extern "C" int dma_claim_unused_channel(bool required) {
+    for(uint index = 0; index < NUM_DMA_CHANNELS; index++) {
+        if(!dmaChannels[index].claimed) {
+            dmaChannels[index].claimed = true;
+            return static_cast<int>(index);
+        }
+    }
+    if(required)
+        panic("No DMA channels are available");
+    return -1;
+}
+
+extern "C" void dma_channel_unclaim(uint channel) {
+    dmaChannels[channel].claimed = false;
+}
+
+extern "C" dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    dma_channel_config config;
+    config.ctrl = DMA_SIZE_32 | DMA_CTRL_READ_INCR | (static_cast<uint32_t>(DREQ_FORCE) << DMA_CTRL_DREQ_LSB);
+    return config;
+}
+
+extern "C" void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->ctrl = (c->ctrl & ~DMA_CTRL_SIZE_MASK) | size;
+}
+
+extern "C" void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->ctrl = incr ? (c->ctrl | DMA_CTRL_READ_INCR) : (c->ctrl & ~DMA_CTRL_READ_INCR);
+}
+
+extern "C" void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->ctrl = incr ? (c->ctrl | DMA_CTRL_WRITE_INCR) : (c->ctrl & ~DMA_CTRL_WRITE_INCR);
+}
+
+extern "C" void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    c->ctrl = (c->ctrl & ~DMA_CTRL_DREQ_MASK) | (dreq << DMA_CTRL_DREQ_LSB);
+}
+
+extern "C" void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                                      const volatile void *read_addr, uint transfer_count, bool trigger) {
+    dmaChannels[channel].ctrl = config->ctrl;
+    dma_channel_set_write_addr(channel, write_addr, false);
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, trigger);
+}
+
+extern "C" void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    dmaChannels[channel].readAddr = static_cast<const volatile uint8_t*>(read_addr);
+    if(trigger)
+        dma_channel_start(channel);
+}
+
+extern "C" void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+    dmaChannels[channel].writeAddr = static_cast<volatile uint8_t*>(write_addr);
+    if(trigger)
+        dma_channel_start(channel);
+}
+
+extern "C" void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    dmaChannels[channel].count = trans_count;
+    if(trigger)
+        dma_channel_start(channel);
+}
+
+extern "C" void dma_channel_start(uint index) {
+    HostPlatform::disableInterrupts();
+    DmaChannel &channel = dmaChannels[index];
+    const uint dreq = dmaDreq(channel);
+    channel.busy = true;
+    if(channel.count == 0) {
+        dmaComplete(index);
+    } else if(dreq == DREQ_SPI0_RX || dreq == DREQ_SPI1_RX || dreq == DREQ_I2C0_RX || dreq == DREQ_I2C1_RX) {
+        // Paced by the TX channel of the same SPI or I2C
+    } else {
+        // Bus time of the SPI and I2C transfers, the other ones are immediate
+        uint64_t durationUs = 1;
+        if(dreq == DREQ_SPI0_TX || dreq == DREQ_SPI1_TX) {
+            const uint baudrate = std::max(spiInsts[dreq == DREQ_SPI0_TX ? 0 : 1].baudrate, 1u);
+            durationUs = std::max<uint64_t>(1, static_cast<uint64_t>(channel.count) * dmaElementSize(channel) * 8 * 1000000 / baudrate);
+        } else if(dreq == DREQ_I2C0_TX || dreq == DREQ_I2C1_TX) {
+            // 9 clocks per command
+            const uint baudrate = std::max((dreq == DREQ_I2C0_TX ? i2c0_inst : i2c1_inst).baudrate, 1u);
+            durationUs = std::max<uint64_t>(1, static_cast<uint64_t>(channel.count) * 9 * 1000000 / baudrate);
+        }
+        channel.alarm = add_alarm_in_us(durationUs, dmaAlarmCallback, reinterpret_cast<void*>(static_cast<uintptr_t>(index)), true);
+    }
+    HostPlatform::enableInterrupts();
+}
+
+extern "C" void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, true);
+}
+
+extern "C" void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count) {
+    dma_channel_set_write_addr(channel, write_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, true);
+}
+
+extern "C" bool dma_channel_is_busy(uint channel) {
+    return dmaChannels[channel].busy;
+}
+
+extern "C" void dma_channel_abort(uint index) {
+    HostPlatform::disableInterrupts();
+    DmaChannel &channel = dmaChannels[index];
+    if(channel.alarm != 0)
+        cancel_alarm(channel.alarm);
+    channel.alarm = 0;
+    channel.busy = false;
+    HostPlatform::enableInterrupts();
+}
+
+extern "C" void dma_channel_wait_for_finish_blocking(uint channel) {
+    while(dma_channel_is_busy(channel)) {
+        std::this_thread::yield();
+    }
+}
+
+extern "C" void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    dmaChannels[channel].irq0 = enabled;
+}
+
+extern "C" void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+    dmaChannels[channel].irq1 = enabled;
+}
+
+//--------------------------------------------------------------------+
+// UART
+//--------------------------------------------------------------------+
+
+struct uart_inst {
+    uint index;
+    uint baudrate;
+    bool rxIrqEnabled;
+    std::deque<uint8_t> rx;
+};
+
+static const size_t UART_RX_SIZE = 4096; // loopback wire and FIFO
+static uart_inst uartInsts[2] = {{0, 0, false, {}}, {1, 0, false, {}}};
+uart_inst_t * const host_uart0 = &uartInsts[0];
+uart_inst_t * const host_uart1 = &uartInsts[1];
+
+static void raiseUartIrq(uart_inst_t *uart) {
+    if(uart->rxIrqEnabled && uart_is_readable(uart))
+        HostPlatform::raiseIrq(uart->index == 0 ? UART0_IRQ : UART1_IRQ);
+}
+
+extern "C" uint uart_init(uart_inst_t *uart, uint baudrate) {
+    HostPlatform::disableInterrupts();
+    uart->baudrate = baudrate;
+    uart->rx.clear();
+    HostPlatform::enableInterrupts();
+    return baudrate;
+}
+
+extern "C" void uart_deinit(uart_inst_t *uart) {
+    uart->baudrate = 0;
+}
+
+extern "C" uint uart_get_index(uart_inst_t *uart) {
+    return uart->index;
+}
+
+extern "C" void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data) {
+    (void)tx_needs_data;
+    uart->rxIrqEnabled = rx_has_data;
+    raiseUartIrq(uart);
+}
+
+extern "C" bool uart_is_readable(uart_inst_t *uart) {
+    HostPlatform::disableInterrupts();
+    const bool readable = !uart->rx.empty();
+    HostPlatform::enableInterrupts();
+    return readable;
+}
+
+extern "C" void uart_putc_raw(uart_inst_t *uart, char c) {
+    HostPlatform::disableInterrupts();
+    if(uart->baudrate != 0 && uart->rx.size() < UART_RX_SIZE)
+        uart->rx.push_back(static_cast<uint8_t>(c));
+    HostPlatform::enableInterrupts();
+    raiseUartIrq(uart);
+}
+
+extern "C" char uart_getc(uart_inst_t *uart) {
+    HostPlatform::disableInterrupts();
+    uint8_t c = 0;
+    if(!uart->rx.empty()) {
+        c = uart->rx.front();
+        uart->rx.pop_front();
+    }
+    HostPlatform::enableInterrupts();
+    return static_cast<char>(c);
+}
+
+//--------------------------------------------------------------------+
+// PWM, ADC, clocks
+//--------------------------------------------------------------------+
+
+pwm_hw_t host_pwm_hw = {
+    {
+        {0, 0x10, 0, 0, 0xFFFF}, {0, 0x10, 0, 0, 0xFFFF}, {0, 0x10, 0, 0, 0xFFFF}, {0, 0x10, 0, 0, 0xFFFF},
+        {0, 0x10, 0, 0, 0xFFFF}, {0, 0x10, 0, 0, 0xFFFF}, {0, 0x10, 0, 0, 0xFFFF}, {0, 0x10, 0, 0, 0xFFFF}
+    },
+    0
+};
+
+extern "C" void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+    const uint shift = chan == PWM_CHAN_B ? PWM_CH0_CC_B_LSB : PWM_CH0_CC_A_LSB;
+    pwm_hw->slice[slice_num].cc = (pwm_hw->slice[slice_num].cc & ~(0xFFFFu << shift)) | (static_cast<uint32_t>(level) << shift);
+}
+
+extern "C" void pwm_set_enabled(uint slice_num, bool enabled) {
+    pwm_hw->slice[slice_num].csr = enabled ? 1 : 0;
+    if(enabled)
+        pwm_hw->en |= 1u << slice_num;
+    else
+        pwm_hw->en &= ~(1u << slice_num);
+}
+
+static const uint ADC_NB_INPUTS = 5;
+static bool adcInputs[ADC_NB_INPUTS];
+static uint adcSelectedInput = 0;
+
+extern "C" void adc_init(void) {
+    adcSelectedInput = 0;
+}
+
+extern "C" void adc_gpio_init(uint gpio) {
+    if(gpio >= 26 && gpio < 26 + ADC_NB_INPUTS - 1)
+        adcInputs[gpio - 26] = true;
+}
+
+extern "C" void adc_select_input(uint input) {
+    adcSelectedInput = std::min(input, ADC_NB_INPUTS - 1);
+}
+
+extern "C" uint16_t adc_read(void) {
+    return adcInputs[adcSelectedInput] ? 0x800 : 0;
+}
+
+extern "C" uint32_t clock_get_hz(enum clock_index clk_index) {
+    switch(clk_index) {
+        case clk_sys: return 125000000;
+        case clk_peri: return 125000000;
+        case clk_usb: return 48000000;
+        case clk_adc: return 48000000;
+        case clk_ref: return 12000000;
+        default: return 0;
+    }
+}
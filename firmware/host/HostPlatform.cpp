@@ -0,0 +1,368 @@
+#include "HostPlatform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pico/time.h"
+#include "pico/critical_section.h"
+#include "pico/multicore.h"
+#include "pico/unique_id.h"
+#include "pico/util/queue.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+
+//--------------------------------------------------------------------+
+// Interrupts and event register
+//--------------------------------------------------------------------+
+
+static std::recursive_mutex &irqLock() {
+    static std::recursive_mutex lock;
+    return lock;
+}
+
+// Static objects of the firmware can start the timer and wake the cores before main()
+struct EventRegister {
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint64_t count = 0;
+};
+
+static EventRegister &events() {
+    static EventRegister sEvents;
+    return sEvents;
+}
+
+// Events already consumed by the __wfe() of each core
+static thread_local uint64_t eventSeen = 0;
+
+void HostPlatform::disableInterrupts() {
+    irqLock().lock();
+}
+
+void HostPlatform::enableInterrupts() {
+    irqLock().unlock();
+}
+
+void HostPlatform::runIrq(void (*handler)(void)) {
+    disableInterrupts();
+    handler();
+    enableInterrupts();
+    wakeCores();
+}
+
+void HostPlatform::wakeCores() {
+    EventRegister &event = events();
+    {
+        std::lock_guard<std::mutex> guard(event.mutex);
+        event.count++;
+    }
+    event.condition.notify_all();
+}
+
+void HostPlatform::reboot() {
+    // Same arguments as the running process
+    std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+    std::string args((std::istreambuf_iterator<char>(cmdline)), std::istreambuf_iterator<char>());
+    std::vector<char*> argv;
+    for(size_t pos = 0; pos < args.size(); pos += strlen(&args[pos]) + 1) {
+        argv.push_back(&args[pos]);
+    }
+    argv.push_back(nullptr);
+    char path[PATH_MAX];
+    const ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if(length > 0) {
+        path[length] = '\0';
+        unplugUsb();
+        fflush(stdout);
+        execv(path, argv.data());
+    }
+    panic("reboot failed");
+}
+
+extern "C" uint32_t save_and_disable_interrupts(void) {
+    HostPlatform::disableInterrupts();
+    return 0;
+}
+
+extern "C" void restore_interrupts(uint32_t status) {
+    (void)status;
+    HostPlatform::enableInterrupts();
+}
+
+extern "C" void __sev(void) {
+    HostPlatform::wakeCores();
+}
+
+extern "C" void __wfe(void) {
+    // Bounded as the RP2040 may wake on any interrupt
+    static const std::chrono::milliseconds MAX_WAIT(10);
+    EventRegister &event = events();
+    std::unique_lock<std::mutex> lock(event.mutex);
+    event.condition.wait_for(lock, MAX_WAIT, [&event] { return event.count != eventSeen; });
+    eventSeen = event.count;
+}
+
+extern "C" void critical_section_init(critical_section_t *crit_sec) {
+    crit_sec->save = 0;
+}
+
+extern "C" void critical_section_enter_blocking(critical_section_t *crit_sec) {
+    (void)crit_sec;
+    HostPlatform::disableInterrupts();
+}
+
+extern "C" void critical_section_exit(critical_section_t *crit_sec) {
+    (void)crit_sec;
+    HostPlatform::enableInterrupts();
+}
+
+extern "C" void critical_section_deinit(critical_section_t *crit_sec) {
+    (void)crit_sec;
+}
+
+extern "C" void panic(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "*** PANIC ***\n");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+//--------------------------------------------------------------------+
+// Cores
+//--------------------------------------------------------------------+
+
+extern "C" void multicore_launch_core1(void (*entry)(void)) {
+    std::thread(entry).detach();
+}
+
+extern "C" void pico_get_unique_board_id(pico_unique_board_id_t *id_out) {
+    static const uint8_t HOST_ID[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] = {'U', '2', 'I', 'F', 'H', 'O', 'S', 'T'};
+    memcpy(id_out->id, HOST_ID, PICO_UNIQUE_BOARD_ID_SIZE_BYTES);
+}
+
+//--------------------------------------------------------------------+
+// Timer
+//--------------------------------------------------------------------+
+
+static std::chrono::steady_clock::time_point bootTime() {
+    static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+    return boot;
+}
+
+extern "C" uint64_t time_us_64(void) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bootTime()).count());
+}
+
+extern "C" void sleep_us(uint64_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+extern "C" void sleep_ms(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+extern "C" void busy_wait_us(uint64_t us) {
+    const uint64_t end = time_us_64() + us;
+    while(time_us_64() < end);
+}
+
+// Alarms ordered by deadline, called by the timer thread as the timer IRQ
+struct Alarm {
+    alarm_callback_t callback;
+    void *userData;
+    uint64_t timeUs;
+};
+
+struct AlarmPool {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::map<alarm_id_t, Alarm> alarms;
+    alarm_id_t nextId = 1;
+};
+
+static AlarmPool &alarmPool() {
+    static AlarmPool sPool;
+    return sPool;
+}
+
+static void timerLoop() {
+    AlarmPool &pool = alarmPool();
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    while(true) {
+        auto due = pool.alarms.end();
+        for(auto it = pool.alarms.begin(); it != pool.alarms.end(); ++it) {
+            if(due == pool.alarms.end() || it->second.timeUs < due->second.timeUs)
+                due = it;
+        }
+        if(due == pool.alarms.end()) {
+            pool.condition.wait(lock);
+            continue;
+        }
+        const uint64_t nowUs = time_us_64();
+        if(due->second.timeUs > nowUs) {
+            pool.condition.wait_for(lock, std::chrono::microseconds(due->second.timeUs - nowUs));
+            continue;
+        }
+
+        const alarm_id_t id = due->first;
+        const Alarm alarm = due->second;
+        pool.alarms.erase(due);
+        lock.unlock();
+        HostPlatform::disableInterrupts();
+        const int64_t reschedule = alarm.callback(id, alarm.userData);
+        HostPlatform::enableInterrupts();
+        HostPlatform::wakeCores();
+        lock.lock();
+        if(reschedule != 0) {
+            Alarm next = alarm;
+            next.timeUs = reschedule < 0 ? alarm.timeUs - reschedule : time_us_64() + reschedule;
+            pool.alarms[id] = next;
+        }
+    }
+}
+
+extern "C" alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    static std::once_flag timerStarted;
+    std::call_once(timerStarted, [] { std::thread(timerLoop).detach(); });
+
+    if(!fire_if_past && time_reached(time))
+        return 0;
+    AlarmPool &pool = alarmPool();
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    const alarm_id_t id = pool.nextId++;
+    pool.alarms[id] = Alarm{callback, user_data, to_us_since_boot(time)};
+    pool.condition.notify_one();
+    return id;
+}
+
+extern "C" bool cancel_alarm(alarm_id_t alarm_id) {
+    AlarmPool &pool = alarmPool();
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    return pool.alarms.erase(alarm_id) > 0;
+}
+
+static int64_t repeatingTimerCallback(alarm_id_t id, void *user_data) {
+    (void)id;
+    repeating_timer_t *rt = static_cast<repeating_timer_t*>(user_data);
+    if(rt->callback(rt))
+        return rt->delay_us;
+    rt->alarm_id = 0;
+    return 0;
+}
+
+extern "C" bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->alarm_id = add_alarm_in_us(static_cast<uint64_t>(delay_us < 0 ? -delay_us : delay_us), repeatingTimerCallback, out, true);
+    return out->alarm_id > 0;
+}
+
+extern "C" bool cancel_repeating_timer(repeating_timer_t *timer) {
+    const bool cancelled = timer->alarm_id != 0 && cancel_alarm(timer->alarm_id);
+    timer->alarm_id = 0;
+    return cancelled;
+}
+
+//--------------------------------------------------------------------+
+// Watchdog
+//--------------------------------------------------------------------+
+
+static alarm_id_t watchdogAlarm = 0;
+static uint32_t watchdogDelayMs = 0;
+
+static int64_t watchdogCallback(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    HostPlatform::reboot();
+}
+
+extern "C" void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+    (void)pause_on_debug;
+    watchdogDelayMs = delay_ms;
+    watchdog_update();
+}
+
+extern "C" void watchdog_update(void) {
+    if(watchdogDelayMs == 0)
+        return;
+    if(watchdogAlarm != 0)
+        cancel_alarm(watchdogAlarm);
+    watchdogAlarm = add_alarm_in_ms(watchdogDelayMs, watchdogCallback, nullptr, true);
+}
+
+//--------------------------------------------------------------------+
+// Queue
+//--------------------------------------------------------------------+
+
+extern "C" void queue_init(queue_t *q, uint element_size, uint element_count) {
+    q->data = static_cast<uint8_t*>(calloc(element_count + 1, element_size));
+    q->element_size = static_cast<uint16_t>(element_size);
+    q->element_count = static_cast<uint16_t>(element_count);
+    q->wptr = 0;
+    q->rptr = 0;
+}
+
+extern "C" void queue_free(queue_t *q) {
+    free(q->data);
+    q->data = nullptr;
+}
+
+extern "C" uint queue_get_level(queue_t *q) {
+    HostPlatform::disableInterrupts();
+    const int level = static_cast<int>(q->wptr) - static_cast<int>(q->rptr);
+    HostPlatform::enableInterrupts();
+    return static_cast<uint>(level < 0 ? level + q->element_count + 1 : level);
+}
+
+// One free slot between wptr and rptr as the SDK queue
+static uint16_t nextIndex(queue_t *q, uint16_t index) {
+    return static_cast<uint16_t>(index + 1 > q->element_count ? 0 : index + 1);
+}
+
+extern "C" bool queue_try_add(queue_t *q, const void *data) {
+    HostPlatform::disableInterrupts();
+    const bool added = nextIndex(q, q->wptr) != q->rptr;
+    if(added) {
+        memcpy(&q->data[q->wptr * q->element_size], data, q->element_size);
+        q->wptr = nextIndex(q, q->wptr);
+    }
+    HostPlatform::enableInterrupts();
+    return added;
+}
+
+extern "C" bool queue_try_remove(queue_t *q, void *data) {
+    HostPlatform::disableInterrupts();
+    const bool removed = q->rptr != q->wptr;
+    if(removed) {
+        memcpy(data, &q->data[q->rptr * q->element_size], q->element_size);
+        q->rptr = nextIndex(q, q->rptr);
+    }
+    HostPlatform::enableInterrupts();
+    return removed;
+}
+
+extern "C" bool queue_try_peek(queue_t *q, void *data) {
+    HostPlatform::disableInterrupts();
+    const bool peeked = q->rptr != q->wptr;
+    if(peeked)
+        memcpy(data, &q->data[q->rptr * q->element_size], q->element_size);
+    HostPlatform::enableInterrupts();
+    return peeked;
+}
@@ -0,0 +1,24 @@
+#ifndef _HOST_PLATFORM_H
+#define _HOST_PLATFORM_H
+
+#include "pico.h"
+
+// Host build runtime shared by the stubs: core0 is the main thread, core1 a thread started by multicore_launch_core1(),
+// IRQs are the timer thread and the peripheral models. An IRQ runs with the interrupt lock taken, like a disabled interrupt
+// state on the RP2040, then wakes the cores as an exception entry ends __wfe().
+class HostPlatform {
+public:
+    static void disableInterrupts();
+    static void enableInterrupts();
+    // Calls handler as an IRQ
+    static void runIrq(void (*handler)(void));
+    // Raises a peripheral IRQ (hardware/irq.h), ignored while disabled
+    static void raiseIrq(uint num);
+    static void wakeCores();
+    // Stops listening and closes the connection, in that order so a host reconnecting reaches the next process
+    static void unplugUsb();
+    // Executes the program again with the same arguments: sockets are closed, static state is lost, as after a reset
+    static void reboot() __attribute__((noreturn));
+};
+
+#endif
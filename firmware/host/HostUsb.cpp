@@ -0,0 +1,322 @@
+#include "HostPlatform.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tusb.h"
+
+// Frames of the socket in both directions: | CHANNEL | SIZE[2] L.Endian | DATA[SIZE] |
+// HID frames carry one 64 bytes report, CDC and BULK frames any number of stream bytes.
+enum HostChannel {
+    HOST_CHANNEL_HID = 0x00,
+    HOST_CHANNEL_CDC = 0x01,
+    HOST_CHANNEL_BULK = 0x02
+};
+
+static const int DEFAULT_PORT = 4015;
+// Endpoint buffers: the socket is not read while the buffer of the received channel is full (NAK)
+static const size_t HID_RX_REPORTS = 1;
+static const size_t CDC_RX_SIZE = CFG_TUD_CDC_RX_BUFSIZE;
+static const size_t VENDOR_RX_SIZE = CFG_TUD_VENDOR_RX_BUFSIZE;
+static const size_t CDC_TX_SIZE = CFG_TUD_CDC_TX_BUFSIZE;
+static const size_t VENDOR_TX_SIZE = CFG_TUD_VENDOR_TX_BUFSIZE;
+
+// Written by the socket thread, taken by tud_task() and the read functions
+struct UsbState {
+    std::mutex mutex;
+    std::condition_variable condition;
+    int fd = -1;
+    bool connectPending = false;
+    bool disconnectPending = false;
+    bool cdcReceived = false;
+    std::deque<std::vector<uint8_t>> hidRx;
+    std::deque<uint8_t> cdcRx;
+    std::deque<uint8_t> vendorRx;
+};
+
+static UsbState usb;
+static int listenFd = -1;
+// Core0 only
+static bool mounted = false;
+static std::vector<uint8_t> cdcTx;
+static std::vector<uint8_t> vendorTx;
+
+static bool readFull(int fd, uint8_t *data, size_t size) {
+    while(size > 0) {
+        const ssize_t nbRead = recv(fd, data, size, 0);
+        if(nbRead <= 0)
+            return false;
+        data += nbRead;
+        size -= static_cast<size_t>(nbRead);
+    }
+    return true;
+}
+
+static bool sendFrame(HostChannel channel, const uint8_t *data, size_t size) {
+    if(!mounted)
+        return false;
+    while(size > 0) {
+        const size_t frameSize = std::min<size_t>(size, 0xFFFF);
+        const uint8_t header[3] = {static_cast<uint8_t>(channel), static_cast<uint8_t>(frameSize & 0xFF), static_cast<uint8_t>(frameSize >> 8)};
+        if(send(usb.fd, header, sizeof(header), MSG_NOSIGNAL | MSG_MORE) != sizeof(header))
+            return false;
+        size_t sent = 0;
+        while(sent < frameSize) {
+            const ssize_t nbSent = send(usb.fd, data + sent, frameSize - sent, MSG_NOSIGNAL);
+            if(nbSent <= 0)
+                return false;
+            sent += static_cast<size_t>(nbSent);
+        }
+        data += frameSize;
+        size -= frameSize;
+    }
+    return true;
+}
+
+// Stream bytes are appended as the endpoint buffer gets room
+static void receiveStream(std::unique_lock<std::mutex> &lock, std::deque<uint8_t> &rx, size_t rxSize, const uint8_t *data, size_t size) {
+    while(size > 0) {
+        usb.condition.wait(lock, [&rx, rxSize] { return rx.size() < rxSize; });
+        const size_t nbBytes = std::min(size, rxSize - rx.size());
+        rx.insert(rx.end(), data, data + nbBytes);
+        if(&rx == &usb.cdcRx)
+            usb.cdcReceived = true;
+        data += nbBytes;
+        size -= nbBytes;
+        HostPlatform::wakeCores();
+    }
+}
+
+static void socketLoop() {
+    std::vector<uint8_t> payload;
+    while(true) {
+        const int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(fd < 0) {
+            if(errno == EINVAL)
+                return; // unplugged
+            continue;
+        }
+        const int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        {
+            std::lock_guard<std::mutex> guard(usb.mutex);
+            usb.fd = fd;
+            usb.connectPending = true;
+        }
+        HostPlatform::wakeCores();
+
+        uint8_t header[3];
+        while(readFull(fd, header, sizeof(header))) {
+            payload.resize(header[1] | (header[2] << 8));
+            if(!readFull(fd, payload.data(), payload.size()))
+                break;
+
+            std::unique_lock<std::mutex> lock(usb.mutex);
+            if(header[0] == HOST_CHANNEL_HID) {
+                usb.condition.wait(lock, [] { return usb.hidRx.size() < HID_RX_REPORTS; });
+                usb.hidRx.push_back(payload);
+                HostPlatform::wakeCores();
+            } else if(header[0] == HOST_CHANNEL_CDC) {
+                receiveStream(lock, usb.cdcRx, CDC_RX_SIZE, payload.data(), payload.size());
+            } else if(header[0] == HOST_CHANNEL_BULK) {
+                receiveStream(lock, usb.vendorRx, VENDOR_RX_SIZE, payload.data(), payload.size());
+            }
+        }
+
+        // Socket closed by tud_task() (unplugged)
+        std::unique_lock<std::mutex> lock(usb.mutex);
+        usb.disconnectPending = true;
+        HostPlatform::wakeCores();
+        usb.condition.wait(lock, [] { return usb.fd < 0; });
+    }
+}
+
+extern "C" bool tusb_init(void) {
+    const char *portEnv = getenv("U2IF_HOST_PORT");
+    const int port = portEnv != nullptr ? atoi(portEnv) : DEFAULT_PORT;
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 1) != 0)
+        panic("u2if host: can not listen on port %d", port);
+
+    printf("u2if host: listening on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+    std::thread(socketLoop).detach();
+    return true;
+}
+
+void HostPlatform::unplugUsb() {
+    if(listenFd >= 0)
+        shutdown(listenFd, SHUT_RDWR);
+    std::lock_guard<std::mutex> guard(usb.mutex);
+    if(usb.fd >= 0)
+        shutdown(usb.fd, SHUT_RDWR);
+}
+
+extern "C" void tud_task(void) {
+    std::unique_lock<std::mutex> lock(usb.mutex);
+    if(usb.connectPending) {
+        usb.connectPending = false;
+        mounted = true;
+        lock.unlock();
+        tud_mount_cb();
+        tud_cdc_line_state_cb(0, true, true);
+        lock.lock();
+    }
+
+    if(usb.disconnectPending) {
+        usb.disconnectPending = false;
+        mounted = false;
+        close(usb.fd);
+        usb.fd = -1;
+        usb.hidRx.clear();
+        usb.cdcRx.clear();
+        usb.vendorRx.clear();
+        usb.cdcReceived = false;
+        cdcTx.clear();
+        vendorTx.clear();
+        usb.condition.notify_all();
+        lock.unlock();
+        tud_cdc_line_state_cb(0, false, false);
+        tud_umount_cb();
+        return;
+    }
+
+    if(!usb.hidRx.empty()) {
+        const std::vector<uint8_t> report = usb.hidRx.front();
+        usb.hidRx.pop_front();
+        usb.condition.notify_all();
+        lock.unlock();
+        tud_hid_set_report_cb(0, 0, HID_REPORT_TYPE_INVALID, report.data(), static_cast<uint16_t>(report.size()));
+        lock.lock();
+    }
+
+    if(usb.cdcReceived) {
+        usb.cdcReceived = false;
+        lock.unlock();
+        tud_cdc_rx_cb(0);
+    }
+}
+
+extern "C" bool tud_mounted(void) {
+    return mounted;
+}
+
+//--------------------------------------------------------------------+
+// HID
+//--------------------------------------------------------------------+
+
+// Busy while the client does not read its responses
+extern "C" bool tud_hid_n_ready(uint8_t instance) {
+    (void)instance;
+    if(!mounted)
+        return false;
+    pollfd pfd = {usb.fd, POLLOUT, 0};
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLOUT);
+}
+
+extern "C" bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len) {
+    (void)instance;
+    (void)report_id;
+    return sendFrame(HOST_CHANNEL_HID, static_cast<const uint8_t*>(report), len);
+}
+
+//--------------------------------------------------------------------+
+// CDC and vendor streams
+//--------------------------------------------------------------------+
+
+static uint32_t readStream(std::deque<uint8_t> &rx, void *buffer, uint32_t bufsize) {
+    std::lock_guard<std::mutex> guard(usb.mutex);
+    const uint32_t nbBytes = std::min<uint32_t>(bufsize, static_cast<uint32_t>(rx.size()));
+    std::copy(rx.begin(), rx.begin() + nbBytes, static_cast<uint8_t*>(buffer));
+    rx.erase(rx.begin(), rx.begin() + nbBytes);
+    usb.condition.notify_all();
+    return nbBytes;
+}
+
+static uint32_t streamLevel(std::deque<uint8_t> &rx) {
+    std::lock_guard<std::mutex> guard(usb.mutex);
+    return static_cast<uint32_t>(rx.size());
+}
+
+static uint32_t writeStream(std::vector<uint8_t> &tx, size_t txSize, void const *buffer, uint32_t bufsize) {
+    if(!mounted)
+        return 0;
+    const uint32_t nbBytes = std::min<uint32_t>(bufsize, static_cast<uint32_t>(txSize - tx.size()));
+    tx.insert(tx.end(), static_cast<const uint8_t*>(buffer), static_cast<const uint8_t*>(buffer) + nbBytes);
+    return nbBytes;
+}
+
+static uint32_t flushStream(HostChannel channel, std::vector<uint8_t> &tx) {
+    const uint32_t nbBytes = static_cast<uint32_t>(tx.size());
+    if(nbBytes == 0 || !sendFrame(channel, tx.data(), tx.size()))
+        return 0;
+    tx.clear();
+    return nbBytes;
+}
+
+extern "C" uint32_t tud_cdc_available(void) {
+    return streamLevel(usb.cdcRx);
+}
+
+extern "C" uint32_t tud_cdc_read(void *buffer, uint32_t bufsize) {
+    return readStream(usb.cdcRx, buffer, bufsize);
+}
+
+extern "C" void tud_cdc_read_flush(void) {
+    std::lock_guard<std::mutex> guard(usb.mutex);
+    usb.cdcRx.clear();
+    usb.condition.notify_all();
+}
+
+extern "C" uint32_t tud_cdc_write_available(void) {
+    return mounted ? static_cast<uint32_t>(CDC_TX_SIZE - cdcTx.size()) : 0;
+}
+
+extern "C" uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize) {
+    return writeStream(cdcTx, CDC_TX_SIZE, buffer, bufsize);
+}
+
+extern "C" uint32_t tud_cdc_write_flush(void) {
+    return flushStream(HOST_CHANNEL_CDC, cdcTx);
+}
+
+extern "C" uint32_t tud_vendor_available(void) {
+    return streamLevel(usb.vendorRx);
+}
+
+extern "C" uint32_t tud_vendor_read(void *buffer, uint32_t bufsize) {
+    return readStream(usb.vendorRx, buffer, bufsize);
+}
+
+extern "C" uint32_t tud_vendor_write_available(void) {
+    return mounted ? static_cast<uint32_t>(VENDOR_TX_SIZE - vendorTx.size()) : 0;
+}
+
+extern "C" uint32_t tud_vendor_write(void const *buffer, uint32_t bufsize) {
+    return writeStream(vendorTx, VENDOR_TX_SIZE, buffer, bufsize);
+}
+
+extern "C" uint32_t tud_vendor_write_flush(void) {
+    return flushStream(HOST_CHANNEL_BULK, vendorTx);
+}
@@ -0,0 +1,20 @@
+#ifndef _HOST_HARDWARE_ADC_H
+#define _HOST_HARDWARE_ADC_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Simulated inputs: an initialized ADC pin reads half scale, others read 0
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+uint16_t adc_read(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _HOST_HARDWARE_DMA_H
+#define _HOST_HARDWARE_DMA_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+#include <atomic>
+
+// Write 1 to clear interrupt register (INTS0/INTS1)
+class HostW1cRegister {
+public:
+    HostW1cRegister() : _value(0) {}
+    operator uint32_t() const { return _value.load(); }
+    HostW1cRegister &operator=(uint32_t mask) { _value &= ~mask; return *this; }
+    void set(uint32_t mask) { _value |= mask; }
+private:
+    std::atomic<uint32_t> _value;
+};
+
+typedef struct {
+    HostW1cRegister ints0;
+    HostW1cRegister ints1;
+} dma_hw_t;
+
+extern dma_hw_t * const host_dma_hw;
+#define dma_hw host_dma_hw
+
+extern "C" {
+#endif
+
+#define NUM_DMA_CHANNELS 12
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+// Simulated pacing: SPI TX channels take the bus time at the SPI baudrate and feed the SPI RX channel (MISO looped back),
+// I2C TX channels run their IC_DATA_CMD commands on the simulated bus (hardware/i2c.h) and feed the I2C RX channel,
+// DREQ_FORCE channels copy memory, the others complete without effect.
+enum dreq_num_rp2040 {
+    DREQ_PIO0_TX0 = 0,
+    DREQ_PIO0_TX1 = 1,
+    DREQ_PIO0_TX2 = 2,
+    DREQ_PIO0_TX3 = 3,
+    DREQ_PIO0_RX0 = 4,
+    DREQ_PIO1_TX0 = 8,
+    DREQ_SPI0_TX = 16,
+    DREQ_SPI0_RX = 17,
+    DREQ_SPI1_TX = 18,
+    DREQ_SPI1_RX = 19,
+    DREQ_I2C0_TX = 32,
+    DREQ_I2C0_RX = 33,
+    DREQ_I2C1_TX = 34,
+    DREQ_I2C1_RX = 35,
+    DREQ_FORCE = 0x3f
+};
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count);
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_abort(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef _HOST_HARDWARE_I2C_H
+#define _HOST_HARDWARE_I2C_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+#include <atomic>
+#include <deque>
+
+// Interrupt clear register (IC_CLR_*): reading it clears its bits of IC_RAW_INTR_STAT
+class HostI2cClearRegister {
+public:
+    HostI2cClearRegister(std::atomic<uint32_t> &rawIntrStat, uint32_t mask) : _rawIntrStat(rawIntrStat), _mask(mask) {}
+    operator uint32_t() const { return (_rawIntrStat.fetch_and(~_mask) & _mask) != 0 ? 1 : 0; }
+private:
+    std::atomic<uint32_t> &_rawIntrStat;
+    const uint32_t _mask;
+};
+
+// IC_DATA_CMD: the commands of the master are written by its TX DMA channel (DMA model). In slave mode, reading it pops
+// the RX FIFO (data and FIRST_DATA_BYTE), writing it answers the read request (RD_REQ) of the master.
+class HostI2cDataCmd {
+public:
+    HostI2cDataCmd() : firstDataByte(false), txData(-1) {}
+    operator uint32_t() {
+        if(rxFifo.empty())
+            return 0;
+        const uint32_t value = rxFifo.front();
+        rxFifo.pop_front();
+        return value;
+    }
+    HostI2cDataCmd &operator=(uint32_t value) { txData = static_cast<int>(value & 0xFF); return *this; }
+    std::deque<uint32_t> rxFifo;
+    bool firstDataByte; // next byte received is the first one after the address
+    int txData; // -1: read request not answered
+};
+
+// IC_RXFLR
+class HostI2cRxLevel {
+public:
+    HostI2cRxLevel(const HostI2cDataCmd &dataCmd) : _dataCmd(dataCmd) {}
+    operator uint32_t() const { return static_cast<uint32_t>(_dataCmd.rxFifo.size()); }
+private:
+    const HostI2cDataCmd &_dataCmd;
+};
+
+// IC_INTR_STAT: IC_RAW_INTR_STAT masked by IC_INTR_MASK, RX_FULL while the RX FIFO is not empty
+class HostI2cIntrStat {
+public:
+    HostI2cIntrStat(const std::atomic<uint32_t> &rawIntrStat, const volatile uint32_t &intrMask, const HostI2cDataCmd &dataCmd)
+        : _rawIntrStat(rawIntrStat), _intrMask(intrMask), _dataCmd(dataCmd) {}
+    operator uint32_t() const { return (_rawIntrStat | (_dataCmd.rxFifo.empty() ? 0 : RX_FULL_BITS)) & _intrMask; }
+private:
+    static const uint32_t RX_FULL_BITS = 0x4;
+    const std::atomic<uint32_t> &_rawIntrStat;
+    const volatile uint32_t &_intrMask;
+    const HostI2cDataCmd &_dataCmd;
+};
+
+// Registers used by the DMA engine and the slave mode, the FIFOs and the bus are simulated by the DMA model (hardware/dma.h)
+typedef struct host_i2c_hw {
+    host_i2c_hw();
+    volatile uint32_t con;
+    volatile uint32_t enable;
+    volatile uint32_t tar;
+    volatile uint32_t sar;
+    volatile uint32_t intr_mask;
+    HostI2cDataCmd data_cmd;
+    HostI2cRxLevel rxflr;
+    std::atomic<uint32_t> raw_intr_stat;
+    HostI2cIntrStat intr_stat;
+    std::atomic<uint32_t> tx_abrt_source;
+    HostI2cClearRegister clr_intr;
+    HostI2cClearRegister clr_tx_abrt;
+    HostI2cClearRegister clr_stop_det;
+    HostI2cClearRegister clr_rd_req;
+} i2c_hw_t;
+
+extern "C" {
+#endif
+
+typedef struct i2c_inst {
+    uint index;
+    uint baudrate;
+    bool restart_on_next;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+static inline uint i2c_hw_index(i2c_inst_t *i2c) { return i2c->index; }
+
+#define I2C_IC_CON_MASTER_MODE_BITS 0x00000001
+#define I2C_IC_CON_IC_SLAVE_DISABLE_BITS 0x00000040
+#define I2C_IC_CON_STOP_DET_IFADDRESSED_BITS 0x00000080
+#define I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS 0x00000800
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x00000200
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040
+#define I2C_IC_RAW_INTR_STAT_TX_EMPTY_BITS 0x00000010
+#define I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS 0x00000001
+#define I2C_IC_RAW_INTR_STAT_RD_REQ_BITS 0x00000020
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS 0x00000200
+#define I2C_IC_INTR_STAT_R_RD_REQ_BITS 0x00000020
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS 0x00000040
+#define I2C_IC_INTR_STAT_R_RX_FULL_BITS 0x00000004
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS 0x00000200
+#define I2C_IC_INTR_MASK_M_RD_REQ_BITS 0x00000020
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x00000040
+#define I2C_IC_INTR_MASK_M_TX_EMPTY_BITS 0x00000010
+#define I2C_IC_INTR_MASK_M_RX_FULL_BITS 0x00000004
+
+// Simulated bus: a 256 bytes memory (1 byte address pointer, EEPROM like) answers at HOST_I2C_MEMORY_ADDR, other addresses do not ACK.
+// The buses of I2C0 and I2C1 are wired together: an I2C in slave mode answers the master of the other one at its address
+// (before the memory), its IRQ called for each byte.
+#define HOST_I2C_MEMORY_ADDR 0x50
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+void i2c_set_slave_mode(i2c_inst_t *i2c, bool slave, uint8_t addr);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+#ifdef __cplusplus
+}
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+#endif
+
+#endif
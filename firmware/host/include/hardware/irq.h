@@ -0,0 +1,40 @@
+#ifndef _HOST_HARDWARE_IRQ_H
+#define _HOST_HARDWARE_IRQ_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum irq_num_rp2040 {
+    TIMER_IRQ_0 = 0,
+    USBCTRL_IRQ = 5,
+    IO_IRQ_BANK0 = 13,
+    DMA_IRQ_0 = 11,
+    DMA_IRQ_1 = 12,
+    SPI0_IRQ = 18,
+    SPI1_IRQ = 19,
+    UART0_IRQ = 20,
+    UART1_IRQ = 21,
+    I2C0_IRQ = 23,
+    I2C1_IRQ = 24,
+    NUM_IRQS = 32
+};
+
+typedef void (*irq_handler_t)(void);
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+// Shared handlers are called in order of addition, the order priority is ignored
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_remove_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
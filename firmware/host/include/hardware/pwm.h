@@ -0,0 +1,47 @@
+#ifndef _HOST_HARDWARE_PWM_H
+#define _HOST_HARDWARE_PWM_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUM_PWM_SLICES 8
+
+// Registers read back by the firmware, reset values as on the RP2040 (DIV = 1.0, TOP = 0xFFFF)
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t div;
+    volatile uint32_t ctr;
+    volatile uint32_t cc;
+    volatile uint32_t top;
+} pwm_slice_hw_t;
+
+typedef struct {
+    pwm_slice_hw_t slice[NUM_PWM_SLICES];
+    volatile uint32_t en;
+} pwm_hw_t;
+
+#define PWM_CH0_CC_A_LSB 0u
+#define PWM_CH0_CC_B_LSB 16u
+
+extern pwm_hw_t host_pwm_hw;
+#define pwm_hw (&host_pwm_hw)
+
+enum pwm_chan {
+    PWM_CHAN_A = 0,
+    PWM_CHAN_B = 1
+};
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1u) & 7u; }
+static inline uint pwm_gpio_to_channel(uint gpio) { return gpio & 1u; }
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_enabled(uint slice_num, bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
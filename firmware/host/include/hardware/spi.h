@@ -0,0 +1,64 @@
+#ifndef _HOST_HARDWARE_SPI_H
+#define _HOST_HARDWARE_SPI_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spi_inst spi_inst_t;
+
+extern spi_inst_t * const host_spi0;
+extern spi_inst_t * const host_spi1;
+#define spi0 host_spi0
+#define spi1 host_spi1
+
+typedef enum {
+    SPI_CPHA_0 = 0,
+    SPI_CPHA_1 = 1
+} spi_cpha_t;
+
+typedef enum {
+    SPI_CPOL_0 = 0,
+    SPI_CPOL_1 = 1
+} spi_cpol_t;
+
+typedef enum {
+    SPI_LSB_FIRST = 0,
+    SPI_MSB_FIRST = 1
+} spi_order_t;
+
+// Registers used as DMA addresses, the FIFOs are simulated by the DMA model (hardware/dma.h)
+typedef struct {
+    volatile uint32_t dr;
+    volatile uint32_t sr;
+    volatile uint32_t icr;
+} spi_hw_t;
+
+#define SPI_SSPSR_BSY_BITS 0x00000010
+#define SPI_SSPICR_RORIC_BITS 0x00000001
+
+// Simulated bus: MISO looped back on MOSI
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+uint spi_get_index(const spi_inst_t *spi);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+// The simulated transfers are done when their DMA channel completes: never busy, RX FIFO always empty
+static inline bool spi_is_busy(const spi_inst_t *spi) { (void)spi; return false; }
+static inline bool spi_is_readable(const spi_inst_t *spi) { (void)spi; return false; }
+static inline bool spi_is_writable(const spi_inst_t *spi) { (void)spi; return true; }
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+int spi_write16_read16_blocking(spi_inst_t *spi, const uint16_t *src, uint16_t *dst, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
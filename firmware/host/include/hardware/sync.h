@@ -0,0 +1,27 @@
+#ifndef _HOST_HARDWARE_SYNC_H
+#define _HOST_HARDWARE_SYNC_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interrupts of the host build are the timer and peripheral callbacks, "disabling" them takes the host interrupt lock (recursive)
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+// Event register shared by the cores: __sev() wakes every thread waiting in __wfe()
+void __sev(void);
+void __wfe(void);
+static inline void __wfi(void) { __wfe(); }
+
+static inline void __mem_fence_acquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void __mem_fence_release(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+static inline void __dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
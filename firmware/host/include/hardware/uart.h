@@ -0,0 +1,30 @@
+#ifndef _HOST_HARDWARE_UART_H
+#define _HOST_HARDWARE_UART_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uart_inst uart_inst_t;
+
+extern uart_inst_t * const host_uart0;
+extern uart_inst_t * const host_uart1;
+#define uart0 host_uart0
+#define uart1 host_uart1
+
+// Simulated line: RX looped back on TX, the RX IRQ is raised while enabled and data is readable
+uint uart_init(uart_inst_t *uart, uint baudrate);
+void uart_deinit(uart_inst_t *uart);
+uint uart_get_index(uart_inst_t *uart);
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data);
+bool uart_is_readable(uart_inst_t *uart);
+void uart_putc_raw(uart_inst_t *uart, char c);
+char uart_getc(uart_inst_t *uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
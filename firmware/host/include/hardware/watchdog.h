@@ -0,0 +1,18 @@
+#ifndef _HOST_HARDWARE_WATCHDOG_H
+#define _HOST_HARDWARE_WATCHDOG_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The host build "reboots" by executing itself again when the watchdog is not updated in time
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _HOST_PICO_H
+#define _HOST_PICO_H
+
+// Host build: subset of the Pico SDK base definitions used by the firmware
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+
+enum pico_error_codes {
+    PICO_OK = 0,
+    PICO_ERROR_NONE = 0,
+    PICO_ERROR_TIMEOUT = -1,
+    PICO_ERROR_GENERIC = -2,
+    PICO_ERROR_NO_DATA = -3,
+};
+
+void panic(const char *fmt, ...) __attribute__((noreturn));
+
+static inline void tight_loop_contents(void) {}
+
+#define hard_assert(x) ((x) ? (void)0 : panic("hard_assert %s failed (%s:%d)", #x, __FILE__, __LINE__))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _HOST_PICO_CRITICAL_SECTION_H
+#define _HOST_PICO_CRITICAL_SECTION_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All critical sections share the host interrupt lock: taken by the firmware threads (cores) and the IRQ threads
+typedef struct critical_section {
+    uint32_t save;
+} critical_section_t;
+
+void critical_section_init(critical_section_t *crit_sec);
+void critical_section_enter_blocking(critical_section_t *crit_sec);
+void critical_section_exit(critical_section_t *crit_sec);
+void critical_section_deinit(critical_section_t *crit_sec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _HOST_PICO_MULTICORE_H
+#define _HOST_PICO_MULTICORE_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Core1 is a thread of the process
+void multicore_launch_core1(void (*entry)(void));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
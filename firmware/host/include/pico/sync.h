@@ -0,0 +1,7 @@
+#ifndef _HOST_PICO_SYNC_H
+#define _HOST_PICO_SYNC_H
+
+#include "hardware/sync.h"
+#include "pico/critical_section.h"
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _HOST_PICO_UTIL_QUEUE_H
+#define _HOST_PICO_UTIL_QUEUE_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same semantics as the SDK queue: fixed size elements copied in and out, safe between threads and IRQs
+typedef struct {
+    uint8_t *data;
+    uint16_t wptr;
+    uint16_t rptr;
+    uint16_t element_size;
+    uint16_t element_count;
+} queue_t;
+
+void queue_init(queue_t *q, uint element_size, uint element_count);
+void queue_free(queue_t *q);
+uint queue_get_level(queue_t *q);
+static inline bool queue_is_empty(queue_t *q) { return queue_get_level(q) == 0; }
+static inline bool queue_is_full(queue_t *q) { return queue_get_level(q) == q->element_count; }
+bool queue_try_add(queue_t *q, const void *data);
+bool queue_try_remove(queue_t *q, void *data);
+bool queue_try_peek(queue_t *q, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
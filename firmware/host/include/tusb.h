@@ -0,0 +1,58 @@
+#ifndef _HOST_TUSB_H
+#define _HOST_TUSB_H
+
+// Host build: TinyUSB device API used by the firmware, carried by the socket of HostUsb.cpp
+
+#include "pico.h"
+#include "tusb_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HID_REPORT_TYPE_INVALID = 0,
+    HID_REPORT_TYPE_INPUT,
+    HID_REPORT_TYPE_OUTPUT,
+    HID_REPORT_TYPE_FEATURE
+} hid_report_type_t;
+
+// Listens on U2IF_HOST_PORT (default 4015), the client connection is the USB cable
+bool tusb_init(void);
+// Called by the main loop: connection events and one HID OUT report per call, as the endpoint is rearmed once per task
+void tud_task(void);
+bool tud_mounted(void);
+
+bool tud_hid_n_ready(uint8_t instance);
+static inline bool tud_hid_ready(void) { return tud_hid_n_ready(0); }
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len);
+static inline bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len) { return tud_hid_n_report(0, report_id, report, len); }
+
+uint32_t tud_cdc_available(void);
+uint32_t tud_cdc_read(void *buffer, uint32_t bufsize);
+void tud_cdc_read_flush(void);
+uint32_t tud_cdc_write_available(void);
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize);
+uint32_t tud_cdc_write_flush(void);
+
+uint32_t tud_vendor_available(void);
+uint32_t tud_vendor_read(void *buffer, uint32_t bufsize);
+uint32_t tud_vendor_write_available(void);
+uint32_t tud_vendor_write(void const *buffer, uint32_t bufsize);
+uint32_t tud_vendor_write_flush(void);
+
+// Application callbacks, invoked from tud_task()
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
+uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen);
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize);
+void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts);
+void tud_cdc_rx_cb(uint8_t itf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
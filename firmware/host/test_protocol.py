@@ -0,0 +1,197 @@
+"""Command protocol tests against the host build: python3 test_protocol.py <u2if_host> [hid|bulk]
+
+Started by ctest (cmake -S host -B build-host, cmake --build build-host, ctest --test-dir build-host). The memory of
+the simulated I2C bus answers at 0x50.
+"""
+import os
+import socket
+import subprocess
+import sys
+import time
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "source"))
+
+from machine.u2if import Device  # noqa: E402
+from machine.i2c import I2C  # noqa: E402
+from machine import u2if_const as report_const  # noqa: E402
+from machine.host import CHANNEL_BULK  # noqa: E402
+
+HOST_PATH = None
+TRANSPORT = "host"
+MEM_ADDRESS = 0x50
+
+
+def free_port():
+    with socket.socket() as sock:
+        sock.bind(("127.0.0.1", 0))
+        return sock.getsockname()[1]
+
+
+class ProtocolTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        port = free_port()
+        env = dict(os.environ, U2IF_HOST_PORT=str(port))
+        cls.host = subprocess.Popen([HOST_PATH], env=env, stdout=subprocess.DEVNULL)
+        time.sleep(0.2)
+        cls.device = Device(transport=TRANSPORT, address="localhost:%d" % port)
+        cls.i2c = I2C(i2c_index=0, frequency=400000)
+        cls.i2c.writeto_mem(MEM_ADDRESS, 0x10, b"\xAA\x55")
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.host.kill()
+        cls.host.wait()
+
+    def test_tagged_same_report_id(self):
+        # The second one is received while the first runs: each response keeps the tag of its command
+        report = bytes([report_const.I2C0_WRITE_READ, MEM_ADDRESS, 1, 2, 0x10])
+        tag1 = self.device.submit_report(report)
+        tag2 = self.device.submit_report(report)
+        res1 = self.device.wait_report(tag1)
+        res2 = self.device.wait_report(tag2)
+        self.assertEqual(res1[0], report_const.I2C0_WRITE_READ)
+        self.assertEqual(res1[1], report_const.OK)
+        self.assertEqual(bytes(res1[2:4]), b"\xAA\x55")
+        self.assertEqual(res2[0], report_const.I2C0_WRITE_READ)
+        if res2[1] == report_const.OK:
+            self.assertEqual(bytes(res2[2:4]), b"\xAA\x55")
+        else:
+            self.assertEqual(res2[1], report_const.NOK)  # bus busy
+        self.assertFalse(self.device._tagged_responses[tag1])
+        self.assertFalse(self.device._tagged_responses[tag2])
+
+    def test_tagged_response_size(self):
+        # The tag takes 2 bytes of the response: 60 bytes are read at most
+        for nbytes, status in ((60, report_const.OK), (61, report_const.NOK)):
+            tag = self.device.submit_report(bytes([report_const.I2C0_WRITE_READ, MEM_ADDRESS, 1, nbytes, 0x10]))
+            res = self.device.wait_report(tag)
+            self.assertEqual(res[1], status)
+            if status == report_const.OK:
+                self.assertEqual(bytes(res[2:4]), b"\xAA\x55")
+
+    def test_batch_asynchronous_commands(self):
+        # The I2C transfers are answered by task(): the batch waits for them and sends one response
+        read_reg = bytes([report_const.I2C0_WRITE_READ, MEM_ADDRESS, 1, 1])
+        results = self.device.send_batch([(read_reg + b"\x10", 1), (read_reg + b"\x11", 1)])
+        self.assertEqual(results, [(report_const.OK, b"\xAA"), (report_const.OK, b"\x55")])
+
+        # Ended by a NACK, with the tag of the batch
+        batch = bytes([report_const.SYS_BATCH, 2, 5, 1]) + read_reg + b"\x10" + bytes([5, 1, report_const.I2C0_WRITE_READ,
+                                                                                      0x51, 1, 1, 0x10])
+        tag = self.device.submit_report(batch)
+        res = self.device.wait_report(tag)
+        self.assertEqual(bytes(res[:7]), bytes([report_const.SYS_BATCH, report_const.NOK, 2, report_const.OK, 0xAA,
+                                                report_const.NOK, 0]))
+        self.assertFalse(self.device._tagged_responses[tag])
+
+        # The GPIO is set once the I2C write has ended
+        write = bytes([report_const.I2C0_WRITE, MEM_ADDRESS, 1]) + (3).to_bytes(4, byteorder="little") + b"\x20\x12\x34"
+        results = self.device.send_batch([(bytes([report_const.GPIO_INIT_PIN, 15, 1, 0]), 0), (write, 0),
+                                          (bytes([report_const.GPIO_SET_VALUE, 15, 1]), 0)])
+        self.assertEqual(results, [(report_const.OK, b""), (report_const.OK, b""), (report_const.OK, b"")])
+        self.assertEqual(self.device.send_report(bytes([report_const.GPIO_GET_VALUE, 15]))[3], 1)
+        self.assertEqual(self.i2c.readfrom_mem(MEM_ADDRESS, 0x20, 2), b"\x12\x34")
+
+    def test_batch_deadline_stops_sub_command(self):
+        # The wait of the expired batch is stopped: the next batch waits for the target changes itself
+        target_init = bytes([report_const.I2C_TARGET_INIT, 1, 0x42, 0]) + bytes(32)
+        self.assertEqual(self.device.send_report(target_init)[1], report_const.OK)
+        self.device.set_command_timeout(100, report_const.SYS_BATCH)
+        wait = bytes([report_const.I2C_TARGET_GET_CHANGES, 1])
+        res = self.device.send_report(bytes([report_const.SYS_BATCH, 1, len(wait), 2]) + wait)
+        self.assertEqual(res[1], report_const.TIMEOUT)
+        self.device.set_command_timeout(2000, report_const.SYS_BATCH)
+        tag = self.device.submit_report(bytes([report_const.SYS_BATCH, 1, len(wait), 2]) + wait)
+        time.sleep(0.1)
+        self.i2c.writeto_mem(0x42, 0x20, b"\x01")
+        res = self.device.wait_report(tag)
+        self.assertEqual(bytes(res[:6]), bytes([report_const.SYS_BATCH, report_const.OK, 1, report_const.OK, 1, 0]))
+        self.assertEqual(self.device.send_report(bytes([report_const.I2C_TARGET_DEINIT]))[1], report_const.OK)
+
+    def test_bus_ownership(self):
+        # I2C0 is used by the master, I2C1 is free until I2C_TARGET uses it
+        target_init = bytes([report_const.I2C_TARGET_INIT, 0, 0x42, 0]) + bytes(32)
+        self.assertEqual(self.device.send_report(target_init)[1], report_const.NOK)
+        target_init = bytes([report_const.I2C_TARGET_INIT, 1]) + target_init[2:]
+        self.assertEqual(self.device.send_report(target_init)[1], report_const.OK)
+        tag = self.device.submit_report(bytes([report_const.I2C_TARGET_GET_CHANGES, 1]))
+        res = self.device.send_report(bytes([report_const.I2C_TARGET_GET_CHANGES, 1]))
+        self.assertEqual(res[1], report_const.NOK)  # one wait at a time
+        self.i2c.writeto_mem(0x42, 0x20, b"\x01")
+        self.assertEqual(self.device.wait_report(tag)[1:4], bytes([report_const.OK, 1, 0]))
+        i2c1_init = bytes([report_const.I2C1_INIT, 0]) + (100000).to_bytes(4, byteorder="little")
+        self.assertEqual(self.device.send_report(i2c1_init)[1], report_const.NOK)
+        self.assertEqual(self.device.send_report(bytes([report_const.I2C_TARGET_DEINIT]))[1], report_const.OK)
+        self.assertEqual(self.device.send_report(i2c1_init)[1], report_const.OK)
+        self.assertEqual(self.device.send_report(bytes([report_const.I2C1_DEINIT]))[1], report_const.OK)
+
+    def test_bulk_oversized_frame(self):
+        # The bytes after a SIZE over 64 are dropped with their packet, not read as frames
+        self.assertEqual(self.device.send_report(bytes([report_const.GPIO_INIT_PIN, 16, 1, 0]))[1], report_const.OK)
+        stats = self.device.send_report(bytes([report_const.SYS_GET_QUEUE_STATS, 0]))
+        dropped = int.from_bytes(stats[9:13], byteorder="little")
+        self.device._hid._connection.send(CHANNEL_BULK, bytes([report_const.HID_REPORT_SIZE + 1, 3,
+                                                               report_const.GPIO_SET_VALUE, 16, 1]))
+        time.sleep(0.1)  # bulk packet read before the HID command of the stats
+        stats = self.device.send_report(bytes([report_const.SYS_GET_QUEUE_STATS, 0]))
+        self.assertEqual(int.from_bytes(stats[9:13], byteorder="little"), dropped + 1)
+        self.assertEqual(self.device.send_report(bytes([report_const.GPIO_GET_VALUE, 16]))[3], 0)
+
+    def test_bus_clear_aborts_read_stream(self):
+        # Stream stalled by the CDC not read: stopped by I2C0_BUS_CLEAR, the bytes not read are zeros
+        nb_bytes = 4 * 1024 * 1024
+        res = self.device.send_report(bytes([report_const.I2C0_READ_TO_STREAM, MEM_ADDRESS])
+                                      + nb_bytes.to_bytes(4, byteorder="little") + b"\0")
+        self.assertEqual(res[1], report_const.OK)
+        self.assertEqual(self.device.send_report(bytes([report_const.I2C0_WRITE_READ, MEM_ADDRESS, 1, 1, 0x10]))[1],
+                         report_const.NOK)
+        res = self.device.send_report(bytes([report_const.I2C0_BUS_CLEAR]))
+        self.assertEqual(res[1], report_const.OK)
+        received = self.device.read_serial(nb_bytes)
+        res = self.device.read_hid(report_const.I2C0_READ_TO_STREAM)
+        self.assertEqual(res[1], report_const.NOK)
+        nb_read = int.from_bytes(res[2:6], byteorder="little")
+        self.assertLess(nb_read, nb_bytes)
+        self.assertEqual(len(received), nb_bytes)
+        self.assertFalse(any(received[nb_read:]))
+        self.assertEqual(self.device.send_report(bytes([report_const.I2C0_WRITE_READ, MEM_ADDRESS, 1, 1, 0x10]))[2],
+                         0xAA)
+
+    def test_spi_device_transfer_async(self):
+        # Clocked by core1 and answered by task(): the RX bytes come back in the response, in a batch too
+        spi_init = bytes([report_const.SPI0_INIT, 0]) + (1000000).to_bytes(4, byteorder="little")
+        self.assertEqual(self.device.send_report(spi_init)[1], report_const.OK)
+        config = bytes([report_const.SPI0_DEVICE_CONFIG, 2, 18, 0x02, 0, 8]) + (500000).to_bytes(4, byteorder="little")
+        self.assertEqual(self.device.send_report(config)[1], report_const.OK)
+        transfer = bytes([report_const.SPI0_DEVICE_TRANSFER, 2, 1, 0, 3]) + b"\x01\x80\x5A"
+        res = self.device.send_report(transfer)
+        self.assertEqual(bytes(res[:5]), bytes([report_const.SPI0_DEVICE_TRANSFER, report_const.OK, 0x01, 0x80, 0x5A]))
+        results = self.device.send_batch([(transfer, 3), (transfer[:5] + b"\x12\x34\x56", 3)])
+        self.assertEqual(results, [(report_const.OK, b"\x01\x80\x5A"), (report_const.OK, b"\x12\x34\x56")])
+        self.assertEqual(self.device.send_report(bytes([report_const.SPI0_DEINIT]))[1], report_const.OK)
+
+    def test_spi_busy_during_stream(self):
+        # The CS of the stream is asserted until its last byte: the device transfers are refused meanwhile
+        spi_init = bytes([report_const.SPI0_INIT, 0]) + (1000000).to_bytes(4, byteorder="little")
+        self.assertEqual(self.device.send_report(spi_init)[1], report_const.OK)
+        config = bytes([report_const.SPI0_DEVICE_CONFIG, 1, 17, 0, 0, 8]) + (500000).to_bytes(4, byteorder="little")
+        self.assertEqual(self.device.send_report(config)[1], report_const.OK)
+        transfer = bytes([report_const.SPI0_DEVICE_TRANSFER, 1, 0, 0xFF, 2])
+        res = self.device.send_report(bytes([report_const.SPI0_WRITE_FROM_UART]) + (4).to_bytes(4, byteorder="little")
+                                      + b"\x01")
+        self.assertEqual(res[1], report_const.OK)
+        self.assertEqual(self.device.send_report(transfer)[1], report_const.NOK)
+        self.assertEqual(self.device.send_report(config)[1], report_const.NOK)
+        self.device.write_serial(b"\x01\x02\x03\x04")
+        self.assertEqual(self.device.read_hid(report_const.SPI0_WRITE_FROM_UART)[1], report_const.OK)
+        self.assertEqual(self.device.send_report(transfer)[1], report_const.OK)
+        self.assertEqual(self.device.send_report(bytes([report_const.SPI0_DEINIT]))[1], report_const.OK)
+
+
+if __name__ == "__main__":
+    HOST_PATH = sys.argv[1]
+    if len(sys.argv) > 2 and sys.argv[2] == "bulk":
+        TRANSPORT = "host_bulk"
+    unittest.main(argv=sys.argv[:1])
@@ -0,0 +1,117 @@
+#include "AsyncCmds.h"
+
+#include "hardware/sync.h"
+#include "interfaces/BaseInterface.h"
+
+AsyncCmds::AsyncCmds() : _acceptedRoutes(), _currentRoute() {
+    for(Entry &entry : _entries) {
+        entry.handler = nullptr;
+    }
+    setTimeout(0, DEFAULT_TIMEOUT_MS);
+}
+
+AsyncCmds::~AsyncCmds() {
+
+}
+
+void AsyncCmds::setTimeout(uint8_t reportId, uint32_t timeoutMs) {
+    if(reportId == 0) {
+        for(uint32_t &timeout : _timeoutsMs) {
+            timeout = timeoutMs;
+        }
+    } else {
+        _timeoutsMs[reportId] = timeoutMs;
+    }
+}
+
+bool AsyncCmds::start(uint8_t reportId, BaseInterface *handler, const CmdRoute &route) {
+    Entry *entry = find(reportId);
+    if(entry != nullptr) {
+        release(*entry); // same command started again by its interface
+    } else {
+        entry = findFree();
+    }
+    if(entry == nullptr)
+        return false;
+
+    entry->handler = handler;
+    entry->reportId = reportId;
+    entry->route = route;
+    entry->hasDeadline = _timeoutsMs[reportId] != 0;
+    entry->alarm = 0;
+    if(entry->hasDeadline) {
+        entry->deadline = make_timeout_time_ms(_timeoutsMs[reportId]);
+        // Wakes the main loop at the deadline
+        const alarm_id_t alarm = add_alarm_at(entry->deadline, alarmCallback, nullptr, true);
+        entry->alarm = alarm > 0 ? alarm : 0;
+    }
+    return true;
+}
+
+void AsyncCmds::accept(uint8_t reportId, const CmdRoute &route) {
+    _acceptedRoutes[reportId] = route;
+}
+
+CmdRoute AsyncCmds::getRoute(uint8_t reportId) const {
+    const Entry *entry = find(reportId);
+    return entry != nullptr ? entry->route : _acceptedRoutes[reportId];
+}
+
+bool AsyncCmds::complete(uint8_t reportId) {
+    Entry *entry = find(reportId);
+    if(entry == nullptr)
+        return false;
+    release(*entry);
+    return true;
+}
+
+bool AsyncCmds::takeExpired(uint8_t *reportId, CmdRoute *route) {
+    for(Entry &entry : _entries) {
+        if(entry.handler != nullptr && entry.hasDeadline && time_reached(entry.deadline)) {
+            *reportId = entry.reportId;
+            *route = entry.route;
+            entry.handler->abort(entry.reportId);
+            release(entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+AsyncCmds::Entry* AsyncCmds::find(uint8_t reportId) {
+    for(Entry &entry : _entries) {
+        if(entry.handler != nullptr && entry.reportId == reportId)
+            return &entry;
+    }
+    return nullptr;
+}
+
+const AsyncCmds::Entry* AsyncCmds::find(uint8_t reportId) const {
+    for(const Entry &entry : _entries) {
+        if(entry.handler != nullptr && entry.reportId == reportId)
+            return &entry;
+    }
+    return nullptr;
+}
+
+AsyncCmds::Entry* AsyncCmds::findFree() {
+    for(Entry &entry : _entries) {
+        if(entry.handler == nullptr)
+            return &entry;
+    }
+    return nullptr;
+}
+
+void AsyncCmds::release(Entry &entry) {
+    if(entry.alarm != 0)
+        cancel_alarm(entry.alarm);
+    entry.alarm = 0;
+    entry.handler = nullptr;
+}
+
+int64_t AsyncCmds::alarmCallback(alarm_id_t id, void *userData) {
+    (void)id;
+    (void)userData;
+    __sev(); // the main loop checks the deadlines
+    return 0;
+}
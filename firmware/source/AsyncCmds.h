@@ -0,0 +1,59 @@
+#ifndef _ASYNC_CMDS_H
+#define _ASYNC_CMDS_H
+
+#include "pico/stdlib.h"
+#include "ResponseQueue.h"
+
+class BaseInterface;
+
+// Commands whose process() returned NOT_FINISHED: their response is sent later by the task() of the interface,
+// or as | ID | CmdStatus::TIMEOUT | when their deadline is reached.
+// Each command keeps its route (tag and transport) until its last response: a command with the same report ID received
+// meanwhile (rejected by its busy interface) does not take the responses of the running one.
+class AsyncCmds {
+public:
+    static const uint32_t DEFAULT_TIMEOUT_MS = 2000;
+    static const uint32_t MAX_ASYNC_CMDS = 16;
+
+    AsyncCmds();
+    ~AsyncCmds();
+
+    // reportId 0: all commands. 0 ms: no timeout
+    void setTimeout(uint8_t reportId, uint32_t timeoutMs);
+    bool start(uint8_t reportId, BaseInterface *handler, const CmdRoute &route);
+    // Command accepted by process() (CmdStatus::OK): the next responses of a stream are sent by task() on its route
+    void accept(uint8_t reportId, const CmdRoute &route);
+    // Route of a response sent by a task(): the asynchronous command, else the last accepted one
+    CmdRoute getRoute(uint8_t reportId) const;
+    // To call for each response sent by a task(): true if it ends an asynchronous command
+    bool complete(uint8_t reportId);
+    // Aborts one expired command (BaseInterface::abort()), false if none
+    bool takeExpired(uint8_t *reportId, CmdRoute *route);
+
+    // Route of the command run by process(), for the commands it runs itself (SYS_BATCH)
+    inline void setCurrentRoute(const CmdRoute &route) { _currentRoute = route; }
+    inline const CmdRoute &getCurrentRoute() const { return _currentRoute; }
+
+protected:
+    struct Entry {
+        BaseInterface *handler; // nullptr: free
+        uint8_t reportId;
+        CmdRoute route;
+        bool hasDeadline;
+        absolute_time_t deadline;
+        alarm_id_t alarm;
+    };
+
+    Entry* find(uint8_t reportId);
+    const Entry* find(uint8_t reportId) const;
+    Entry* findFree();
+    void release(Entry &entry);
+    static int64_t alarmCallback(alarm_id_t id, void *userData);
+
+    Entry _entries[MAX_ASYNC_CMDS];
+    uint32_t _timeoutsMs[256];
+    CmdRoute _acceptedRoutes[256];
+    CmdRoute _currentRoute;
+};
+
+#endif
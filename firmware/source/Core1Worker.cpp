@@ -0,0 +1,76 @@
+#include "Core1Worker.h"
+
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "interfaces/BaseInterface.h"
+
+WorkerJob* Core1Worker::_sQueue[Core1Worker::QUEUE_SIZE];
+volatile uint32_t Core1Worker::_sHead = 0;
+volatile uint32_t Core1Worker::_sTail = 0;
+bool Core1Worker::_sStarted = false;
+
+WorkerJob::WorkerJob(BaseInterface *owner)
+    : _owner(owner), _busy(false), _stopRequested(false) {
+}
+
+WorkerJob::~WorkerJob() {
+
+}
+
+void Core1Worker::start() {
+    multicore_launch_core1(Core1Worker::loop);
+    _sStarted = true;
+}
+
+bool Core1Worker::submit(WorkerJob *job) {
+    if(job->_busy || _sHead - _sTail >= QUEUE_SIZE)
+        return false;
+    if(!_sStarted)
+        start();
+
+    job->_busy = true;
+    job->_stopRequested = false;
+    _sQueue[_sHead % QUEUE_SIZE] = job;
+    __mem_fence_release(); // job written before being published
+    _sHead = _sHead + 1;
+    __sev(); // wake core1
+    return true;
+}
+
+bool Core1Worker::popJob(WorkerJob **job) {
+    if(_sHead == _sTail)
+        return false;
+    __mem_fence_acquire();
+    *job = _sQueue[_sTail % QUEUE_SIZE];
+    _sTail = _sTail + 1;
+    return true;
+}
+
+void Core1Worker::loop() {
+    WorkerJob *activeJobs[MAX_ACTIVE_JOBS];
+    uint32_t nbActiveJobs = 0;
+
+    while(1) {
+        WorkerJob *job;
+        while(nbActiveJobs < MAX_ACTIVE_JOBS && popJob(&job)) {
+            activeJobs[nbActiveJobs++] = job;
+        }
+
+        // Round robin between jobs, resident ones are called again on next pass
+        uint32_t index = 0;
+        while(index < nbActiveJobs) {
+            job = activeJobs[index];
+            if(job->_stopRequested || job->run()) {
+                activeJobs[index] = activeJobs[--nbActiveJobs];
+                __mem_fence_release(); // job results written before being released
+                job->_busy = false;
+                job->_owner->setPending();
+            } else {
+                index++;
+            }
+        }
+
+        if(nbActiveJobs == 0 && _sHead == _sTail)
+            __wfe(); // woken by submit()
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef _CORE1_WORKER_H
+#define _CORE1_WORKER_H
+
+#include "pico/stdlib.h"
+
+class BaseInterface;
+
+// Work executed on core1. The owner interface is flagged pending (task() called on core0) when the job ends.
+class WorkerJob {
+public:
+    WorkerJob(BaseInterface *owner);
+    virtual ~WorkerJob();
+
+    // Job fields are owned by core1 while busy
+    inline bool isBusy() const { return _busy; }
+    // Resident job is ended at the end of its current step
+    inline void requestStop() { _stopRequested = true; }
+
+protected:
+    friend class Core1Worker;
+    // Called on core1: true when finished, false to be called again (resident job sharing core1 with the others)
+    virtual bool run() = 0;
+
+    BaseInterface *_owner;
+    volatile bool _busy;
+    volatile bool _stopRequested;
+};
+
+// Core1 loop running the jobs submitted by core0 through a lock-free single producer / single consumer queue.
+// Core1 is launched by the first job (Hub75 refresh, SPI transfers), it stays off otherwise.
+class Core1Worker {
+public:
+    // Core0 only: false if the queue is full or the job is already busy
+    static bool submit(WorkerJob *job);
+
+protected:
+    static void start();
+    static void loop();
+    static bool popJob(WorkerJob **job);
+
+    static const uint32_t QUEUE_SIZE = 16;
+    static const uint32_t MAX_ACTIVE_JOBS = 8;
+    static WorkerJob* _sQueue[QUEUE_SIZE];
+    // Free running indexes, _sHead written by core0 only, _sTail by core1 only
+    static volatile uint32_t _sHead;
+    static volatile uint32_t _sTail;
+    static bool _sStarted;
+};
+
+#endif
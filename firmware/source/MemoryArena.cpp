@@ -0,0 +1,75 @@
+#include "MemoryArena.h"
+
+uint32_t MemoryArena::_sArena[MemoryArena::NB_WORDS];
+bool MemoryArena::_sInitialized = false;
+
+void MemoryArena::init() {
+    _sArena[0] = NB_WORDS; // one free block
+    _sInitialized = true;
+}
+
+void* MemoryArena::allocate(uint32_t sizeInBytes) {
+    if(!_sInitialized)
+        init();
+    if(sizeInBytes == 0)
+        return nullptr;
+
+    const uint32_t nbWords = (sizeInBytes + 3) / 4 + 1;
+    uint32_t index = 0;
+    while(index < NB_WORDS) {
+        const uint32_t blockWords = _sArena[index] & ~USED_FLAG;
+        if(!(_sArena[index] & USED_FLAG) && blockWords >= nbWords) {
+            // Split if the remaining part can hold a header and some data
+            if(blockWords - nbWords > 1) {
+                _sArena[index + nbWords] = blockWords - nbWords;
+                _sArena[index] = nbWords;
+            }
+            _sArena[index] |= USED_FLAG;
+            return &_sArena[index + 1];
+        }
+        index += blockWords;
+    }
+    return nullptr;
+}
+
+void MemoryArena::release(void *ptr) {
+    if(ptr == nullptr)
+        return;
+    uint32_t *header = static_cast<uint32_t*>(ptr) - 1;
+    *header &= ~USED_FLAG;
+
+    // Merge adjacent free blocks
+    uint32_t index = 0;
+    while(index < NB_WORDS) {
+        const uint32_t blockWords = _sArena[index] & ~USED_FLAG;
+        const uint32_t next = index + blockWords;
+        if(!(_sArena[index] & USED_FLAG) && next < NB_WORDS && !(_sArena[next] & USED_FLAG)) {
+            _sArena[index] = blockWords + _sArena[next];
+        } else {
+            index = next;
+        }
+    }
+}
+
+uint32_t MemoryArena::getFreeSize() {
+    if(!_sInitialized)
+        init();
+    uint32_t freeWords = 0;
+    for(uint32_t index = 0; index < NB_WORDS; index += _sArena[index] & ~USED_FLAG) {
+        if(!(_sArena[index] & USED_FLAG))
+            freeWords += (_sArena[index] & ~USED_FLAG) - 1;
+    }
+    return freeWords * 4;
+}
+
+uint32_t MemoryArena::getLargestFreeBlock() {
+    if(!_sInitialized)
+        init();
+    uint32_t largestWords = 0;
+    for(uint32_t index = 0; index < NB_WORDS; index += _sArena[index] & ~USED_FLAG) {
+        const uint32_t blockWords = _sArena[index] & ~USED_FLAG;
+        if(!(_sArena[index] & USED_FLAG) && blockWords - 1 > largestWords)
+            largestWords = blockWords - 1;
+    }
+    return largestWords * 4;
+}
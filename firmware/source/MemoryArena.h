@@ -0,0 +1,29 @@
+#ifndef _MEMORY_ARENA_H
+#define _MEMORY_ARENA_H
+
+#include "pico/stdlib.h"
+#include "board_config.h"
+
+// Fixed RAM area lent to the interfaces between their init and deinit (first fit, 32-bit aligned).
+// Only used from the main loop on core0.
+class MemoryArena {
+public:
+    // nullptr when the arena is exhausted
+    static void* allocate(uint32_t sizeInBytes);
+    static void release(void *ptr);
+
+    static inline uint32_t getSize() { return ARENA_SIZE; }
+    static uint32_t getFreeSize();
+    static uint32_t getLargestFreeBlock();
+
+protected:
+    static void init();
+
+    // Block header: size in words (header included), USED_FLAG if allocated
+    static const uint32_t USED_FLAG = 0x80000000u;
+    static const uint32_t NB_WORDS = ARENA_SIZE / 4;
+    static uint32_t _sArena[NB_WORDS];
+    static bool _sInitialized;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "ResponseQueue.h"
+
+#include <string.h>
+#include "hardware/sync.h"
+
+ResponseQueue::ResponseQueue()
+    : _head(0), _tail(0) {
+    resetStats();
+}
+
+ResponseQueue::~ResponseQueue() {
+
+}
+
+bool ResponseQueue::push(CmdTransport transport, uint8_t const *data) {
+    if(isFull()) {
+        _stats.droppedResponses++;
+        return false;
+    }
+
+    Entry &entry = _entries[_head % SIZE];
+    entry.transport = transport;
+    memcpy(entry.data, data, HID_RESPONSE_SIZE);
+    __mem_fence_release(); // entry written before being published
+    _head = _head + 1;
+
+    if(level() > _stats.highWater)
+        _stats.highWater = level();
+    return true;
+}
+
+ResponseQueue::Entry* ResponseQueue::front() {
+    if(isEmpty())
+        return nullptr;
+    __mem_fence_acquire();
+    return &_entries[_tail % SIZE];
+}
+
+void ResponseQueue::pop() {
+    if(isEmpty())
+        return;
+    __mem_fence_release(); // entry read before being released
+    _tail = _tail + 1;
+}
+
+void ResponseQueue::resetStats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,60 @@
+#ifndef _RESPONSE_QUEUE_H
+#define _RESPONSE_QUEUE_H
+
+#include "pico/stdlib.h"
+#include "interfaces/PicoInterfacesBoard.h"
+
+// Channel on which a command was received, its responses are sent on the same one
+enum CmdTransport {
+    HID = 0,
+    BULK = 1,
+    BATCH = 2 // response of an asynchronous sub-command, given back to the waiting SYS_BATCH (System::resumeBatch())
+};
+
+// Where the responses of a command go: its SYS_TAGGED tag (0: untagged) and transport
+struct CmdRoute {
+    uint8_t tag;
+    CmdTransport transport;
+};
+
+// Lock-free single producer / single consumer ring of responses waiting for their endpoint
+class ResponseQueue {
+public:
+    struct Entry {
+        CmdTransport transport;
+        uint8_t data[HID_RESPONSE_SIZE];
+    };
+
+    struct Stats {
+        uint32_t highWater;        // max level reached
+        uint32_t droppedResponses; // push on full queue
+        uint32_t deferredCmds;     // commands delayed because the queue was full
+        uint32_t droppedCmds;      // commands lost because the delayed commands queue was full too, or bulk packets
+                                   // dropped on a SIZE over 64
+    };
+
+    static const uint32_t SIZE = 64;
+
+    ResponseQueue();
+    ~ResponseQueue();
+
+    bool push(CmdTransport transport, uint8_t const *data);
+    Entry* front();
+    void pop();
+
+    inline uint32_t level() const { return _head - _tail; }
+    inline uint32_t freeSpace() const { return SIZE - level(); }
+    inline bool isEmpty() const { return level() == 0; }
+    inline bool isFull() const { return level() >= SIZE; }
+    inline Stats& stats() { return _stats; }
+    void resetStats();
+
+protected:
+    Entry _entries[SIZE];
+    // Free running indexes, _head written by producer only, _tail by consumer only
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+    Stats _stats;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "Stats.h"
+
+#include <string.h>
+#include <algorithm>
+
+Stats::Duration Stats::_sCmds[256];
+Stats::InterfaceStats Stats::_sInterfaces[MAX_INTERFACES];
+Stats::Duration Stats::_sLoop;
+Stats::Duration Stats::_sUsb;
+uint64_t Stats::_sSleepUs = 0;
+uint64_t Stats::_sResetTimeUs = 0;
+
+void Stats::reset() {
+    memset(_sCmds, 0, sizeof(_sCmds));
+    memset(_sInterfaces, 0, sizeof(_sInterfaces));
+    memset(&_sLoop, 0, sizeof(_sLoop));
+    memset(&_sUsb, 0, sizeof(_sUsb));
+    _sSleepUs = 0;
+    _sResetTimeUs = time_us_64();
+}
+
+void Stats::record(Duration &duration, uint32_t durationUs) {
+    // Two bits of the duration per bucket
+    uint bucket = 0;
+    if(durationUs >= 4)
+        bucket = std::min(static_cast<uint>(31 - __builtin_clz(durationUs)) / 2, NB_BUCKETS - 1);
+
+    duration.count++;
+    duration.totalUs += durationUs;
+    duration.maxUs = std::max(duration.maxUs, durationUs);
+    duration.histogram[bucket]++;
+}
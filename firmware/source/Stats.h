@@ -0,0 +1,55 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "pico/stdlib.h"
+
+// Always-on performance counters, updated by the main loop (core 0) only.
+// Durations are measured with the 1 MHz timer, counters are read by SYS_GET_STATS.
+class Stats {
+public:
+    // Bucket 0: < 4 us, bucket i: [4^i, 4^(i+1)[ us, last bucket: >= 16384 us
+    static const uint NB_BUCKETS = 8;
+    static const uint MAX_INTERFACES = 32;
+
+    struct Duration {
+        uint32_t count;
+        uint32_t maxUs;
+        uint64_t totalUs;
+        uint32_t histogram[NB_BUCKETS];
+    };
+
+    struct InterfaceStats {
+        Duration task;
+        uint64_t cdcBytes; // read from the CDC stream
+    };
+
+    static inline uint32_t now() { return time_us_32(); }
+
+    // Durations since startUs (now() taken before the measured code)
+    static inline void recordCmd(uint8_t reportId, uint32_t startUs) { record(_sCmds[reportId], now() - startUs); }
+    static inline void recordTask(uint interfaceIndex, uint32_t startUs) { record(_sInterfaces[interfaceIndex].task, now() - startUs); }
+    static inline void recordLoop(uint32_t startUs) { record(_sLoop, now() - startUs); }
+    static inline void recordUsb(uint32_t startUs) { record(_sUsb, now() - startUs); }
+    static inline void recordSleep(uint32_t startUs) { _sSleepUs += now() - startUs; }
+    static inline void addCdcBytes(uint interfaceIndex, uint32_t nbBytes) { _sInterfaces[interfaceIndex].cdcBytes += nbBytes; }
+    static void reset();
+
+    static inline const Duration& getCmd(uint8_t reportId) { return _sCmds[reportId]; }
+    static inline const InterfaceStats& getInterface(uint interfaceIndex) { return _sInterfaces[interfaceIndex]; }
+    static inline const Duration& getLoop() { return _sLoop; }
+    static inline const Duration& getUsb() { return _sUsb; }
+    static inline uint64_t getSleepUs() { return _sSleepUs; }
+    static inline uint64_t getElapsedUs() { return time_us_64() - _sResetTimeUs; }
+
+protected:
+    static void record(Duration &duration, uint32_t durationUs);
+
+    static Duration _sCmds[256];
+    static InterfaceStats _sInterfaces[MAX_INTERFACES];
+    static Duration _sLoop;    // main loop iteration, sleep excluded
+    static Duration _sUsb;     // tud_task()
+    static uint64_t _sSleepUs; // time in __wfe()
+    static uint64_t _sResetTimeUs;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "Trace.h"
+
+#include "hardware/sync.h"
+
+Trace::Event Trace::_sEvents[SIZE];
+volatile uint32_t Trace::_sHead = 0;
+volatile uint32_t Trace::_sTail = 0;
+volatile bool Trace::_sEnabled = false;
+uint32_t Trace::_sDroppedEvents = 0;
+
+void Trace::start() {
+    const uint32_t irqStatus = save_and_disable_interrupts();
+    _sHead = 0;
+    _sTail = 0;
+    _sDroppedEvents = 0;
+    _sEnabled = true;
+    restore_interrupts(irqStatus);
+}
+
+void Trace::stop() {
+    _sEnabled = false;
+}
+
+void Trace::push(TRACE_EVENT type, uint8_t id, uint16_t arg) {
+    // IRQs record events too
+    const uint32_t irqStatus = save_and_disable_interrupts();
+    if(_sHead - _sTail >= SIZE) {
+        _sDroppedEvents++;
+    } else {
+        Event &event = _sEvents[_sHead % SIZE];
+        event.timeUs = time_us_32();
+        event.type = static_cast<uint8_t>(type);
+        event.id = id;
+        event.arg = arg;
+        _sHead = _sHead + 1;
+    }
+    restore_interrupts(irqStatus);
+}
+
+uint Trace::read(Event *events, uint maxEvents) {
+    const uint32_t irqStatus = save_and_disable_interrupts();
+    uint nbEvents = 0;
+    while(nbEvents < maxEvents && _sTail != _sHead) {
+        events[nbEvents++] = _sEvents[_sTail % SIZE];
+        _sTail = _sTail + 1;
+    }
+    restore_interrupts(irqStatus);
+    return nbEvents;
+}
@@ -0,0 +1,45 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "pico/stdlib.h"
+#include "interfaces/PicoInterfacesBoard.h"
+
+// Timestamped events ring, drained by SYS_TRACE_READ. Stopped at boot, started by SYS_TRACE_CTRL.
+// Recorded on core 0 only (main loop and IRQs). Events are dropped (and counted) while the ring is full.
+class Trace {
+public:
+    struct Event {
+        uint32_t timeUs;
+        uint8_t type; // TRACE_EVENT
+        uint8_t id;   // report ID or interface index
+        uint16_t arg;
+    };
+
+    static const uint32_t SIZE = 1024;
+
+    static inline void record(TRACE_EVENT type, uint8_t id, uint16_t arg = 0) {
+        if(_sEnabled)
+            push(type, id, arg);
+    }
+    // Clears the ring before starting
+    static void start();
+    static void stop();
+    // Oldest events first, returns the number of events copied
+    static uint read(Event *events, uint maxEvents);
+
+    static inline bool isEnabled() { return _sEnabled; }
+    static inline uint32_t level() { return _sHead - _sTail; }
+    static inline uint32_t getDroppedEvents() { return _sDroppedEvents; }
+
+protected:
+    static void push(TRACE_EVENT type, uint8_t id, uint16_t arg);
+
+    static Event _sEvents[SIZE];
+    // Free running indexes
+    static volatile uint32_t _sHead;
+    static volatile uint32_t _sTail;
+    static volatile bool _sEnabled;
+    static uint32_t _sDroppedEvents;
+};
+
+#endif
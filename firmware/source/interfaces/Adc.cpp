@@ -3,6 +3,10 @@
 
 Adc::Adc() {
     setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::ADC_INIT_PIN,
+        Report::ID::ADC_GET_VALUE
+    });
     adc_init();
 }
 
@@ -2,10 +2,26 @@
 
 #include <algorithm>
 #include "tusb.h"
+#include "hardware/sync.h"
 
 
+BaseInterface* BaseInterface::_sReportHandlers[256] = {nullptr};
+BaseInterface* BaseInterface::_sInterfaces[32] = {nullptr};
+uint BaseInterface::_sInterfaceCount = 0;
+uint BaseInterface::_sResponsePayloadSize = HID_RESPONSE_SIZE - 2;
+volatile uint32_t BaseInterface::_sPendingMask = 0;
+uint32_t BaseInterface::_sCdcRxWaiters = 0;
+critical_section_t BaseInterface::_sPendingCritSec;
+
 BaseInterface::BaseInterface() :
-    _interfaceState(InterfaceState::NOT_INITIALIZED) {
+    _interfaceState(InterfaceState::NOT_INITIALIZED),
+    _firstReportId(0) {
+    // One bit per interface, interfaces are static objects constructed on core 0
+    hard_assert(_sInterfaceCount < 32);
+    if(_sInterfaceCount == 0)
+        critical_section_init(&_sPendingCritSec);
+    _sInterfaces[_sInterfaceCount] = this;
+    _pendingBit = 1u << _sInterfaceCount++;
 }
 
 BaseInterface::~BaseInterface(){
@@ -13,6 +29,41 @@ BaseInterface::~BaseInterface(){
 }
 
 
+void BaseInterface::registerReports(std::initializer_list<uint> reportIds) {
+    if(reportIds.size() > 0)
+        _firstReportId = static_cast<uint8_t>(*reportIds.begin());
+    for(uint reportId : reportIds) {
+        _sReportHandlers[reportId & 0xFF] = this;
+    }
+}
+
+void BaseInterface::setPending() {
+    setPendingMask(_pendingBit);
+}
+
+void BaseInterface::setPendingMask(uint32_t mask) {
+    if(mask == 0)
+        return;
+    critical_section_enter_blocking(&_sPendingCritSec);
+    _sPendingMask |= mask;
+    critical_section_exit(&_sPendingCritSec);
+    __sev(); // wake the main loop from __wfe()
+}
+
+uint32_t BaseInterface::takePendingMask() {
+    critical_section_enter_blocking(&_sPendingCritSec);
+    const uint32_t mask = _sPendingMask;
+    _sPendingMask = 0;
+    critical_section_exit(&_sPendingCritSec);
+    return mask;
+}
+
+void BaseInterface::signalCdcRx() {
+    const uint32_t waiters = _sCdcRxWaiters;
+    _sCdcRxWaiters = 0;
+    setPendingMask(waiters);
+}
+
 CmdStatus BaseInterface::process(uint8_t const *cmd, uint8_t response[64]) {
     (void)cmd;
     (void)response;
@@ -24,6 +75,10 @@ CmdStatus BaseInterface::task(uint8_t response[64]) {
     return CmdStatus::NOT_CONCERNED;
 }
 
+void BaseInterface::abort(uint8_t reportId) {
+    (void)reportId;
+}
+
 void BaseInterface::convertUInt32ToBytes(uint32_t value, uint8_t *array) {
     array[0] = static_cast<uint8_t>(value & 0xFF);
     array[1] = static_cast<uint8_t>((value >> 8) & 0xFF);
@@ -2,7 +2,9 @@
 #define _BASE_INTERFACES_PICO_H
 
 #include <stdio.h>
+#include <initializer_list>
 #include "pico/stdlib.h"
+#include "pico/critical_section.h"
 #include "../tusb_config.h"
 
 #include "PicoInterfacesBoard.h"
@@ -17,19 +19,62 @@ public:
 
     BaseInterface();
     virtual ~BaseInterface();
+    // NOT_FINISHED: asynchronous command, its response is sent later by task() with the command report ID
     virtual CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
+    // Only called when pending: task() is called again unless it returns NOT_CONCERNED or waits for CDC data
     virtual CmdStatus task(uint8_t response[64]);
+    // Asynchronous command timed out (TIMEOUT response already sent): its response must not be sent by task()
+    virtual void abort(uint8_t reportId);
     inline InterfaceState getInterfaceState() const { return _interfaceState;}
     static void convertUInt32ToBytes(uint32_t value, uint8_t *array);
     static void convertUInt16ToBytes(uint16_t value, uint8_t *array);
     static uint32_t convertBytesToUInt32(const uint8_t *array);
     static uint16_t convertBytesToUInt16(const uint8_t *array);
+    // Interface which claimed the report ID or nullptr
+    static inline BaseInterface* getReportHandler(uint8_t reportId) { return _sReportHandlers[reportId]; }
+    // Interfaces are indexed in construction order (same index as their pending bit)
+    inline uint getInterfaceIndex() const { return static_cast<uint>(__builtin_ctz(_pendingBit)); }
+    inline uint8_t getFirstReportId() const { return _firstReportId; }
+    static inline uint getInterfaceCount() { return _sInterfaceCount; }
+    static inline BaseInterface* getInterface(uint index) { return index < _sInterfaceCount ? _sInterfaces[index] : nullptr; }
+    // Response bytes after | ID | STATUS | that reach the host for the command given to process(): 60 for a tagged
+    // command (| SYS_TAGGED | TAG | prefix). Commands asking for more data are answered NOK.
+    static inline uint getResponsePayloadSize() { return _sResponsePayloadSize; }
+    static inline void setResponsePayloadSize(uint size) { _sResponsePayloadSize = size; }
+
+    // Pending work: the main loop calls task() of flagged interfaces and sleeps when none is.
+    // setPending() can be called from IRQ or from the other core.
+    void setPending();
+    inline uint32_t getPendingBit() const { return _pendingBit; }
+    inline bool isWaitingCdcRx() const { return (_sCdcRxWaiters & _pendingBit) != 0; }
+    static uint32_t takePendingMask();
+    static void setPendingMask(uint32_t mask);
+    static inline bool hasPendingInterfaces() { return _sPendingMask != 0; }
+    // To call when CDC data is received: flags the interfaces waiting for it
+    static void signalCdcRx();
 
 protected:
     inline void setInterfaceState(InterfaceState interfaceState) {_interfaceState = interfaceState;}
-    
+    // To call once in constructor: process() is only called for the claimed report IDs
+    void registerReports(std::initializer_list<uint> reportIds);
+    // task() is called again when CDC data is received (main loop only)
+    inline void waitCdcRx() { _sCdcRxWaiters |= _pendingBit; }
+    // When task() must be polled again whatever CDC receives (main loop only)
+    inline void cancelWaitCdcRx() { _sCdcRxWaiters &= ~_pendingBit; }
 
     InterfaceState _interfaceState;
+
+private:
+    static BaseInterface* _sReportHandlers[256];
+    static BaseInterface* _sInterfaces[32];
+
+    uint32_t _pendingBit;
+    uint8_t _firstReportId;
+    static uint _sInterfaceCount;
+    static uint _sResponsePayloadSize;
+    static volatile uint32_t _sPendingMask;
+    static uint32_t _sCdcRxWaiters;
+    static critical_section_t _sPendingCritSec;
 };
 
 
@@ -2,14 +2,40 @@
 //#include <algorithm>
 
 #include "tusb.h"
+#include "../MemoryArena.h"
+#include "../Stats.h"
+#include "../Trace.h"
 
 BufferedInterface::BufferedInterface(uint32_t bufferSizeInBytes, uint32_t bufferCount)
     : _bufSize(bufferSizeInBytes), _bufCount(bufferCount),
       _circularBuffer(bufferCount, Buffer(bufferSizeInBytes + 1)),
-      _inputIndex(0), _outputIndex(0) {
+      _inputIndex(0), _outputIndex(0), _bufferMemory(nullptr) {
     critical_section_init(&_critSec);
 }
 
+bool BufferedInterface::acquireBuffers() {
+    if(_bufferMemory == nullptr) {
+        const uint32_t nbWords = _circularBuffer[0].nbWords;
+        _bufferMemory = static_cast<uint32_t*>(MemoryArena::allocate(_bufCount * nbWords * 4));
+        if(_bufferMemory == nullptr)
+            return false;
+        for(uint i = 0; i<_bufCount; i++) {
+            _circularBuffer[i].data = _bufferMemory + i * nbWords;
+        }
+    }
+    resetBuffers();
+    return true;
+}
+
+void BufferedInterface::releaseBuffers() {
+    resetBuffers();
+    for(uint i = 0; i<_bufCount; i++) {
+        _circularBuffer[i].data = nullptr;
+    }
+    MemoryArena::release(_bufferMemory);
+    _bufferMemory = nullptr;
+}
+
 BufferedInterface::~BufferedInterface() {
 
 }
@@ -99,7 +125,10 @@ void BufferedInterface::flushStreamRx() {
 }
 
 uint32_t BufferedInterface::streamRxAvailableSize() {
-    return tud_cdc_available();
+    const uint32_t available = tud_cdc_available();
+    if(available == 0)
+        waitCdcRx();
+    return available;
 }
 
 bool BufferedInterface::streamRxRead() {
@@ -108,7 +137,11 @@ bool BufferedInterface::streamRxRead() {
         return 0; // error
 
     uint32_t nbByteCanRead = std::min(currentInputBuffer.size - currentInputBuffer.progressSize, streamRxAvailableSize());
-    currentInputBuffer.progressSize += tud_cdc_read(currentInputBuffer.getDataPtr8() + currentInputBuffer.progressSize, nbByteCanRead);
+    const uint32_t nbRead = tud_cdc_read(currentInputBuffer.getDataPtr8() + currentInputBuffer.progressSize, nbByteCanRead);
+    Stats::addCdcBytes(getInterfaceIndex(), nbRead);
+    if(nbRead > 0)
+        Trace::record(TRACE_EVENT::TRACE_CDC_READ, getInterfaceIndex(), static_cast<uint16_t>(nbRead));
+    currentInputBuffer.progressSize += nbRead;
     //printf("progressSize %d, size: %d", currentInputBuffer.progressSize, currentInputBuffer.size);
     return (currentInputBuffer.progressSize >= currentInputBuffer.size);
 }
@@ -6,7 +6,7 @@
 #include "pico/critical_section.h"
 
 struct Buffer {
-    Buffer(uint32_t bufferSizeInBytes) : vector(bufferSizeInBytes/4 +1, 0){}
+    Buffer(uint32_t bufferSizeInBytes) : nbWords(bufferSizeInBytes/4 +1){}
 
     enum BUFFER_STATE {
         FREE = 0x00,
@@ -14,9 +14,11 @@ struct Buffer {
         OUTPUT = 0x02
     };
 
-    inline uint8_t* getDataPtr8() {return (uint8_t*)vector.data();}
+    inline uint8_t* getDataPtr8() {return (uint8_t*)data;}
+    inline uint32_t* getDataPtr32() {return data;}
 
-    std::vector<uint32_t> vector; // to be 32-bit aligned for dma
+    uint32_t *data = nullptr; // in the memory arena, 32-bit aligned for dma
+    uint32_t nbWords;
     BUFFER_STATE state = FREE;
     uint32_t progressSize = 0;
     uint32_t size = 0;
@@ -28,6 +30,9 @@ public:
     virtual ~BufferedInterface();
 
 protected:
+    // Buffers taken from the memory arena at init and given back at deinit: false if the arena is exhausted
+    bool acquireBuffers();
+    void releaseBuffers();
     Buffer* acquireInputBuffer();
     void releaseInputBuffer();
     Buffer* acquireOutputBuffer();
@@ -39,6 +44,7 @@ protected:
     uint32_t _bufCount;
     std::vector<Buffer> _circularBuffer;
     uint32_t _inputIndex, _outputIndex;
+    uint32_t *_bufferMemory;
     critical_section_t _critSec;
 
 
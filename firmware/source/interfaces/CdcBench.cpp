@@ -0,0 +1,157 @@
+#include "CdcBench.h"
+
+#include "tusb.h"
+#include "../Stats.h"
+
+CdcBench::CdcBench(uint streamBufferSize)
+    : StreamedInterface(streamBufferSize),
+      _mode(0),
+      _nbBytes(0),
+      _chunkSize(0),
+      _startUs(0),
+      _endUs(0),
+      _stalled(false),
+      _stallStartUs(0),
+      _nbStalls(0),
+      _stallUs(0),
+      _maxStallUs(0) {
+    setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::SYS_BENCH_CDC_SINK,
+        Report::ID::SYS_BENCH_CDC_SOURCE,
+        Report::ID::SYS_BENCH_CDC_LOOPBACK
+    });
+}
+
+CdcBench::~CdcBench() {
+
+}
+
+CmdStatus CdcBench::process(uint8_t const *cmd, uint8_t response[64]) {
+    (void)response;
+    CmdStatus status = CmdStatus::NOT_CONCERNED;
+
+    if(cmd[0] == Report::ID::SYS_BENCH_CDC_SINK || cmd[0] == Report::ID::SYS_BENCH_CDC_SOURCE ||
+            cmd[0] == Report::ID::SYS_BENCH_CDC_LOOPBACK) {
+        status = start(cmd);
+    }
+
+    return status;
+}
+
+CmdStatus CdcBench::start(uint8_t const *cmd) {
+    // A new test replaces the running one
+    releaseStreamBuffers();
+    _mode = 0;
+    if(!acquireStreamBuffers()) {
+        return CmdStatus::NOK; // memory arena exhausted
+    }
+    flushStreamRx();
+
+    StreamBuffer &buf = getBuffer();
+    const uint32_t chunkSize = convertBytesToUInt16(&cmd[5]);
+    _chunkSize = (chunkSize == 0 || chunkSize > buf.getAllocateSize()) ? buf.getAllocateSize() : chunkSize;
+    _nbBytes = convertBytesToUInt32(&cmd[1]);
+    _totalRemainingBytesToSend = _nbBytes;
+    _stalled = false;
+    _nbStalls = 0;
+    _stallUs = 0;
+    _maxStallUs = 0;
+    _mode = cmd[0];
+
+    if(_mode == Report::ID::SYS_BENCH_CDC_SOURCE) {
+        // Written from offset (sent bytes % 256) to count from 0
+        uint8_t *data = buf.getDataPtr8();
+        for(uint32_t it = 0; it < buf.getAllocateSize(); it++) {
+            data[it] = static_cast<uint8_t>(it);
+        }
+    }
+    return CmdStatus::OK;
+}
+
+CmdStatus CdcBench::task(uint8_t response[64]) {
+    if(_mode == 0)
+        return CmdStatus::NOT_CONCERNED;
+
+    uint32_t nbMoved = 0;
+    if(_totalRemainingBytesToSend > 0) {
+        if(_mode == Report::ID::SYS_BENCH_CDC_SINK)
+            nbMoved = sink();
+        else if(_mode == Report::ID::SYS_BENCH_CDC_SOURCE)
+            nbMoved = source();
+        else
+            nbMoved = loopback();
+    }
+
+    const uint32_t nowUs = Stats::now();
+    const bool started = _totalRemainingBytesToSend + nbMoved < _nbBytes;
+    if(nbMoved > 0) {
+        if(!started)
+            _startUs = nowUs;
+        if(_stalled) {
+            const uint32_t stallUs = nowUs - _stallStartUs;
+            _stallUs += stallUs;
+            _maxStallUs = std::max(_maxStallUs, stallUs);
+            _stalled = false;
+        }
+        _totalRemainingBytesToSend -= nbMoved;
+        _endUs = nowUs;
+    } else if(started && !_stalled && _totalRemainingBytesToSend > 0) {
+        // Waiting for the host, the time before the first byte is not counted
+        _stalled = true;
+        _stallStartUs = nowUs;
+        _nbStalls++;
+    }
+
+    if(_totalRemainingBytesToSend > 0)
+        return CmdStatus::NOT_FINISHED;
+
+    response[0] = _mode;
+    convertUInt32ToBytes(_nbBytes > 0 ? _endUs - _startUs : 0, &response[2]);
+    convertUInt32ToBytes(_nbBytes, &response[6]);
+    convertUInt32ToBytes(_nbStalls, &response[10]);
+    convertUInt32ToBytes(_stallUs, &response[14]);
+    convertUInt32ToBytes(_maxStallUs, &response[18]);
+    end();
+    return CmdStatus::OK;
+}
+
+uint32_t CdcBench::sink() {
+    StreamBuffer &buf = getBuffer();
+    buf.setSize(0);
+    // Waits for CDC data when empty (task() called again on reception)
+    return streamRxRead(std::min(_chunkSize, _totalRemainingBytesToSend));
+}
+
+uint32_t CdcBench::source() {
+    StreamBuffer &buf = getBuffer();
+    const uint32_t offset = (_nbBytes - _totalRemainingBytesToSend) % 256;
+    const uint32_t nbBytes = std::min({_chunkSize, _totalRemainingBytesToSend, tud_cdc_write_available(),
+                                       buf.getAllocateSize() - offset});
+    if(nbBytes == 0)
+        return 0; // host not reading, task() polled
+    const uint32_t nbWritten = tud_cdc_write(buf.getDataPtr8() + offset, nbBytes);
+    tud_cdc_write_flush();
+    Stats::addCdcBytes(getInterfaceIndex(), nbWritten);
+    return nbWritten;
+}
+
+uint32_t CdcBench::loopback() {
+    StreamBuffer &buf = getBuffer();
+    const uint32_t nbBytes = std::min({_chunkSize, _totalRemainingBytesToSend, tud_cdc_write_available()});
+    if(nbBytes == 0)
+        return 0; // host not reading, task() polled
+    buf.setSize(0);
+    const uint32_t nbRead = streamRxRead(nbBytes);
+    if(nbRead == 0)
+        return 0;
+    const uint32_t nbWritten = tud_cdc_write(buf.getDataPtr8(), nbRead);
+    tud_cdc_write_flush();
+    Stats::addCdcBytes(getInterfaceIndex(), nbWritten);
+    return nbWritten;
+}
+
+void CdcBench::end() {
+    _mode = 0;
+    releaseStreamBuffers();
+}
@@ -0,0 +1,39 @@
+#ifndef _INTERFACE_CDC_BENCH_H
+#define _INTERFACE_CDC_BENCH_H
+
+#include "PicoInterfacesBoard.h"
+#include "StreamedInterface.h"
+
+
+// CDC throughput self-tests (SYS_BENCH_CDC_*), the ceiling of the streamed interfaces: the bytes go through
+// streamRxRead() as theirs, without a bus behind.
+class CdcBench : public StreamedInterface {
+public:
+    CdcBench(uint streamBufferSize);
+    virtual ~CdcBench();
+
+    CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
+    CmdStatus task(uint8_t response[64]);
+
+protected:
+    CmdStatus start(uint8_t const *cmd);
+    // Bytes moved by one pass: 0 when waiting for the host
+    uint32_t sink();
+    uint32_t source();
+    uint32_t loopback();
+    void end();
+
+    uint8_t _mode; // report ID of the running test, 0 when idle
+    uint32_t _nbBytes;
+    uint32_t _chunkSize;
+    uint32_t _startUs;
+    uint32_t _endUs;
+    bool _stalled;
+    uint32_t _stallStartUs;
+    uint32_t _nbStalls;
+    uint32_t _stallUs;
+    uint32_t _maxStallUs;
+};
+
+
+#endif
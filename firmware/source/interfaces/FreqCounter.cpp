@@ -2,10 +2,20 @@
 #include "FreqCounter.h"
 #include "freq_counter.pio.h" // Generated header
 #include "hardware/clocks.h"
+#include "hardware/irq.h"
 #include <stdio.h> // For debugging printf if needed
 
-FreqCounter::FreqCounter() {
+FreqCounter *FreqCounter::_sInstance = nullptr;
+
+FreqCounter::FreqCounter()
+    : _measureIdx(-1) {
+    _sInstance = this;
     setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::FREQ_COUNTER_INIT,
+        Report::ID::FREQ_COUNTER_DEINIT,
+        Report::ID::FREQ_COUNTER_GET_MEASUREMENT
+    });
     for (int i = 0; i < MAX_FREQ_COUNTERS; ++i) {
         counters[i].active = false;
         counters[i].pin = -1;
@@ -50,6 +60,50 @@ CmdStatus FreqCounter::process(uint8_t const *cmd, uint8_t response[64]) {
     return status;
 }
 
+CmdStatus FreqCounter::task(uint8_t response[64]) {
+    if (_measureIdx == -1) {
+        return CmdStatus::NOT_CONCERNED;
+    }
+    FreqCounterInfo &counter = counters[_measureIdx];
+    if (!freq_counter_measurement_ready(counter.pio, counter.sm)) {
+        return CmdStatus::NOT_CONCERNED; // woken by pioIrqHandler()
+    }
+    pio_set_irq0_source_enabled(counter.pio, static_cast<pio_interrupt_source>(pis_interrupt0 + counter.sm), false);
+    pio_interrupt_clear(counter.pio, counter.sm);
+
+    uint32_t high_rem, low_rem;
+    freq_counter_read_measurement(counter.pio, counter.sm, &high_rem, &low_rem);
+    _measureIdx = -1;
+
+    // Pack results into response buffer (Little Endian)
+    response[0] = Report::ID::FREQ_COUNTER_GET_MEASUREMENT;
+    response[2] = counter.pin;
+    convertUInt32ToBytes(high_rem, &response[3]); // Bytes 3, 4, 5, 6
+    convertUInt32ToBytes(low_rem, &response[7]);  // Bytes 7, 8, 9, 10
+    return CmdStatus::OK;
+}
+
+void FreqCounter::abort(uint8_t reportId) {
+    if (reportId == Report::ID::FREQ_COUNTER_GET_MEASUREMENT && _measureIdx != -1) {
+        FreqCounterInfo &counter = counters[_measureIdx];
+        pio_set_irq0_source_enabled(counter.pio, static_cast<pio_interrupt_source>(pis_interrupt0 + counter.sm), false);
+        freq_counter_stop_measurement(counter.pio, counter.sm, counter.pio_offset);
+        pio_interrupt_clear(counter.pio, counter.sm);
+        _measureIdx = -1;
+    }
+}
+
+void FreqCounter::pioIrqHandler() {
+    // Flag raised by the state machine after its second push, shared with the other PIO users
+    if (_sInstance == nullptr || _sInstance->_measureIdx == -1)
+        return;
+    const FreqCounterInfo &counter = _sInstance->counters[_sInstance->_measureIdx];
+    if (!pio_interrupt_get(counter.pio, counter.sm))
+        return;
+    pio_set_irq0_source_enabled(counter.pio, static_cast<pio_interrupt_source>(pis_interrupt0 + counter.sm), false);
+    _sInstance->setPending(); // task() reads the measurement
+}
+
 bool FreqCounter::findFreeSM(PIO *pio_out, uint *sm_out) {
     for (uint pio_idx = 0; pio_idx < NUM_PIOS; ++pio_idx) {
         PIO pio = pio_idx == 0 ? pio0 : pio1;
@@ -165,6 +219,9 @@ CmdStatus FreqCounter::deinitCounter(uint8_t const *cmd, uint8_t response[64]) {
         // Pin not found or not initialized for frequency counting
         return CmdStatus::NOK; // Or OK if deiniting non-existent is fine? Let's say NOK.
     }
+    if (idx == _measureIdx) {
+        return CmdStatus::NOK; // Measurement in progress
+    }
 
     // Disable and release resources
     pio_sm_set_enabled(counters[idx].pio, counters[idx].sm, false);
@@ -180,22 +237,25 @@ CmdStatus FreqCounter::getMeasurement(uint8_t const *cmd, uint8_t response[64])
     response[2] = pin;
 
     int idx = findCounterIndex(pin);
-    if (idx == -1 || !counters[idx].active) {
-        // Pin not initialized or inactive
+    if (idx == -1 || !counters[idx].active || _measureIdx != -1) {
+        // Pin not initialized or inactive, or measurement already in progress
         return CmdStatus::NOK;
     }
 
-    uint32_t high_rem, low_rem;
-    // TODO: Add timeout mechanism here? For now, it blocks.
-    freq_counter_get_measurement_blocking(counters[idx].pio, counters[idx].sm, &high_rem, &low_rem);
-
-    // Calculate actual cycles (firmware side)
-    uint32_t high_cycles = high_rem;
-    uint32_t low_cycles = low_rem;
-
-    // Pack results into response buffer (Little Endian)
-    convertUInt32ToBytes(high_cycles, &response[3]); // Bytes 3, 4, 5, 6
-    convertUInt32ToBytes(low_cycles, &response[7]);  // Bytes 7, 8, 9, 10
+    static bool irqHandlerAdded = false;
+    if (!irqHandlerAdded) {
+        irq_add_shared_handler(PIO0_IRQ_0, pioIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_add_shared_handler(PIO1_IRQ_0, pioIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(PIO0_IRQ_0, true);
+        irq_set_enabled(PIO1_IRQ_0, true);
+        irqHandlerAdded = true;
+    }
 
-    return CmdStatus::OK;
+    // Result sent by task(), USB is not blocked while waiting for the signal
+    FreqCounterInfo &counter = counters[idx];
+    pio_interrupt_clear(counter.pio, counter.sm);
+    _measureIdx = idx;
+    pio_set_irq0_source_enabled(counter.pio, static_cast<pio_interrupt_source>(pis_interrupt0 + counter.sm), true);
+    freq_counter_start_measurement(counter.pio, counter.sm);
+    return CmdStatus::NOT_FINISHED;
 }
@@ -26,7 +26,9 @@ public:
     virtual ~FreqCounter();
 
     CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
-    CmdStatus task(uint8_t response[64]) { (void)response; return CmdStatus::NOT_CONCERNED; } // No background task needed
+    CmdStatus task(uint8_t response[64]);
+    void abort(uint8_t reportId);
+    static void pioIrqHandler();
 
 protected:
     CmdStatus initCounter(uint8_t const *cmd, uint8_t response[64]);
@@ -42,6 +44,9 @@ private:
     bool pio_sm_claimed[NUM_PIOS][NUM_PIO_STATE_MACHINES]; // Track claimed SMs
     uint pio_program_offset[NUM_PIOS]; // Store offset if program loaded
     bool pio_program_loaded[NUM_PIOS];
+    volatile int _measureIdx; // counter measuring for FREQ_COUNTER_GET_MEASUREMENT, -1 if none
+
+    static FreqCounter *_sInstance;
 };
 
 #endif // _INTERFACE_FREQCOUNTER_H
@@ -87,6 +87,13 @@ bool debounceInput(repeating_timer_t *rt) {
 
 Gpio::Gpio() {
     setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::GPIO_INIT_PIN,
+        Report::ID::GPIO_SET_VALUE,
+        Report::ID::GPIO_GET_VALUE,
+        Report::ID::GPIO_SET_IRQ,
+        Report::ID::GPIO_GET_IRQ
+    });
     critical_section_init(&critSec);
     add_repeating_timer_us(-DEBOUNCE_PERIODS_MS * 1000, debounceInput, NULL, &_debounceTimer);
 }
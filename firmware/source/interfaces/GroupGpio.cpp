@@ -4,6 +4,10 @@
 
 GroupGpio::GroupGpio() {
     setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::GROUP_GPIO_SET_VALUES,
+        Report::ID::GROUP_GPIO_GET_ALL_VALUES
+    });
 }
 
 GroupGpio::~GroupGpio() {
@@ -2,7 +2,6 @@
 #include "string.h"
 #include <algorithm>
 #include <math.h>
-#include "pico/multicore.h"
 #include "hardware/pio.h"
 #include "hub75.pio.h"
 
@@ -21,57 +20,68 @@ static uint32_t * nextImg[2] = {nullptr, nullptr};
 uint8_t Hub75::WIDTH = 0;
 uint8_t Hub75::HEIGHT = 0;
 
-void hub75_core() {
-
-    PIO pio = pio1;
-    uint sm_data = 2;
-    uint sm_row = 3;
-
-    int ROWSEL_N_PINS = (int)log2(Hub75::HEIGHT >> 1);
-
-    uint data_prog_offs = pio_add_program(pio, &hub75_data_rgb888_program);
-    uint row_prog_offs = pio_add_program(pio, &hub75_row_program);
-    hub75_data_rgb888_program_init(pio, sm_data, data_prog_offs, DATA_BASE_PIN, CLK_PIN);
-    hub75_row_program_init(pio, sm_row, row_prog_offs, ROWSEL_BASE_PIN, ROWSEL_N_PINS, STROBE_PIN);
-
-    uint32_t currentIndex = 0;
-    while (1) {
-        if(multicore_fifo_rvalid())
-            currentIndex = multicore_fifo_pop_blocking();
-        uint32_t *img = nextImg[currentIndex];
-        for (int rowsel = 0; rowsel < (1 << ROWSEL_N_PINS); ++rowsel) {
-            uint32_t* gc_row[2];
-            gc_row[0] = &img[rowsel * Hub75::WIDTH];
-            gc_row[1] = &img[((1u << ROWSEL_N_PINS) + rowsel) * Hub75::WIDTH];
-            for (int bit = 0; bit < 8; ++bit) {
-                hub75_data_rgb888_set_shift(pio, sm_data, data_prog_offs, bit);
-                for (int x = 0; x < Hub75::WIDTH; ++x) {
-                    pio_sm_put_blocking(pio, sm_data, gc_row[0][x]);
-                    pio_sm_put_blocking(pio, sm_data, gc_row[1][x]);
-                }
-                // Dummy pixel per lane
-                pio_sm_put_blocking(pio, sm_data, 0);
-                pio_sm_put_blocking(pio, sm_data, 0);
-                // SM is finished when it stalls on empty TX FIFO
-                hub75_wait_tx_stall(pio, sm_data);
-                // Also check that previous OEn pulse is finished, else things can get out of sequence
-                hub75_wait_tx_stall(pio, sm_row);
-
-                // Latch row data, pulse output enable for new row.
-                pio_sm_put_blocking(pio, sm_row, rowsel | (100u * (1u << bit) << 5));
-            }
+static const PIO _pio = pio1;
+static const uint _smData = 2;
+static const uint _smRow = 3;
+
+Hub75RefreshJob::Hub75RefreshJob(BaseInterface *owner)
+    : WorkerJob(owner), _pio(pio1), _smData(0), _smRow(0), _dataProgOffset(0), _rowselNPins(0),
+      _rowsel(0), _currentIndex(0), _nextIndex(0) {
+}
+
+void Hub75RefreshJob::setup(PIO pio, uint smData, uint smRow, uint dataProgOffset, uint rowselNPins) {
+    _pio = pio;
+    _smData = smData;
+    _smRow = smRow;
+    _dataProgOffset = dataProgOffset;
+    _rowselNPins = rowselNPins;
+    _rowsel = 0;
+}
+
+bool Hub75RefreshJob::run() {
+    // Image is only switched between frames
+    if(_rowsel == 0)
+        _currentIndex = _nextIndex;
+
+    uint32_t *img = nextImg[_currentIndex];
+    uint32_t* gc_row[2];
+    gc_row[0] = &img[_rowsel * Hub75::WIDTH];
+    gc_row[1] = &img[((1u << _rowselNPins) + _rowsel) * Hub75::WIDTH];
+    for (int bit = 0; bit < 8; ++bit) {
+        hub75_data_rgb888_set_shift(_pio, _smData, _dataProgOffset, bit);
+        for (int x = 0; x < Hub75::WIDTH; ++x) {
+            pio_sm_put_blocking(_pio, _smData, gc_row[0][x]);
+            pio_sm_put_blocking(_pio, _smData, gc_row[1][x]);
         }
+        // Dummy pixel per lane
+        pio_sm_put_blocking(_pio, _smData, 0);
+        pio_sm_put_blocking(_pio, _smData, 0);
+        // SM is finished when it stalls on empty TX FIFO
+        hub75_wait_tx_stall(_pio, _smData);
+        // Also check that previous OEn pulse is finished, else things can get out of sequence
+        hub75_wait_tx_stall(_pio, _smRow);
+
+        // Latch row data, pulse output enable for new row.
+        pio_sm_put_blocking(_pio, _smRow, _rowsel | (100u * (1u << bit) << 5));
     }
 
+    _rowsel = (_rowsel + 1) % (1u << _rowselNPins);
+    return false; // until requestStop()
 }
 
 
 Hub75::Hub75(uint streamBufferSize)
     : StreamedInterface(streamBufferSize, true),
-      _internalState(INTERNAL_STATE::IDLE) {
-
-    nextImg[0] = _bufferRx.getDataPtr32();
-    nextImg[1] = _bufferRx2.getDataPtr32();
+      _internalState(INTERNAL_STATE::IDLE),
+      _refreshJob(this),
+      _dataProgOffset(0),
+      _rowProgOffset(0) {
+
+    registerReports({
+        Report::ID::HUB75_INIT,
+        Report::ID::HUB75_DEINIT,
+        Report::ID::HUB75_WRITE
+    });
 }
 
 Hub75::~Hub75() {
@@ -102,7 +112,7 @@ CmdStatus Hub75::task(uint8_t response[64]) {
         status = CmdStatus::NOT_FINISHED;
     } else if(_internalState == INTERNAL_STATE::WAIT_PIXELS) {// && getBuffer().size() >= _totalRemainingBytesToSend)
         _internalState = INTERNAL_STATE::IDLE;
-        multicore_fifo_push_blocking(getCurrentBufferIndex());
+        _refreshJob.showImage(getCurrentBufferIndex());
         _totalRemainingBytesToSend = 0;
         // send ACK
         response[0] = Report::ID::HUB75_WRITE;
@@ -128,27 +138,61 @@ CmdStatus Hub75::init(uint8_t const *cmd, uint8_t response[64]) {
         // Height is not a power of 2
         return CmdStatus::NOK;
     }
-    
+    if(!acquireStreamBuffers()) {
+        return CmdStatus::NOK; // memory arena exhausted
+    }
+    nextImg[0] = _bufferRx.getDataPtr32();
+    nextImg[1] = _bufferRx2.getDataPtr32();
+
     memset(_bufferRx.getDataPtr8(), 0, Hub75::HEIGHT * Hub75::WIDTH * 4);
     memset(_bufferRx2.getDataPtr8(), 0, Hub75::HEIGHT * Hub75::WIDTH * 4);
 
-    multicore_launch_core1(hub75_core);
+    const uint rowselNPins = (uint)log2(Hub75::HEIGHT >> 1);
+    _dataProgOffset = pio_add_program(_pio, &hub75_data_rgb888_program);
+    _rowProgOffset = pio_add_program(_pio, &hub75_row_program);
+    hub75_data_rgb888_program_init(_pio, _smData, _dataProgOffset, DATA_BASE_PIN, CLK_PIN);
+    hub75_row_program_init(_pio, _smRow, _rowProgOffset, ROWSEL_BASE_PIN, rowselNPins, STROBE_PIN);
+
+    _refreshJob.setup(_pio, _smData, _smRow, _dataProgOffset, rowselNPins);
+    _refreshJob.showImage(getCurrentBufferIndex());
+    if(!Core1Worker::submit(&_refreshJob)) {
+        releasePio();
+        releaseStreamBuffers();
+        return CmdStatus::NOK;
+    }
     setInterfaceState(InterfaceState::INTIALIZED);
     return CmdStatus::OK;
 }
 
 CmdStatus Hub75::deInit() {
-    multicore_reset_core1(); // Seems to not working, must stop PIO before ?
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::OK;
+    }
+    // Refresh job ends after its current row
+    _refreshJob.requestStop();
+    while(_refreshJob.isBusy()) {
+        tight_loop_contents();
+    }
+    releasePio();
+    _internalState = INTERNAL_STATE::IDLE;
+    releaseStreamBuffers();
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     return CmdStatus::OK;
 }
 
+void Hub75::releasePio() {
+    pio_sm_set_enabled(_pio, _smData, false);
+    pio_sm_set_enabled(_pio, _smRow, false);
+    pio_remove_program(_pio, &hub75_data_rgb888_program, _dataProgOffset);
+    pio_remove_program(_pio, &hub75_row_program, _rowProgOffset);
+}
+
 // | HUB75_WRITE | NB_BYTES[4] L.Endian (WIDTH * HEIGHT *3)| => First | HUB75_WRITE | CmdStatus::OK|NOK | 
 // ... and after the CDC stream (when transfer to led starting) | HUB75_WRITE | CmdStatus::OK |
 CmdStatus Hub75::write(const uint8_t *cmd, uint8_t response[64]){
     const uint32_t nbBytes = convertBytesToUInt32(&cmd[1]);
     response[2] = 0x00;
-    if(_internalState != INTERNAL_STATE::IDLE){
+    if(_internalState != INTERNAL_STATE::IDLE || getInterfaceState() != InterfaceState::INTIALIZED){
         response[2] = 0x02;
         return CmdStatus::NOK;
     } else if(nbBytes > (Hub75::WIDTH * Hub75::HEIGHT * 4)) {
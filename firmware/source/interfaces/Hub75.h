@@ -4,10 +4,34 @@
 #include "PicoInterfacesBoard.h"
 #include "StreamedInterface.h"
 #include "hardware/uart.h"
+#include "hardware/pio.h"
+#include "../Core1Worker.h"
 extern "C" {
 #include "pico/util/queue.h"
 }
 
+// Panel refresh, resident job on core1: one row (all bit planes) per call
+class Hub75RefreshJob : public WorkerJob {
+public:
+    Hub75RefreshJob(BaseInterface *owner);
+
+    void setup(PIO pio, uint smData, uint smRow, uint dataProgOffset, uint rowselNPins);
+    // Image buffer displayed from next frame
+    inline void showImage(uint32_t index) { _nextIndex = index; }
+
+protected:
+    bool run();
+
+    PIO _pio;
+    uint _smData;
+    uint _smRow;
+    uint _dataProgOffset;
+    uint _rowselNPins;
+    uint _rowsel;
+    uint32_t _currentIndex;
+    volatile uint32_t _nextIndex;
+};
+
 
 class Hub75 : public StreamedInterface {
 public:
@@ -21,6 +45,7 @@ protected:
     CmdStatus init(uint8_t const *cmd, uint8_t response[64]);
     CmdStatus deInit();
     CmdStatus write(const uint8_t *cmd, uint8_t response[64]);
+    void releasePio();
 
     enum INTERNAL_STATE {
         IDLE = 0x00,
@@ -31,6 +56,9 @@ protected:
     };
 
     INTERNAL_STATE _internalState;
+    Hub75RefreshJob _refreshJob;
+    uint _dataProgOffset;
+    uint _rowProgOffset;
 
     /*CmdStatus write(const uint8_t *cmd);
     CmdStatus read(const uint8_t *cmd, uint8_t *response);
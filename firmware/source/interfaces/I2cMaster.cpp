@@ -1,13 +1,82 @@
 #include "I2cMaster.h"
 #include "string.h"
 
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "tusb.h"
+#include "../Stats.h"
+#include "../Trace.h"
+
+I2CMaster *I2CMaster::_sI2cs[2] = {nullptr, nullptr};
+const BaseInterface *I2CMaster::_sBusOwners[2] = {nullptr, nullptr};
+
+// The IC_CLR_* registers clear their interrupt when read
+static inline void readToClear(uint32_t value) {
+    (void)value;
+}
+
 I2CMaster::I2CMaster(uint8_t i2cIndex, uint streamBufferSize = 512)
-    : StreamedInterface(streamBufferSize),
+    : MemoryProgrammer(streamBufferSize, true), // next chunk of I2Cx_READ_TO_STREAM read while the previous one is sent
       _i2cInst(i2cIndex == 0 ? i2c0 : i2c1),
       _sdaGP(i2cIndex == 0 ? U2IF_I2C0_SDA : U2IF_I2C1_SDA),
       _sclGP(i2cIndex == 0 ? U2IF_I2C0_SCL : U2IF_I2C1_SCL),
-      _currentStreamAddress(0) {
+      _pullUp(false),
+      _currentStreamAddress(0),
+      _baudrate(100000),
+      _timeoutUs(0),
+      _dmaChannel(-1),
+      _dmaRxChannel(-1),
+      _transfer(),
+      _transferRunning(false),
+      _timeoutAlarm(0),
+      _dmaCmds(),
+      _abortedReportId(0),
+      _hidReportId(0),
+      _hidCmd(),
+      _hidData(),
+      _hidNbRead(0),
+      _listNbEntries(0),
+      _listEntry(0),
+      _listOffset(0),
+      _hidContinued(false),
+      _streamChunkLen(0),
+      _scanning(false),
+      _scanAddress(0),
+      _scanLastAddress(0),
+      _scanTimeoutUs(0),
+      _scanReadMask(),
+      _scanFound(),
+      _readStreamAddress(0),
+      _readStreamWriteLen(0),
+      _readStreamNbBytes(0),
+      _readStreamToRead(0),
+      _readStreamNbRead(0),
+      _readStreamToSend(0),
+      _readStreamStatus(CmdStatus::OK),
+      _readStates{READ_CHUNK_FREE, READ_CHUNK_FREE},
+      _readLens{0, 0},
+      _readIndex(0),
+      _drainIndex(0),
+      _drainOffset(0),
+      _memDeviceAddress(0),
+      _memPollAddress{0, 0, 0, 0} {
+    _sI2cs[getInstIndex()] = this;
 
+    const uint offset = getInstIndex() * Report::ID::I2C0_I2C1_OFFSET;
+    registerReports({
+        Report::ID::I2C0_INIT + offset,
+        Report::ID::I2C0_DEINIT + offset,
+        Report::ID::I2C0_WRITE + offset,
+        Report::ID::I2C0_READ + offset,
+        Report::ID::I2C0_WRITE_FROM_UART + offset,
+        Report::ID::I2C0_MEM_PROGRAM + offset,
+        Report::ID::I2C0_SET_TIMEOUT + offset,
+        Report::ID::I2C0_BUS_CLEAR + offset,
+        Report::ID::I2C0_WRITE_READ + offset,
+        Report::ID::I2C0_WRITE_READ_LIST + offset,
+        Report::ID::I2C0_READ_TO_STREAM + offset,
+        Report::ID::I2C0_SCAN + offset
+    });
 }
 
 I2CMaster::~I2CMaster() {
@@ -18,10 +87,77 @@ uint8_t I2CMaster::getInstIndex() {
     return static_cast<uint8_t>(i2c_hw_index(_i2cInst));
 }
 
+uint I2CMaster::getTimeoutUs(uint nbBytes) const {
+    static const uint TIMEOUT_MARGIN_US = 10000;
+    if(_timeoutUs > 0)
+        return _timeoutUs;
+    // address + data bytes, 9 clocks each, twice the nominal time for clock stretching
+    const uint64_t transferUs = (static_cast<uint64_t>(nbBytes) + 1) * 9 * 2 * 1000000 / _baudrate;
+    return TIMEOUT_MARGIN_US + static_cast<uint>(transferUs);
+}
+
+void I2CMaster::dmaHandler() {
+    for(I2CMaster *i2c : _sI2cs) {
+        if(i2c == nullptr || i2c->_dmaChannel < 0)
+            continue;
+        const uint32_t mask = dma_hw->ints0 & ((1u << i2c->_dmaChannel) | (1u << i2c->_dmaRxChannel));
+        if(mask == 0)
+            continue;
+        dma_hw->ints0 = mask;
+        Trace::record(TRACE_EVENT::TRACE_DMA_END, i2c->getInterfaceIndex());
+        const Transfer &transfer = i2c->_transfer;
+        if((mask & (1u << i2c->_dmaChannel)) && i2c->_transferRunning && transfer.nbQueued < transfer.len + transfer.dstLen)
+            i2c->queueCommands(); // next chunk without waiting for the main loop
+        else
+            i2c->setPending(); // task() ends the transfer
+    }
+}
+
+void I2CMaster::i2cIrqHandler() {
+    for(I2CMaster *i2c : _sI2cs) {
+        if(i2c == nullptr || !i2c->_transferRunning)
+            continue;
+        i2c_hw_t *hw = i2c_get_hw(i2c->_i2cInst);
+        if(hw->intr_stat == 0)
+            continue;
+        hw->intr_mask = 0; // level interrupts, cleared by pollTransfer()
+        i2c->setPending(); // task() ends the transfer
+    }
+}
+
+bool I2CMaster::claimBus(uint8_t i2cIndex, const BaseInterface *owner) {
+    if(_sBusOwners[i2cIndex] != nullptr && _sBusOwners[i2cIndex] != owner)
+        return false;
+    _sBusOwners[i2cIndex] = owner;
+    return true;
+}
+
+void I2CMaster::releaseBus(uint8_t i2cIndex, const BaseInterface *owner) {
+    if(_sBusOwners[i2cIndex] == owner)
+        _sBusOwners[i2cIndex] = nullptr;
+}
+
+uint I2CMaster::getIrq() const {
+    return i2c_hw_index(_i2cInst) == 0 ? I2C0_IRQ : I2C1_IRQ;
+}
+
+int64_t I2CMaster::timeoutAlarmCallback(alarm_id_t id, void *userData) {
+    (void)id;
+    static_cast<I2CMaster*>(userData)->setPending(); // stuck bus (the DMA does not end), or ACK of the last byte
+    return 0;
+}
+
 CmdStatus I2CMaster::process(uint8_t const *cmd, uint8_t response[64]) {
     CmdStatus status = CmdStatus::NOT_CONCERNED;
     const uint i2cIndex = getInstIndex();
 
+    const uint8_t offset = i2cIndex * Report::ID::I2C0_I2C1_OFFSET;
+    const bool busCmd = cmd[0] != Report::ID::I2C0_DEINIT + offset && cmd[0] != Report::ID::I2C0_BUS_CLEAR + offset
+                        && cmd[0] != Report::ID::I2C0_SET_TIMEOUT + offset;
+    if(busCmd && (isTransferRunning() || _readStreamToSend > 0 || _abortedReportId != 0)) {
+        return CmdStatus::NOK; // bus used by the DMA engine
+    }
+
     if(cmd[0] == (Report::ID::I2C0_INIT + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
         status = init(cmd);
     } else if(cmd[0] == (Report::ID::I2C0_DEINIT + i2cIndex * Report::ID::I2C0_I2C1_OFFSET) ) {
@@ -29,62 +165,171 @@ CmdStatus I2CMaster::process(uint8_t const *cmd, uint8_t response[64]) {
     } else if(cmd[0] == (Report::ID::I2C0_WRITE + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
         status = write(cmd);
     } else if(cmd[0] == (Report::ID::I2C0_READ + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
-        status = read(cmd, response);
+        status = read(cmd);
     } else if(cmd[0] == (Report::ID::I2C0_WRITE_FROM_UART + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
         status = writeFromUart(cmd);
+    } else if(cmd[0] == (Report::ID::I2C0_MEM_PROGRAM + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = memProgramStart(cmd);
+    } else if(cmd[0] == (Report::ID::I2C0_SET_TIMEOUT + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = setTimeout(cmd);
+    } else if(cmd[0] == (Report::ID::I2C0_BUS_CLEAR + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = busClear(response);
+    } else if(cmd[0] == (Report::ID::I2C0_WRITE_READ + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = writeRead(cmd, false);
+    } else if(cmd[0] == (Report::ID::I2C0_WRITE_READ_LIST + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = writeRead(cmd, true);
+    } else if(cmd[0] == (Report::ID::I2C0_READ_TO_STREAM + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = readToStream(cmd);
+    } else if(cmd[0] == (Report::ID::I2C0_SCAN + i2cIndex * Report::ID::I2C0_I2C1_OFFSET)) {
+        status = scan(cmd);
     }
 
     return status;
 }
 
 CmdStatus I2CMaster::task(uint8_t response[64]) {
+    if(_abortedReportId != 0) {
+        response[0] = _abortedReportId;
+        _abortedReportId = 0;
+        if(response[0] == Report::ID::I2C0_MEM_PROGRAM + getInstIndex() * Report::ID::I2C0_I2C1_OFFSET)
+            return memEnd(response, MEM_ERROR_BUS);
+        return CmdStatus::NOK;
+    }
+    if(_scanning)
+        return scanTask(response);
+    if(_hidReportId != 0) {
+        // I2Cx_WRITE, I2Cx_READ or I2Cx_WRITE_READ(_LIST)
+        TRANSFER_STEP step = pollTransfer();
+        if(step == TRANSFER_WAIT)
+            return CmdStatus::NOT_CONCERNED;
+        if(step == TRANSFER_DONE && _listEntry + 1 < _listNbEntries) {
+            _listEntry++;
+            if(startListEntry())
+                return CmdStatus::NOT_CONCERNED; // woken by the DMA IRQ
+            step = TRANSFER_NACK;
+        }
+        response[0] = _hidReportId;
+        _hidReportId = 0;
+        if(step == TRANSFER_DONE)
+            memcpy(&response[2], _hidData, _hidNbRead);
+        else
+            response[2] = _listEntry; // failed entry of a list
+        if(step == TRANSFER_DONE && _hidContinued)
+            _i2cInst->restart_on_next = false;
+        return getTransferStatus(step);
+    }
+    if(_readStreamToSend > 0)
+        return readStreamTask(response);
+    if(isMemRunning())
+        return memTask(response);
+    return streamTask(response);
+}
+
+void I2CMaster::abortRunningCmd() {
+    if(isTransferRunning())
+        stopTransfer();
+    if(_hidReportId != 0) {
+        _abortedReportId = _hidReportId;
+        _hidReportId = 0;
+        _scanning = false;
+    } else if(_totalRemainingBytesToSend > 0) {
+        _abortedReportId = Report::ID::I2C0_WRITE_FROM_UART + getInstIndex() * Report::ID::I2C0_I2C1_OFFSET;
+        _totalRemainingBytesToSend = 0;
+        _currentStreamAddress = 0;
+    } else if(isMemRunning()) {
+        _abortedReportId = _memReportId;
+        memAbort();
+    }
+    if(_readStreamToSend > 0) {
+        _readStreamStatus = CmdStatus::NOK;
+        _readStreamToRead = 0;
+        _readStates[0] = READ_CHUNK_FREE;
+        _readStates[1] = READ_CHUNK_FREE;
+        _drainOffset = 0;
+    }
+    setPending();
+}
+
+void I2CMaster::abort(uint8_t reportId) {
+    // Command deadline reached before the transfer timeout (SYS_SET_CMD_TIMEOUT)
+    if(reportId != _hidReportId)
+        return;
+    _hidReportId = 0;
+    _scanning = false;
+    if(isTransferRunning()) {
+        stopTransfer();
+        recoverBus();
+    }
+}
+
+CmdStatus I2CMaster::streamTask(uint8_t response[64]) {
     if(_totalRemainingBytesToSend == 0)
         return CmdStatus::NOT_CONCERNED;
 
-    bool error = false;
+    CmdStatus status = CmdStatus::OK;
     StreamBuffer &buf =  getBuffer();
-    while(_totalRemainingBytesToSend > 0 && streamRxAvailableSize() && !error){
-        streamRxRead();
-        uint nbBytes = std::min(_totalRemainingBytesToSend, buf.size());
-        bool noStop = (_totalRemainingBytesToSend - nbBytes) > 0;
-
-        int nbWritten = i2c_write_blocking(
-            _i2cInst,
-            _currentStreamAddress, // addr
-            buf.getDataPtr8(), //src
-            nbBytes, //len
-            noStop
-        );
-        _i2cInst->restart_on_next = 0;
-
-        if(nbWritten != nbBytes) {
-            error = true;
-        } else {
-            _totalRemainingBytesToSend -= static_cast<uint>(nbWritten);
-        }
+    if(isTransferRunning()) {
+        // Chunk written by the DMA engine
+        const TRANSFER_STEP step = pollTransfer();
+        if(step == TRANSFER_WAIT)
+            return CmdStatus::NOT_CONCERNED;
+        if(step == TRANSFER_DONE)
+            _totalRemainingBytesToSend -= _streamChunkLen;
+        else
+            status = getTransferStatus(step);
         buf.setSize(0);
+    }
 
-        break; // break ou pas ? est ce qu'on essaye de tout envoyer sans redonner la main a l'event loop ou on fait le contraire ?
+    if(status == CmdStatus::OK && _totalRemainingBytesToSend > 0 && (buf.size() > 0 || streamRxAvailableSize())) {
+        streamRxRead();
+        _streamChunkLen = std::min(_totalRemainingBytesToSend, buf.size());
+        const bool noStop = (_totalRemainingBytesToSend - _streamChunkLen) > 0;
+        if(startTransfer(_currentStreamAddress, buf.getDataPtr8(), _streamChunkLen, nullptr, 0, noStop))
+            return CmdStatus::NOT_CONCERNED; // woken by the DMA IRQ
+        status = CmdStatus::NOK;
     }
 
-    if(error || _totalRemainingBytesToSend == 0) {
+    if(status != CmdStatus::OK || _totalRemainingBytesToSend == 0) {
         _totalRemainingBytesToSend = 0;
         _currentStreamAddress = 0;
         response[0] = Report::ID::I2C0_WRITE_FROM_UART + (getInstIndex() * 0x10);
-        //memset(&response[2], 0, 62);
-        _i2cInst->restart_on_next = 1;
-        return error ? CmdStatus::NOK : CmdStatus::OK;
+        return status;
     }
     return CmdStatus::NOT_FINISHED;
 }
 
 CmdStatus I2CMaster::init(uint8_t const *cmd) {
+    if(!claimBus(getInstIndex(), this)) {
+        return CmdStatus::NOK; // bus used by I2C_TARGET
+    }
+    if(!acquireStreamBuffers()) {
+        if(getInterfaceState() != InterfaceState::INTIALIZED)
+            releaseBus(getInstIndex(), this);
+        return CmdStatus::NOK; // memory arena exhausted
+    }
+    if(_dmaChannel < 0) {
+        _dmaChannel = dma_claim_unused_channel(true);
+        _dmaRxChannel = dma_claim_unused_channel(true);
+        dma_channel_set_irq0_enabled(_dmaChannel, true);
+        dma_channel_set_irq0_enabled(_dmaRxChannel, true);
+        static bool dmaHandlerAdded = false;
+        if(!dmaHandlerAdded) {
+            // Shared with the other DMA_IRQ_0 users (SPI, WS2812B, QSPI)
+            irq_add_shared_handler(DMA_IRQ_0, dmaHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irq_set_enabled(DMA_IRQ_0, true);
+            dmaHandlerAdded = true;
+        }
+    }
     uint32_t baudrate = convertBytesToUInt32(&cmd[2]);
     //printf("i2c baudrate %d kbaud %d %d %d\n", baudrate, report[2], report[3], sizeof(int));
-    i2c_init(_i2cInst, baudrate);
+    _baudrate = i2c_init(_i2cInst, baudrate);
+    i2c_get_hw(_i2cInst)->intr_mask = 0; // enabled by pollTransfer() for the last commands
+    irq_set_exclusive_handler(getIrq(), i2cIrqHandler);
+    irq_set_enabled(getIrq(), true);
     gpio_set_function(_sdaGP, GPIO_FUNC_I2C);
     gpio_set_function(_sclGP, GPIO_FUNC_I2C);
-    if(cmd[1]) {
+    _pullUp = cmd[1] != 0;
+    if(_pullUp) {
         gpio_pull_up(_sdaGP);
         gpio_pull_up(_sclGP);
     }
@@ -93,73 +338,502 @@ CmdStatus I2CMaster::init(uint8_t const *cmd) {
 }
 
 CmdStatus I2CMaster::deInit() {
+    if(getInterfaceState() != InterfaceState::INTIALIZED)
+        return CmdStatus::OK; // the bus can be used by I2C_TARGET
+    abortRunningCmd();
+    if(_dmaChannel >= 0) {
+        dma_channel_set_irq0_enabled(_dmaChannel, false);
+        dma_channel_unclaim(_dmaChannel);
+        dma_channel_set_irq0_enabled(_dmaRxChannel, false);
+        dma_channel_unclaim(_dmaRxChannel);
+        _dmaChannel = -1;
+        _dmaRxChannel = -1;
+    }
+    irq_set_enabled(getIrq(), false);
+    irq_remove_handler(getIrq(), i2cIrqHandler);
     i2c_deinit(_i2cInst);
     gpio_disable_pulls(_sdaGP);
     gpio_disable_pulls(_sclGP);
+    releaseStreamBuffers();
+    releaseBus(getInstIndex(), this);
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     return CmdStatus::OK;
 }
 
+bool I2CMaster::startTransfer(uint8_t address, const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t dstLen, bool noStop,
+                              uint timeoutUs) {
+    if(_dmaChannel < 0 || isTransferRunning() || len + dstLen == 0)
+        return false;
+    i2c_hw_t *hw = i2c_get_hw(_i2cInst);
+    if(hw->tar != address) {
+        hw->enable = 0;
+        hw->tar = address;
+        hw->enable = 1;
+    }
+    readToClear(hw->clr_intr);
+
+    if(timeoutUs == 0)
+        timeoutUs = getTimeoutUs(len + dstLen);
+    _transfer.address = address;
+    _transfer.src = src;
+    _transfer.len = len;
+    _transfer.dst = dst;
+    _transfer.dstLen = dstLen;
+    _transfer.noStop = noStop;
+    _transfer.nbQueued = 0;
+    _transfer.deadline = make_timeout_time_us(timeoutUs);
+    _transfer.ackWait = false;
+    _transferRunning = true;
+
+    if(dstLen > 0) {
+        dma_channel_config rxConfig = dma_channel_get_default_config(_dmaRxChannel);
+        channel_config_set_transfer_data_size(&rxConfig, DMA_SIZE_8);
+        channel_config_set_read_increment(&rxConfig, false);
+        channel_config_set_write_increment(&rxConfig, true);
+        channel_config_set_dreq(&rxConfig, i2c_get_dreq(_i2cInst, false));
+        dma_channel_configure(_dmaRxChannel, &rxConfig, dst, &hw->data_cmd, dstLen, true);
+    }
+    queueCommands();
+    _timeoutAlarm = add_alarm_in_us(timeoutUs, timeoutAlarmCallback, this, true);
+    return true;
+}
+
+void I2CMaster::queueCommands() {
+    // One 32-bit IC_DATA_CMD word per byte: data to write, or read command
+    const uint32_t total = _transfer.len + _transfer.dstLen;
+    const uint32_t count = std::min(total - _transfer.nbQueued, DMA_CMD_CHUNK);
+    for(uint32_t it = 0; it < count; it++) {
+        const uint32_t index = _transfer.nbQueued + it;
+        uint32_t command = index < _transfer.len ? _transfer.src[index] : I2C_IC_DATA_CMD_CMD_BITS;
+        if((index == 0 && _i2cInst->restart_on_next) || (index == _transfer.len && index > 0))
+            command |= I2C_IC_DATA_CMD_RESTART_BITS;
+        if(index == total - 1 && !_transfer.noStop)
+            command |= I2C_IC_DATA_CMD_STOP_BITS;
+        _dmaCmds[it] = command;
+    }
+    _transfer.nbQueued += count;
+
+    dma_channel_config txConfig = dma_channel_get_default_config(_dmaChannel);
+    channel_config_set_transfer_data_size(&txConfig, DMA_SIZE_32);
+    channel_config_set_read_increment(&txConfig, true);
+    channel_config_set_write_increment(&txConfig, false);
+    channel_config_set_dreq(&txConfig, i2c_get_dreq(_i2cInst, true));
+    Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(count));
+    dma_channel_configure(_dmaChannel, &txConfig, &i2c_get_hw(_i2cInst)->data_cmd, _dmaCmds, count, true);
+}
+
+I2CMaster::TRANSFER_STEP I2CMaster::pollTransfer() {
+    i2c_hw_t *hw = i2c_get_hw(_i2cInst);
+    if(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // Not acknowledged: the controller flushed its FIFO and sent a STOP
+        stopTransfer();
+        readToClear(hw->clr_tx_abrt);
+        _i2cInst->restart_on_next = false;
+        return TRANSFER_NACK;
+    }
+
+    const bool timeout = time_reached(_transfer.deadline);
+    if(!timeout && dma_channel_is_busy(_dmaChannel))
+        return TRANSFER_WAIT;
+    const uint32_t total = _transfer.len + _transfer.dstLen;
+    if(!timeout && _transfer.nbQueued < total)
+        return TRANSFER_WAIT; // next chunk queued by dmaHandler
+
+    // Last commands in the FIFO: ended by the STOP, or by the FIFO empty when the bus is kept
+    const uint32_t endBits = _transfer.noStop ? I2C_IC_RAW_INTR_STAT_TX_EMPTY_BITS : I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+    const bool ended = _transfer.nbQueued == total && !dma_channel_is_busy(_dmaChannel)
+                       && (_transfer.dstLen == 0 || !dma_channel_is_busy(_dmaRxChannel)) && (hw->raw_intr_stat & endBits);
+    if(ended && _transfer.noStop && !_transfer.ackWait) {
+        // The FIFO is empty once the last byte is shifted out, its NACK (TX_ABRT) comes with the ACK clock:
+        // done 2 bit times later, woken by the alarm
+        const uint ackWaitUs = 2 * std::max(1u, 1000000u / std::max(_baudrate, 1u));
+        _transfer.ackWait = true;
+        _transfer.ackDeadline = make_timeout_time_us(ackWaitUs);
+        if(_timeoutAlarm > 0)
+            cancel_alarm(_timeoutAlarm);
+        _timeoutAlarm = add_alarm_in_us(ackWaitUs, timeoutAlarmCallback, this, true);
+        return TRANSFER_WAIT;
+    }
+    if(_transfer.ackWait && !time_reached(_transfer.ackDeadline))
+        return TRANSFER_WAIT;
+    if(ended) {
+        stopTransfer();
+        readToClear(hw->clr_stop_det);
+        _i2cInst->restart_on_next = _transfer.noStop;
+        return TRANSFER_DONE;
+    }
+    if(!timeout) {
+        // Woken by the I2C IRQ, raised at once if the end came in between
+        hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS
+                        | (_transfer.noStop ? I2C_IC_INTR_MASK_M_TX_EMPTY_BITS : I2C_IC_INTR_MASK_M_STOP_DET_BITS);
+        return TRANSFER_WAIT;
+    }
+
+    // Stuck bus: slave holding SDA, or SCL stretched beyond the timeout
+    stopTransfer();
+    recoverBus();
+    return TRANSFER_TIMEOUT;
+}
+
+void I2CMaster::stopTransfer() {
+    if(_timeoutAlarm > 0)
+        cancel_alarm(_timeoutAlarm);
+    _timeoutAlarm = 0;
+    if(_transferRunning)
+        i2c_get_hw(_i2cInst)->intr_mask = 0;
+    _transferRunning = false; // before the abort, its IRQ does not queue commands
+    if(_dmaChannel >= 0) {
+        dma_channel_abort(_dmaChannel);
+        dma_channel_abort(_dmaRxChannel);
+    }
+}
 
+bool I2CMaster::recoverBus() {
+    // SCL and SDA driven as open drain GPIOs: output low or released
+    i2c_deinit(_i2cInst);
+    gpio_init(_sclGP);
+    gpio_init(_sdaGP);
+    const uint halfPeriodUs = std::max(1u, 500000u / std::max(_baudrate, 1u));
+    for(uint it = 0; it < 9 && !gpio_get(_sdaGP); it++) {
+        gpio_set_dir(_sclGP, GPIO_OUT);
+        sleep_us(halfPeriodUs);
+        gpio_set_dir(_sclGP, GPIO_IN);
+        sleep_us(halfPeriodUs);
+    }
+    const bool released = gpio_get(_sdaGP);
+
+    // STOP: SDA rising while SCL is high
+    gpio_set_dir(_sclGP, GPIO_OUT);
+    gpio_set_dir(_sdaGP, GPIO_OUT);
+    sleep_us(halfPeriodUs);
+    gpio_set_dir(_sclGP, GPIO_IN);
+    sleep_us(halfPeriodUs);
+    gpio_set_dir(_sdaGP, GPIO_IN);
+    sleep_us(halfPeriodUs);
+
+    _baudrate = i2c_init(_i2cInst, _baudrate);
+    i2c_get_hw(_i2cInst)->intr_mask = 0;
+    gpio_set_function(_sdaGP, GPIO_FUNC_I2C);
+    gpio_set_function(_sclGP, GPIO_FUNC_I2C);
+    return released;
+}
+
+CmdStatus I2CMaster::getTransferStatus(TRANSFER_STEP step) {
+    if(step == TRANSFER_DONE)
+        return CmdStatus::OK;
+    return step == TRANSFER_TIMEOUT ? CmdStatus::TIMEOUT : CmdStatus::NOK;
+}
 
 CmdStatus I2CMaster::write(const uint8_t *cmd){
     uint nbytes = convertBytesToUInt32(&cmd[3]);
-    //printf("i2c write addr=%d size=%d => ", report[1], nbytes);
-    
     bool noStop = cmd[2] == 0x01 ? false : true;
-    bool over = false;
+    _hidContinued = false;
     if(nbytes > (HID_CMD_SIZE - 7)) {
         noStop = true;
         nbytes = HID_CMD_SIZE - 7;
-        over = true;
-    }
-    
-    /*for(int it = 0; it < nbytes; it++) 
-    {  
-        printf("0x%02x ", report[4 + it]);
-    }*/
-
-    int nbWritten = i2c_write_blocking(
-        _i2cInst,
-        cmd[1], // addr
-        cmd + 7, //src
-        nbytes, //len
-        noStop
-    );
-    //printf("i2c write res=%d\n", nbWritten);
-    if(nbWritten ==  PICO_ERROR_GENERIC || nbWritten != static_cast<int>(nbytes))
+        _hidContinued = true;
+    }
+    if(nbytes == 0)
+        return CmdStatus::OK;
+
+    memcpy(_hidCmd, cmd, HID_CMD_SIZE);
+    if(!startTransfer(cmd[1], _hidCmd + 7, nbytes, nullptr, 0, noStop))
         return CmdStatus::NOK;
-    if(over)
-        _i2cInst->restart_on_next = 0;
-    return CmdStatus::OK;
+    _hidNbRead = 0;
+    _listNbEntries = 0;
+    _listEntry = 0;
+    _hidReportId = cmd[0];
+    return CmdStatus::NOT_FINISHED; // answered by task()
 }
 
-CmdStatus I2CMaster::read(const uint8_t *report, uint8_t *ret){
-    //printf("i2c read addr=%d size=%d\n", report[1], report[3]);
-    int nbRead = i2c_read_blocking(
-        _i2cInst,
-        report[1], // addr
-        ret + 2, //dst
-        report[3], //len
-        report[2] == 0x01 ? false : true
-    );
-    /*printf("i2c read res=%d", nbRead);
-    if(nbRead > 0) {
-        printf(" => ");
-        for(int it = 0; it < nbRead; it++) 
-        {  
-            printf("0x%02x ", ret[2+it]);
-        }
+CmdStatus I2CMaster::read(const uint8_t *cmd){
+    const uint8_t nbytes = cmd[3];
+    if(nbytes > getResponsePayloadSize())
+        return CmdStatus::NOK;
+    if(nbytes == 0)
+        return CmdStatus::OK;
+
+    if(!startTransfer(cmd[1], nullptr, 0, _hidData, nbytes, cmd[2] == 0x01 ? false : true))
+        return CmdStatus::NOK;
+    _hidContinued = false;
+    _hidNbRead = nbytes;
+    _listNbEntries = 0;
+    _listEntry = 0;
+    _hidReportId = cmd[0];
+    return CmdStatus::NOT_FINISHED; // answered by task()
+}
+
+CmdStatus I2CMaster::writeRead(const uint8_t *cmd, bool list) {
+    // Entries: | ADDR | NB_WRITE | NB_READ | WRITE_BYTES |, their read bytes fit in one response
+    const uint8_t nbEntries = list ? cmd[1] : 1;
+    const uint8_t firstOffset = list ? 2 : 1;
+    uint32_t offset = firstOffset;
+    uint32_t nbRead = 0;
+    for(uint8_t it = 0; it < nbEntries; it++) {
+        if(offset + 3 > HID_CMD_SIZE || cmd[offset + 1] + cmd[offset + 2] == 0)
+            return CmdStatus::NOK;
+        nbRead += cmd[offset + 2];
+        offset += 3 + cmd[offset + 1];
     }
-    printf("\n");*/
-    if(nbRead ==  PICO_ERROR_GENERIC || nbRead != report[3])
+    if(nbEntries == 0 || offset > HID_CMD_SIZE || nbRead > getResponsePayloadSize())
         return CmdStatus::NOK;
-    return CmdStatus::OK;
+
+    memcpy(_hidCmd, cmd, HID_CMD_SIZE);
+    _hidNbRead = 0;
+    _listNbEntries = nbEntries;
+    _listEntry = 0;
+    _listOffset = firstOffset;
+    if(!startListEntry())
+        return CmdStatus::NOK;
+    _hidContinued = false;
+    _hidReportId = cmd[0];
+    return CmdStatus::NOT_FINISHED; // answered by task()
+}
+
+bool I2CMaster::startListEntry() {
+    // Write of the register address, repeated start and read: one transaction ended by a STOP
+    const uint8_t *entry = &_hidCmd[_listOffset];
+    const uint8_t nbWrite = entry[1];
+    const uint8_t nbRead = entry[2];
+    uint8_t *dst = &_hidData[_hidNbRead];
+    _listOffset += 3 + nbWrite;
+    _hidNbRead += nbRead;
+    return startTransfer(entry[0], entry + 3, nbWrite, nbRead > 0 ? dst : nullptr, nbRead, false);
 }
 
 CmdStatus I2CMaster::writeFromUart(const uint8_t *cmd){
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::NOK;
+    }
+    memAbort();
     flushStreamRx();
     _totalRemainingBytesToSend = convertBytesToUInt32(&cmd[2]);
     _currentStreamAddress = cmd[1];
     return CmdStatus::OK;
 }
+
+CmdStatus I2CMaster::readToStream(const uint8_t *cmd) {
+    const uint32_t nbBytes = convertBytesToUInt32(&cmd[2]);
+    const uint8_t writeLen = cmd[6];
+    if(getInterfaceState() != InterfaceState::INTIALIZED || nbBytes == 0 || writeLen > HID_CMD_SIZE - READ_STREAM_HEADER_SIZE)
+        return CmdStatus::NOK;
+    memAbort();
+    _totalRemainingBytesToSend = 0;
+    memcpy(_hidCmd, cmd, HID_CMD_SIZE);
+    _readStreamAddress = cmd[1];
+    _readStreamWriteLen = writeLen;
+    _readStreamNbBytes = nbBytes;
+    _readStreamToRead = nbBytes;
+    _readStreamNbRead = 0;
+    _readStreamToSend = nbBytes;
+    _readStreamStatus = CmdStatus::OK;
+    _readStates[0] = READ_CHUNK_FREE;
+    _readStates[1] = READ_CHUNK_FREE;
+    _readIndex = 0;
+    _drainIndex = 0;
+    _drainOffset = 0;
+    return CmdStatus::OK; // data on CDC, status sent by task() at the end
+}
+
+CmdStatus I2CMaster::readStreamTask(uint8_t response[64]) {
+    TRANSFER_STEP step = TRANSFER_DONE;
+    if(isTransferRunning()) {
+        step = pollTransfer();
+        if(step == TRANSFER_DONE) {
+            _readStates[_readIndex] = READ_CHUNK_DRAINING;
+            _readStreamNbRead += _readLens[_readIndex];
+            _readIndex ^= 1;
+        } else if(step == TRANSFER_NACK || step == TRANSFER_TIMEOUT) {
+            _readStates[_readIndex] = READ_CHUNK_FREE;
+            _readStreamStatus = getTransferStatus(step);
+            _readStreamToRead = 0;
+        }
+    }
+
+    // Next chunk, one transaction: the register bytes are written before the first one, the next ones start with a
+    // repeated start (the controller can not hold a read while the previous chunk is sent)
+    if(!isTransferRunning() && _readStreamToRead > 0 && _readStates[_readIndex] == READ_CHUNK_FREE) {
+        StreamBuffer &buf = _readIndex == 0 ? _bufferRx : _bufferRx2;
+        const bool first = _readStreamToRead == _readStreamNbBytes;
+        const uint32_t len = std::min(_readStreamToRead, buf.getAllocateSize());
+        _readStreamToRead -= len;
+        _readLens[_readIndex] = len;
+        if(startTransfer(_readStreamAddress, &_hidCmd[READ_STREAM_HEADER_SIZE], first ? _readStreamWriteLen : 0,
+                         buf.getDataPtr8(), len, _readStreamToRead > 0)) {
+            _readStates[_readIndex] = READ_CHUNK_READING;
+            step = TRANSFER_WAIT;
+        } else {
+            _readStreamStatus = CmdStatus::NOK;
+            _readStreamToRead = 0;
+        }
+    }
+
+    drainReadStream();
+
+    if(_readStreamToSend == 0) {
+        response[0] = Report::ID::I2C0_READ_TO_STREAM + getInstIndex() * Report::ID::I2C0_I2C1_OFFSET;
+        convertUInt32ToBytes(_readStreamNbRead, &response[2]);
+        return _readStreamStatus;
+    }
+    const bool draining = _readStates[_drainIndex] == READ_CHUNK_DRAINING || _readStreamStatus != CmdStatus::OK;
+    if(draining) {
+        cancelWaitCdcRx(); // CDC IN full: polled
+        return CmdStatus::NOT_FINISHED;
+    }
+    return CmdStatus::NOT_CONCERNED; // woken by the DMA IRQ
+}
+
+void I2CMaster::drainReadStream() {
+    uint32_t nbWritten = 0;
+    while(_readStates[_drainIndex] == READ_CHUNK_DRAINING) {
+        StreamBuffer &buf = _drainIndex == 0 ? _bufferRx : _bufferRx2;
+        const uint32_t len = _readLens[_drainIndex];
+        const uint32_t nb = tud_cdc_write(buf.getDataPtr8() + _drainOffset, std::min(len - _drainOffset, tud_cdc_write_available()));
+        nbWritten += nb;
+        _drainOffset += nb;
+        _readStreamToSend -= nb;
+        if(_drainOffset < len)
+            break; // CDC IN full
+        _drainOffset = 0;
+        _readStates[_drainIndex] = READ_CHUNK_FREE;
+        _drainIndex ^= 1;
+    }
+    if(_readStreamStatus != CmdStatus::OK && !isTransferRunning() && _readStates[_drainIndex] != READ_CHUNK_DRAINING) {
+        // Bytes not read sent as zeros: the host reads NB_BYTES whatever the status
+        static const uint8_t zeros[64] = {};
+        uint32_t nb = 0;
+        do {
+            nb = tud_cdc_write(zeros, std::min({_readStreamToSend, static_cast<uint32_t>(sizeof(zeros)), tud_cdc_write_available()}));
+            nbWritten += nb;
+            _readStreamToSend -= nb;
+        } while(nb > 0 && _readStreamToSend > 0);
+    }
+    if(nbWritten > 0) {
+        tud_cdc_write_flush();
+        Stats::addCdcBytes(getInterfaceIndex(), nbWritten);
+    }
+}
+
+CmdStatus I2CMaster::scan(const uint8_t *cmd) {
+    static const uint SCAN_TIMEOUT_MARGIN_US = 1000;
+    const uint8_t firstAddress = cmd[1];
+    const uint8_t lastAddress = cmd[2];
+    if(getInterfaceState() != InterfaceState::INTIALIZED || firstAddress > lastAddress || lastAddress > 0x7F)
+        return CmdStatus::NOK;
+    memAbort();
+    _totalRemainingBytesToSend = 0;
+    _scanTimeoutUs = convertBytesToUInt16(&cmd[3]);
+    if(_scanTimeoutUs == 0) {
+        // Address + 1 byte, twice the nominal time: a missing device is a NACK after the address, not a timeout
+        _scanTimeoutUs = SCAN_TIMEOUT_MARGIN_US + static_cast<uint>(2ull * 9 * 2 * 1000000 / _baudrate);
+    }
+    memcpy(_scanReadMask, &cmd[5], SCAN_BITMAP_SIZE);
+    memset(_scanFound, 0, SCAN_BITMAP_SIZE);
+    _scanAddress = firstAddress;
+    _scanLastAddress = lastAddress;
+    if(!startProbe())
+        return CmdStatus::NOK;
+    _scanning = true;
+    _hidReportId = cmd[0];
+    return CmdStatus::NOT_FINISHED; // answered by task()
+}
+
+bool I2CMaster::startProbe() {
+    // 1-byte read, or write of a 0x00 byte (the controller can not send an address alone)
+    static const uint8_t probeByte = 0x00;
+    if(_scanReadMask[_scanAddress / 8] & (1u << (_scanAddress % 8)))
+        return startTransfer(_scanAddress, nullptr, 0, _hidData, 1, false, _scanTimeoutUs);
+    return startTransfer(_scanAddress, &probeByte, 1, nullptr, 0, false, _scanTimeoutUs);
+}
+
+CmdStatus I2CMaster::scanTask(uint8_t response[64]) {
+    const TRANSFER_STEP step = pollTransfer();
+    if(step == TRANSFER_WAIT)
+        return CmdStatus::NOT_CONCERNED;
+    if(step == TRANSFER_DONE)
+        _scanFound[_scanAddress / 8] |= static_cast<uint8_t>(1u << (_scanAddress % 8));
+
+    // A NACK is an absent device, a timeout (bus cleared) ends the scan
+    CmdStatus status = step == TRANSFER_TIMEOUT ? CmdStatus::TIMEOUT : CmdStatus::OK;
+    if(status == CmdStatus::OK && _scanAddress < _scanLastAddress) {
+        _scanAddress++;
+        if(startProbe())
+            return CmdStatus::NOT_CONCERNED; // woken by the DMA IRQ
+        status = CmdStatus::NOK;
+    }
+    response[0] = _hidReportId;
+    _hidReportId = 0;
+    _scanning = false;
+    memcpy(&response[2], _scanFound, SCAN_BITMAP_SIZE);
+    response[2 + SCAN_BITMAP_SIZE] = _scanAddress;
+    return status;
+}
+
+CmdStatus I2CMaster::setTimeout(const uint8_t *cmd) {
+    _timeoutUs = convertBytesToUInt32(&cmd[1]);
+    return CmdStatus::OK;
+}
+
+CmdStatus I2CMaster::busClear(uint8_t response[64]) {
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::NOK;
+    }
+    abortRunningCmd();
+    response[2] = recoverBus() ? 0x01 : 0x00;
+    return CmdStatus::OK;
+}
+
+CmdStatus I2CMaster::memProgramStart(const uint8_t *cmd){
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::NOK;
+    }
+    if(!memStart(cmd, cmd[11], 0))
+        return CmdStatus::NOK;
+    _memDeviceAddress = cmd[15];
+    return CmdStatus::OK;
+}
+
+uint8_t I2CMaster::memAddress(uint32_t address, uint8_t *dst) {
+    const uint8_t width = getMemAddressWidth();
+    for(uint8_t it = 0; it < width; it++) {
+        dst[it] = static_cast<uint8_t>(address >> (8 * (width - 1 - it)));
+    }
+    // 24C04 to 24C16: A8-A10 in the device address
+    return _memDeviceAddress | ((width < 4 ? address >> (8 * width) : 0) & 0x07);
+}
+
+MemoryProgrammer::MEM_STEP I2CMaster::memTransfer(uint8_t address, const uint8_t *src, uint len, uint8_t *dst, uint dstLen) {
+    if(isTransferRunning()) {
+        const TRANSFER_STEP step = pollTransfer();
+        if(step == TRANSFER_WAIT)
+            return MEM_STEP_WAIT;
+        return step == TRANSFER_DONE ? MEM_STEP_DONE : MEM_STEP_ERROR;
+    }
+    if(startTransfer(address, src, len, dst, dstLen, false))
+        return MEM_STEP_WAIT;
+    return MEM_STEP_ERROR;
+}
+
+MemoryProgrammer::MEM_STEP I2CMaster::memErase(uint32_t address) {
+    (void)address;
+    return MEM_STEP_DONE; // EEPROM pages are erased by their write cycle
+}
+
+MemoryProgrammer::MEM_STEP I2CMaster::memProgram(uint32_t address, uint8_t *page, uint32_t pageLen) {
+    // Address written in the free bytes before the page: one transfer
+    uint8_t *frame = page - _memHeaderSize;
+    const uint8_t deviceAddress = memAddress(address, frame);
+    return memTransfer(deviceAddress, frame, _memHeaderSize + pageLen, nullptr, 0);
+}
+
+MemoryProgrammer::MEM_STEP I2CMaster::memPollReady() {
+    // Not acknowledged during the write cycle
+    const uint32_t address = _memAddress + _memNbDone;
+    const MEM_STEP step = memTransfer(memAddress(address, _memPollAddress), _memPollAddress, getMemAddressWidth(), nullptr, 0);
+    return step == MEM_STEP_ERROR ? MEM_STEP_POLL : step;
+}
+
+MemoryProgrammer::MEM_STEP I2CMaster::memReadBack(uint32_t address, uint8_t *dst, uint32_t len) {
+    const uint8_t deviceAddress = memAddress(address, _memPollAddress);
+    return memTransfer(deviceAddress, _memPollAddress, getMemAddressWidth(), dst, len);
+}
@@ -2,32 +2,157 @@
 #define _INTERFACE_I2C_MASTER_H
 
 #include "PicoInterfacesBoard.h"
-#include "StreamedInterface.h"
+#include "MemoryProgrammer.h"
 #include "hardware/i2c.h"
 
-
-class I2CMaster : public StreamedInterface {
+class I2CMaster : public MemoryProgrammer {
 public:
     I2CMaster(uint8_t i2cIndex, uint streamBufferSize);
     virtual ~I2CMaster();
 
     CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
     CmdStatus task(uint8_t response[64]);
+    void abort(uint8_t reportId);
+
+    // Bus owner, I2CMaster or I2C_TARGET (slave mode) while initialized: false if the bus is used by another owner
+    static bool claimBus(uint8_t i2cIndex, const BaseInterface *owner);
+    static void releaseBus(uint8_t i2cIndex, const BaseInterface *owner);
 
 protected:
+    // Transfer of the DMA engine: write then read after a repeated start, either can be empty
+    struct Transfer {
+        uint8_t address;
+        const uint8_t *src;
+        uint32_t len;
+        uint8_t *dst;
+        uint32_t dstLen;
+        bool noStop;
+        uint32_t nbQueued; // commands given to the TX DMA
+        absolute_time_t deadline;
+        bool ackWait; // bus kept: FIFO empty, waiting for the ACK of the last byte until ackDeadline
+        absolute_time_t ackDeadline;
+    };
+
+    enum TRANSFER_STEP {
+        TRANSFER_WAIT,  // woken by the DMA IRQ, the I2C IRQ (last commands in the FIFO) or the timeout alarm
+        TRANSFER_DONE,
+        TRANSFER_NACK,
+        TRANSFER_TIMEOUT
+    };
+
     CmdStatus init(uint8_t const *cmd);
     CmdStatus deInit();
     CmdStatus write(const uint8_t *cmd);
     CmdStatus writeFromUart(const uint8_t *cmd);
-    CmdStatus read(const uint8_t *cmd, uint8_t *ret);
+    CmdStatus read(const uint8_t *cmd);
+    // I2Cx_WRITE_READ, I2Cx_WRITE_READ_LIST: entries run one after the other by task()
+    CmdStatus writeRead(const uint8_t *cmd, bool list);
+    bool startListEntry();
+    // I2Cx_READ_TO_STREAM: chunks read in the two stream buffers alternately, each one sent on CDC while the next is read
+    CmdStatus readToStream(const uint8_t *cmd);
+    CmdStatus readStreamTask(uint8_t response[64]);
+    void drainReadStream();
+    // I2Cx_SCAN: one probe transfer per address, run one after the other by task()
+    CmdStatus scan(const uint8_t *cmd);
+    CmdStatus scanTask(uint8_t response[64]);
+    bool startProbe();
+    CmdStatus setTimeout(const uint8_t *cmd);
+    CmdStatus busClear(uint8_t response[64]);
+    // I2Cx_DEINIT, I2Cx_BUS_CLEAR: the running transfer is stopped, its command answered NOK by task() (a read stream
+    // sends zeros for the bytes not read)
+    void abortRunningCmd();
+    CmdStatus streamTask(uint8_t response[64]);
     uint8_t getInstIndex();
+    // Transfer timeout: a stuck or stretched bus does not block the firmware
+    uint getTimeoutUs(uint nbBytes) const;
+
+    // DMA engine: the TX channel writes the commands (data, read, restart and stop bits) to IC_DATA_CMD by chunks,
+    // the next one queued by the DMA IRQ, the RX channel writes the bytes read. The end is detected by pollTransfer(),
+    // called from task() when the I2C IRQ signals the STOP of the last commands (bus kept: the FIFO empty, then the ACK
+    // of the last byte). timeoutUs 0: getTimeoutUs().
+    bool startTransfer(uint8_t address, const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t dstLen, bool noStop,
+                       uint timeoutUs = 0);
+    TRANSFER_STEP pollTransfer();
+    inline bool isTransferRunning() const { return _transferRunning; }
+    void queueCommands();
+    void stopTransfer();
+    // After a timeout: SCL clocked until the slave releases SDA, then a STOP. False if SDA is still held low.
+    bool recoverBus();
+    static CmdStatus getTransferStatus(TRANSFER_STEP step);
+    static void dmaHandler();
+    // While I2C_TARGET does not use the bus (it is not initialized then)
+    static void i2cIrqHandler();
+    uint getIrq() const;
+    static int64_t timeoutAlarmCallback(alarm_id_t id, void *userData);
+
+    // I2Cx_MEM_PROGRAM, I2C EEPROM: the transfers run on the DMA engine as the stream chunks
+    CmdStatus memProgramStart(const uint8_t *cmd);
+    MEM_STEP memErase(uint32_t address);
+    MEM_STEP memProgram(uint32_t address, uint8_t *page, uint32_t pageLen);
+    MEM_STEP memPollReady();
+    MEM_STEP memReadBack(uint32_t address, uint8_t *dst, uint32_t len);
+    // Memory address big endian in dst, returns the device address (with the block bits above the address bytes)
+    uint8_t memAddress(uint32_t address, uint8_t *dst);
+    // Transfer of the engine: MEM_STEP_WAIT until its end, then its result
+    MEM_STEP memTransfer(uint8_t address, const uint8_t *src, uint len, uint8_t *dst, uint dstLen);
+
+    enum READ_CHUNK_STATE {
+        READ_CHUNK_FREE,
+        READ_CHUNK_READING,
+        READ_CHUNK_DRAINING // read, being written to CDC
+    };
+
+    static const uint32_t DMA_CMD_CHUNK = 64;
+    static const uint8_t READ_STREAM_HEADER_SIZE = 7;
+    static const uint8_t SCAN_BITMAP_SIZE = 16;
 
     i2c_inst_t *_i2cInst;
     uint _sdaGP;
     uint _sclGP;
+    bool _pullUp;
     uint8_t _currentStreamAddress;
+    uint _baudrate;
+    uint _timeoutUs; // 0: from the number of bytes
+    int _dmaChannel;
+    int _dmaRxChannel;
+    Transfer _transfer;
+    volatile bool _transferRunning;
+    alarm_id_t _timeoutAlarm;
+    uint32_t _dmaCmds[DMA_CMD_CHUNK];
+    uint8_t _abortedReportId; // command stopped by abortRunningCmd(), 0: none
+    uint8_t _hidReportId; // I2Cx_WRITE, I2Cx_READ, I2Cx_WRITE_READ(_LIST) or I2Cx_SCAN answered by task(), 0: none
+    uint8_t _hidCmd[HID_CMD_SIZE]; // copy of the command, its buffer is reused by the next one
+    uint8_t _hidData[HID_RESPONSE_SIZE - 2]; // bytes read
+    uint8_t _hidNbRead;
+    uint8_t _listNbEntries; // 0: not a list
+    uint8_t _listEntry; // running entry
+    uint8_t _listOffset; // of the running entry in _hidCmd
+    bool _hidContinued; // truncated I2Cx_WRITE: the next one continues it without a repeated start
+    uint32_t _streamChunkLen; // stream bytes of the running transfer
+    bool _scanning; // I2Cx_SCAN, its report in _hidReportId
+    uint8_t _scanAddress; // probed address
+    uint8_t _scanLastAddress;
+    uint _scanTimeoutUs;
+    uint8_t _scanReadMask[SCAN_BITMAP_SIZE]; // addresses probed by a read
+    uint8_t _scanFound[SCAN_BITMAP_SIZE];
+    uint8_t _readStreamAddress;
+    uint8_t _readStreamWriteLen; // register bytes written before the first chunk, in _hidCmd
+    uint32_t _readStreamNbBytes;
+    uint32_t _readStreamToRead; // bytes of the chunks not started
+    uint32_t _readStreamNbRead;
+    uint32_t _readStreamToSend; // bytes not written to CDC yet (zeros after an error), 0: no stream
+    CmdStatus _readStreamStatus;
+    READ_CHUNK_STATE _readStates[2];
+    uint32_t _readLens[2];
+    uint8_t _readIndex; // buffer of the next chunk read
+    uint8_t _drainIndex; // buffer of the next chunk sent
+    uint32_t _drainOffset;
+    uint8_t _memDeviceAddress;
+    uint8_t _memPollAddress[4]; // address of the page, written to poll the end of the write cycle
+
+    static I2CMaster *_sI2cs[2];
+    static const BaseInterface *_sBusOwners[2];
 };
 
 
 #endif
-
@@ -0,0 +1,275 @@
+#include "I2cTarget.h"
+#include "I2cMaster.h"
+#include "string.h"
+
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+#include "../Stats.h"
+
+I2CTarget *I2CTarget::_sI2cTarget = nullptr;
+
+// The IC_CLR_* registers clear their interrupt when read
+static inline void readToClear(uint32_t value) {
+    (void)value;
+}
+
+I2CTarget::I2CTarget()
+    : StreamedInterface(MAP_SIZE),
+      _i2cInst(i2c0),
+      _sdaGP(U2IF_I2C0_SDA),
+      _sclGP(U2IF_I2C0_SCL),
+      _registers(),
+      _readOnly(),
+      _pointer(0),
+      _written(false),
+      _changed(),
+      _nbWrites(0),
+      _mapReportId(0),
+      _mapFirst(0),
+      _mapNbBytes(0),
+      _mapOffset(0),
+      _waitReportId(0) {
+    _sI2cTarget = this;
+    registerReports({
+        Report::ID::I2C_TARGET_INIT,
+        Report::ID::I2C_TARGET_DEINIT,
+        Report::ID::I2C_TARGET_WRITE_MAP,
+        Report::ID::I2C_TARGET_READ_MAP,
+        Report::ID::I2C_TARGET_GET_CHANGES
+    });
+}
+
+I2CTarget::~I2CTarget() {
+
+}
+
+uint I2CTarget::getIrq() const {
+    return i2c_hw_index(_i2cInst) == 0 ? I2C0_IRQ : I2C1_IRQ;
+}
+
+void I2CTarget::irqHandler() {
+    I2CTarget *target = _sI2cTarget;
+    i2c_hw_t *hw = i2c_get_hw(target->_i2cInst);
+    const uint32_t status = hw->intr_stat;
+
+    if(status & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
+        // Register pointer, then data bytes
+        while(hw->rxflr > 0) {
+            const uint32_t data = hw->data_cmd;
+            if(data & I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS) {
+                target->_pointer = static_cast<uint8_t>(data);
+                continue;
+            }
+            const uint8_t reg = target->_pointer;
+            target->_pointer = static_cast<uint8_t>(reg + 1);
+            target->_written = true;
+            if(target->_readOnly[reg / 8] & (1u << (reg % 8)))
+                continue;
+            target->_registers[reg] = static_cast<uint8_t>(data);
+            target->_changed[reg / 8] |= static_cast<uint8_t>(1u << (reg % 8));
+        }
+    }
+    if(status & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
+        // The clock is stretched until the byte is written
+        readToClear(hw->clr_rd_req);
+        const uint8_t reg = target->_pointer;
+        target->_pointer = static_cast<uint8_t>(reg + 1);
+        hw->data_cmd = target->_registers[reg];
+    }
+    if(status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        readToClear(hw->clr_tx_abrt);
+    }
+    if(status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        readToClear(hw->clr_stop_det);
+        if(target->_written) {
+            target->_written = false;
+            target->_nbWrites = target->_nbWrites + 1;
+            target->setPending(); // I2C_TARGET_GET_CHANGES waiting
+        }
+    }
+}
+
+CmdStatus I2CTarget::process(uint8_t const *cmd, uint8_t response[64]) {
+    CmdStatus status = CmdStatus::NOT_CONCERNED;
+
+    if(cmd[0] == Report::ID::I2C_TARGET_INIT) {
+        status = init(cmd);
+    } else if(cmd[0] == Report::ID::I2C_TARGET_DEINIT) {
+        status = deInit();
+    } else if(cmd[0] == Report::ID::I2C_TARGET_WRITE_MAP) {
+        status = writeMap(cmd);
+    } else if(cmd[0] == Report::ID::I2C_TARGET_READ_MAP) {
+        status = readMap(cmd);
+    } else if(cmd[0] == Report::ID::I2C_TARGET_GET_CHANGES) {
+        status = getChanges(cmd, response);
+    }
+
+    return status;
+}
+
+CmdStatus I2CTarget::task(uint8_t response[64]) {
+    if(_waitReportId != 0 && _nbWrites > 0) {
+        response[0] = _waitReportId;
+        _waitReportId = 0;
+        takeChanges(response);
+        return CmdStatus::OK;
+    }
+    if(_mapReportId == Report::ID::I2C_TARGET_WRITE_MAP)
+        return writeMapTask(response);
+    if(_mapReportId == Report::ID::I2C_TARGET_READ_MAP)
+        return readMapTask(response);
+    return CmdStatus::NOT_CONCERNED;
+}
+
+void I2CTarget::abort(uint8_t reportId) {
+    if(reportId == _waitReportId)
+        _waitReportId = 0;
+}
+
+CmdStatus I2CTarget::init(uint8_t const *cmd) {
+    const uint8_t i2cIndex = cmd[1];
+    const bool enabled = i2cIndex == 0 ? I2C0_ENABLED : (i2cIndex == 1 && I2C1_ENABLED);
+    if(!enabled || cmd[2] > 0x7F)
+        return CmdStatus::NOK;
+    if(!I2CMaster::claimBus(i2cIndex, this))
+        return CmdStatus::NOK; // bus used by I2CMaster
+    if(getInterfaceState() == InterfaceState::INTIALIZED)
+        deInit();
+    I2CMaster::claimBus(i2cIndex, this); // released by deInit() on the same bus
+    if(!acquireStreamBuffers()) {
+        I2CMaster::releaseBus(i2cIndex, this);
+        return CmdStatus::NOK; // memory arena exhausted
+    }
+
+    _i2cInst = i2cIndex == 0 ? i2c0 : i2c1;
+    _sdaGP = i2cIndex == 0 ? U2IF_I2C0_SDA : U2IF_I2C1_SDA;
+    _sclGP = i2cIndex == 0 ? U2IF_I2C0_SCL : U2IF_I2C1_SCL;
+    memset(_registers, 0, sizeof(_registers));
+    memcpy(_readOnly, &cmd[4], sizeof(_readOnly));
+    memset(_changed, 0, sizeof(_changed));
+    _pointer = 0;
+    _written = false;
+    _nbWrites = 0;
+    _mapReportId = 0;
+    _waitReportId = 0;
+
+    // Fast mode timings (SDA hold, spike filter), the bus master sets the clock
+    i2c_init(_i2cInst, 400000);
+    i2c_set_slave_mode(_i2cInst, true, cmd[2]);
+    i2c_hw_t *hw = i2c_get_hw(_i2cInst);
+    hw->enable = 0;
+    hw->con = hw->con | I2C_IC_CON_STOP_DET_IFADDRESSED_BITS; // STOP_DET only ends the transactions of this address
+    hw->enable = 1;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS
+                    | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+    gpio_set_function(_sdaGP, GPIO_FUNC_I2C);
+    gpio_set_function(_sclGP, GPIO_FUNC_I2C);
+    if(cmd[3] != 0) {
+        gpio_pull_up(_sdaGP);
+        gpio_pull_up(_sclGP);
+    }
+    irq_set_exclusive_handler(getIrq(), irqHandler);
+    irq_set_enabled(getIrq(), true);
+    setInterfaceState(InterfaceState::INTIALIZED);
+    return CmdStatus::OK;
+}
+
+CmdStatus I2CTarget::deInit() {
+    if(getInterfaceState() != InterfaceState::INTIALIZED)
+        return CmdStatus::OK;
+    irq_set_enabled(getIrq(), false);
+    irq_remove_handler(getIrq(), irqHandler);
+    i2c_deinit(_i2cInst);
+    gpio_disable_pulls(_sdaGP);
+    gpio_disable_pulls(_sclGP);
+    _mapReportId = 0;
+    _waitReportId = 0;
+    releaseStreamBuffers();
+    I2CMaster::releaseBus(static_cast<uint8_t>(i2c_hw_index(_i2cInst)), this);
+    setInterfaceState(InterfaceState::NOT_INITIALIZED);
+    return CmdStatus::OK;
+}
+
+CmdStatus I2CTarget::writeMap(const uint8_t *cmd) {
+    const uint32_t nbBytes = convertBytesToUInt16(&cmd[2]);
+    if(getInterfaceState() != InterfaceState::INTIALIZED || _mapReportId != 0 || nbBytes == 0 || cmd[1] + nbBytes > MAP_SIZE)
+        return CmdStatus::NOK;
+    flushStreamRx();
+    getBuffer().setSize(0);
+    _mapFirst = cmd[1];
+    _mapNbBytes = nbBytes;
+    _mapReportId = cmd[0];
+    return CmdStatus::OK; // status sent by task() after the CDC stream
+}
+
+CmdStatus I2CTarget::writeMapTask(uint8_t response[64]) {
+    StreamBuffer &buf = getBuffer();
+    streamRxRead(_mapNbBytes - buf.size());
+    if(buf.size() < _mapNbBytes)
+        return CmdStatus::NOT_FINISHED; // called again on CDC reception
+
+    const uint32_t irqStatus = save_and_disable_interrupts();
+    memcpy(&_registers[_mapFirst], buf.getDataPtr8(), _mapNbBytes);
+    restore_interrupts(irqStatus);
+    buf.setSize(0);
+    response[0] = _mapReportId;
+    _mapReportId = 0;
+    return CmdStatus::OK;
+}
+
+CmdStatus I2CTarget::readMap(const uint8_t *cmd) {
+    const uint32_t nbBytes = convertBytesToUInt16(&cmd[2]);
+    if(getInterfaceState() != InterfaceState::INTIALIZED || _mapReportId != 0 || nbBytes == 0 || cmd[1] + nbBytes > MAP_SIZE)
+        return CmdStatus::NOK;
+    StreamBuffer &buf = getBuffer();
+    const uint32_t irqStatus = save_and_disable_interrupts();
+    memcpy(buf.getDataPtr8(), &_registers[cmd[1]], nbBytes);
+    restore_interrupts(irqStatus);
+    buf.setSize(nbBytes);
+    _mapNbBytes = nbBytes;
+    _mapOffset = 0;
+    _mapReportId = cmd[0];
+    return CmdStatus::OK; // data on CDC, status sent by task() at the end
+}
+
+CmdStatus I2CTarget::readMapTask(uint8_t response[64]) {
+    StreamBuffer &buf = getBuffer();
+    const uint32_t nb = tud_cdc_write(buf.getDataPtr8() + _mapOffset, std::min(_mapNbBytes - _mapOffset, tud_cdc_write_available()));
+    if(nb > 0) {
+        tud_cdc_write_flush();
+        Stats::addCdcBytes(getInterfaceIndex(), nb);
+    }
+    _mapOffset += nb;
+    if(_mapOffset < _mapNbBytes) {
+        cancelWaitCdcRx(); // CDC IN full: polled
+        return CmdStatus::NOT_FINISHED;
+    }
+    buf.setSize(0);
+    response[0] = _mapReportId;
+    _mapReportId = 0;
+    return CmdStatus::OK;
+}
+
+CmdStatus I2CTarget::getChanges(const uint8_t *cmd, uint8_t response[64]) {
+    if(getInterfaceState() != InterfaceState::INTIALIZED)
+        return CmdStatus::NOK;
+    if(cmd[1] != 0 && _waitReportId != 0)
+        return CmdStatus::NOK; // one wait at a time
+    if(cmd[1] != 0 && _nbWrites == 0) {
+        _waitReportId = cmd[0];
+        return CmdStatus::NOT_FINISHED; // answered by task() at the end of the next write transaction
+    }
+    takeChanges(response);
+    return CmdStatus::OK;
+}
+
+void I2CTarget::takeChanges(uint8_t response[64]) {
+    const uint32_t irqStatus = save_and_disable_interrupts();
+    const uint32_t nbWrites = _nbWrites;
+    memcpy(&response[4], _changed, sizeof(_changed));
+    memset(_changed, 0, sizeof(_changed));
+    _nbWrites = 0;
+    restore_interrupts(irqStatus);
+    convertUInt16ToBytes(static_cast<uint16_t>(std::min<uint32_t>(nbWrites, 0xFFFF)), &response[2]);
+}
@@ -0,0 +1,58 @@
+#ifndef _INTERFACE_I2C_TARGET_H
+#define _INTERFACE_I2C_TARGET_H
+
+#include "PicoInterfacesBoard.h"
+#include "StreamedInterface.h"
+#include "hardware/i2c.h"
+
+// I2C0 or I2C1 in slave mode, emulating a peripheral: its registers are a RAM map served by the I2C IRQ while the
+// controller stretches the clock, the host is not involved in the transactions. The first byte written after the
+// address sets the register pointer, the next ones are written from it and reads start at it, auto-incremented.
+// The host loads and reads the map over CDC and gets the registers written by the bus master.
+class I2CTarget : public StreamedInterface {
+public:
+    I2CTarget();
+    virtual ~I2CTarget();
+
+    CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
+    CmdStatus task(uint8_t response[64]);
+    void abort(uint8_t reportId);
+
+    static const uint MAP_SIZE = 256; // 1 byte pointer, wraps at the end
+
+protected:
+    CmdStatus init(uint8_t const *cmd);
+    CmdStatus deInit();
+    // I2C_TARGET_WRITE_MAP, I2C_TARGET_READ_MAP: the block is copied at once with the IRQ disabled, a bus master
+    // never reads a multi-byte value half updated
+    CmdStatus writeMap(const uint8_t *cmd);
+    CmdStatus writeMapTask(uint8_t response[64]);
+    CmdStatus readMap(const uint8_t *cmd);
+    CmdStatus readMapTask(uint8_t response[64]);
+    CmdStatus getChanges(const uint8_t *cmd, uint8_t response[64]);
+    // | NB_WRITES[2] | CHANGED[32] | since the previous call, then cleared
+    void takeChanges(uint8_t response[64]);
+    uint getIrq() const;
+    static void irqHandler();
+
+    i2c_inst_t *_i2cInst;
+    uint _sdaGP;
+    uint _sclGP;
+    uint8_t _registers[MAP_SIZE];
+    uint8_t _readOnly[MAP_SIZE / 8];
+    // Updated by the IRQ
+    volatile uint8_t _pointer;
+    volatile bool _written; // data bytes received in the running transaction
+    uint8_t _changed[MAP_SIZE / 8];
+    volatile uint32_t _nbWrites;
+    uint8_t _mapReportId; // I2C_TARGET_WRITE_MAP or I2C_TARGET_READ_MAP running, 0: none
+    uint8_t _mapFirst;
+    uint32_t _mapNbBytes;
+    uint32_t _mapOffset; // bytes of I2C_TARGET_READ_MAP sent on CDC
+    uint8_t _waitReportId; // I2C_TARGET_GET_CHANGES waiting for a write transaction, 0: none
+
+    static I2CTarget *_sI2cTarget;
+};
+
+
+#endif
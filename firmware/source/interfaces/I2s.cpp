@@ -10,6 +10,7 @@
 #include "hardware/clocks.h"
 
 #include "audio_i2s.pio.h"
+#include "../Trace.h"
 
 static const PIO _pio = pio1;
 static const uint _sm = 1;
@@ -25,10 +26,12 @@ static void dma_handler() {
 
 void I2s::handleDmaIrq()
 {
+    Trace::record(TRACE_EVENT::TRACE_DMA_END, getInterfaceIndex());
     releaseOutputBuffer();
     Buffer* pBuffer = acquireOutputBuffer();
     if(pBuffer != nullptr) {
-        dma_channel_transfer_from_buffer_now(_dmaChannel, pBuffer->vector.data(), pBuffer->size/4);
+        Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(pBuffer->size/4));
+        dma_channel_transfer_from_buffer_now(_dmaChannel, pBuffer->getDataPtr32(), pBuffer->size/4);
     } else {
         //printf("finished\n") ;
     }
@@ -37,6 +40,12 @@ void I2s::handleDmaIrq()
 I2s::I2s(uint32_t bufferSizeInBytes, uint32_t bufferCount)
     : BufferedInterface(bufferSizeInBytes, bufferCount), _inputState(INPUT_STATE::IDLE){
     _i2s = this;
+    registerReports({
+        Report::ID::I2S_INIT,
+        Report::ID::I2S_DEINIT,
+        Report::ID::I2S_SET_FREQ,
+        Report::ID::I2S_WRITE_BUFFER
+    });
     initDma();
 }
 
@@ -86,7 +95,9 @@ CmdStatus I2s::init(uint8_t const *cmd) {
     if(getInterfaceState() == InterfaceState::INTIALIZED) {
         return CmdStatus::NOK;
     }
-    resetBuffers();
+    if(!acquireBuffers()) {
+        return CmdStatus::NOK; // memory arena exhausted
+    }
     _offsetProgram = pio_add_program(_pio, &audio_i2s_program);
     const uint data_pin = U2IF_I2S_SD;
     const uint clock_pin_base = U2IF_I2S_CLK;
@@ -111,7 +122,8 @@ CmdStatus I2s::deinit(uint8_t const *cmd) {
     resetBuffers();
 
     pio_remove_program(_pio, &audio_i2s_program, _offsetProgram);
-
+    _inputState = INPUT_STATE::IDLE;
+    releaseBuffers();
 
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     return CmdStatus::OK;
@@ -145,7 +157,10 @@ CmdStatus I2s::writeBuffer(uint8_t const *cmd, uint8_t response[64]) {
     const uint32_t nbBytes = convertBytesToUInt32(&cmd[1]);
     response[2] = 0x00;
 
-    if(nbBytes > _bufSize) {
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        response[2] = 0x02;
+        return CmdStatus::NOK;
+    } else if(nbBytes > _bufSize) {
         response[2] = 0x01;
         return CmdStatus::NOK;
     }
@@ -191,11 +206,12 @@ void I2s::startDma(){
         return;
     }
     //printf("Start dma for %d 32bit value\n", pBuffer->size/4);
-    dma_channel_transfer_from_buffer_now(_dmaChannel, pBuffer->vector.data(), pBuffer->size/4);
+    Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(pBuffer->size/4));
+    dma_channel_transfer_from_buffer_now(_dmaChannel, pBuffer->getDataPtr32(), pBuffer->size/4);
     /*printf("manual send\n");
     for(int it = 0; it<(pBuffer->size/4); it++) {
-        printf("manual send(%d): 0x%04Xn", it, pBuffer->vector.data()[it]);
-        pio_sm_put_blocking(_pio, 1, pBuffer->vector.data()[it]);
+        printf("manual send(%d): 0x%04Xn", it, pBuffer->getDataPtr32()[it]);
+        pio_sm_put_blocking(_pio, 1, pBuffer->getDataPtr32()[it]);
     }*/
 }
 
@@ -0,0 +1,168 @@
+#include "MemoryProgrammer.h"
+#include "string.h"
+
+MemoryProgrammer::MemoryProgrammer(uint streamBufferSize, bool doubleBuffer)
+    : StreamedInterface(streamBufferSize, doubleBuffer),
+      _memState(MEM_IDLE),
+      _memError(MEM_ERROR_NONE),
+      _memReportId(0),
+      _memAddress(0),
+      _memNbBytes(0),
+      _memNbDone(0),
+      _memNbToDiscard(0),
+      _memNextProgress(0),
+      _memPageSize(0),
+      _memHeaderSize(0),
+      _memEraseSize(0),
+      _memBusyTimeoutMs(0),
+      _memBusyDeadline(),
+      _memAddressWidth(0),
+      _memVerify(false) {
+}
+
+MemoryProgrammer::~MemoryProgrammer() {
+
+}
+
+bool MemoryProgrammer::memStart(const uint8_t *cmd, uint32_t headerSize, uint32_t eraseSize) {
+    memAbort();
+    const uint32_t address = convertBytesToUInt32(&cmd[1]);
+    const uint32_t pageSize = convertBytesToUInt16(&cmd[9]);
+    const uint8_t addressWidth = cmd[11];
+    StreamBuffer &buf = getBuffer();
+    if(pageSize == 0 || addressWidth == 0 || addressWidth > 4 || headerSize + 2 * pageSize > buf.getAllocateSize())
+        return false;
+    if(eraseSize > 0 && (eraseSize % pageSize != 0 || address % eraseSize != 0))
+        return false; // sectors erased when their first page is programmed
+
+    flushStreamRx();
+    _totalRemainingBytesToSend = 0;
+    _memReportId = cmd[0];
+    _memAddress = address;
+    _memNbBytes = convertBytesToUInt32(&cmd[5]);
+    _memNbDone = 0;
+    _memNextProgress = MEM_PROGRESS_STEP;
+    _memPageSize = pageSize;
+    _memAddressWidth = addressWidth;
+    _memBusyTimeoutMs = convertBytesToUInt16(&cmd[12]);
+    _memVerify = (cmd[14] & 0x01) != 0;
+    _memHeaderSize = headerSize;
+    _memEraseSize = eraseSize;
+    _memError = MEM_ERROR_NONE;
+    buf.setSize(_memHeaderSize);
+    _memState = MEM_RECEIVE;
+    return true;
+}
+
+uint32_t MemoryProgrammer::getMemPageLen() const {
+    const uint32_t address = _memAddress + _memNbDone;
+    return std::min(_memPageSize - address % _memPageSize, _memNbBytes - _memNbDone);
+}
+
+CmdStatus MemoryProgrammer::memTask(uint8_t response[64]) {
+    StreamBuffer &buf = getBuffer();
+    MEM_STEP step = MEM_STEP_DONE;
+    MEM_ERROR error = MEM_ERROR_BUS;
+    while(step == MEM_STEP_DONE) {
+        const uint32_t address = _memAddress + _memNbDone;
+        const uint32_t pageLen = getMemPageLen();
+        uint8_t *page = buf.getDataPtr8() + _memHeaderSize;
+
+        switch(_memState) {
+        case MEM_RECEIVE:
+            if(_memNbDone == _memNbBytes)
+                return memEnd(response, MEM_ERROR_NONE);
+            if(buf.size() < _memHeaderSize + pageLen)
+                streamRxRead(_memHeaderSize + pageLen - buf.size());
+            if(buf.size() < _memHeaderSize + pageLen)
+                return CmdStatus::NOT_FINISHED; // called again on CDC reception
+            _memState = (_memEraseSize > 0 && address % _memEraseSize == 0) ? MEM_ERASE : MEM_PROGRAM;
+            break;
+        case MEM_ERASE:
+            step = memErase(address);
+            if(step == MEM_STEP_DONE) {
+                _memBusyDeadline = make_timeout_time_ms(_memBusyTimeoutMs);
+                _memState = MEM_ERASE_BUSY;
+            }
+            break;
+        case MEM_PROGRAM:
+            step = memProgram(address, page, pageLen);
+            if(step == MEM_STEP_DONE) {
+                _memBusyDeadline = make_timeout_time_ms(_memBusyTimeoutMs);
+                _memState = MEM_PROGRAM_BUSY;
+            }
+            break;
+        case MEM_ERASE_BUSY:
+        case MEM_PROGRAM_BUSY:
+            step = memPollReady();
+            if(step == MEM_STEP_POLL && time_reached(_memBusyDeadline)) {
+                step = MEM_STEP_ERROR;
+                error = MEM_ERROR_BUSY_TIMEOUT;
+            } else if(step == MEM_STEP_DONE) {
+                _memState = _memState == MEM_ERASE_BUSY ? MEM_PROGRAM : (_memVerify ? MEM_VERIFY : MEM_RECEIVE);
+            }
+            break;
+        case MEM_VERIFY:
+            // Read back after the page
+            step = memReadBack(address, page + _memPageSize, pageLen);
+            if(step == MEM_STEP_DONE && memcmp(page, page + _memPageSize, pageLen) != 0) {
+                step = MEM_STEP_ERROR;
+                error = MEM_ERROR_VERIFY;
+            } else if(step == MEM_STEP_DONE) {
+                _memState = MEM_RECEIVE;
+            }
+            break;
+        case MEM_DISCARD:
+            if(_memNbToDiscard > 0) {
+                buf.setSize(_memHeaderSize);
+                _memNbToDiscard -= streamRxRead(_memNbToDiscard) - _memHeaderSize;
+                if(_memNbToDiscard > 0)
+                    return CmdStatus::NOT_FINISHED; // called again on CDC reception
+            }
+            return memEnd(response, _memError);
+        default:
+            return CmdStatus::NOT_CONCERNED;
+        }
+
+        if(step == MEM_STEP_DONE && _memState == MEM_RECEIVE) {
+            // Page done
+            _memNbDone += pageLen;
+            buf.setSize(_memHeaderSize);
+            if(_memNbDone >= _memNextProgress && _memNbDone < _memNbBytes) {
+                _memNextProgress += MEM_PROGRESS_STEP;
+                response[0] = _memReportId;
+                convertUInt32ToBytes(_memNbDone, &response[2]);
+                cancelWaitCdcRx(); // resumed by the main loop after the report
+                return CmdStatus::PROGRESS;
+            }
+        }
+    }
+
+    if(step == MEM_STEP_ERROR) {
+        _memError = error;
+        _memNbToDiscard = _memNbBytes - _memNbDone - (buf.size() - _memHeaderSize);
+        _memState = MEM_DISCARD;
+        cancelWaitCdcRx();
+        return CmdStatus::NOT_FINISHED;
+    }
+    if(step == MEM_STEP_POLL) {
+        cancelWaitCdcRx(); // the page is received, polled whatever CDC receives
+        return CmdStatus::NOT_FINISHED;
+    }
+    return CmdStatus::NOT_CONCERNED; // MEM_STEP_WAIT
+}
+
+void MemoryProgrammer::memAbort() {
+    if(_memState != MEM_IDLE) {
+        _memState = MEM_IDLE;
+        getBuffer().setSize(0);
+    }
+}
+
+CmdStatus MemoryProgrammer::memEnd(uint8_t response[64], MEM_ERROR error) {
+    memAbort();
+    response[0] = _memReportId;
+    convertUInt32ToBytes(_memNbDone, &response[2]);
+    response[6] = error;
+    return error == MEM_ERROR_NONE ? CmdStatus::OK : CmdStatus::NOK;
+}
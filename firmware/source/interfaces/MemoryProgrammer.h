@@ -0,0 +1,83 @@
+#ifndef _INTERFACE_MEMORY_PROGRAMMER_H
+#define _INTERFACE_MEMORY_PROGRAMMER_H
+
+#include "PicoInterfacesBoard.h"
+#include "StreamedInterface.h"
+#include "pico/stdlib.h"
+
+// Streamed interface programming an external memory (SPI NOR flash, I2C EEPROM) from a CDC stream: the stream is cut
+// in pages, each one erased if needed, programmed, polled until ready and optionally read back, without the host.
+// The bus operations of a page are the mem*() steps of the subclass.
+class MemoryProgrammer : public StreamedInterface {
+public:
+    MemoryProgrammer(uint streamBufferSize, bool doubleBuffer = false);
+    virtual ~MemoryProgrammer();
+
+protected:
+    enum MEM_STEP {
+        MEM_STEP_DONE = 0x00,
+        MEM_STEP_POLL = 0x01,  // not done, called again on next pass
+        MEM_STEP_WAIT = 0x02,  // not done, called again when the transfer ends (setPending)
+        MEM_STEP_ERROR = 0x03
+    };
+    enum MEM_STATE {
+        MEM_IDLE = 0x00,
+        MEM_RECEIVE = 0x01,       // page bytes read from CDC
+        MEM_ERASE = 0x02,
+        MEM_ERASE_BUSY = 0x03,
+        MEM_PROGRAM = 0x04,
+        MEM_PROGRAM_BUSY = 0x05,
+        MEM_VERIFY = 0x06,
+        MEM_DISCARD = 0x07        // after an error, the rest of the stream is read and dropped
+    };
+    enum MEM_ERROR {
+        MEM_ERROR_NONE = 0x00,
+        MEM_ERROR_BUS = 0x01,          // transfer not acknowledged or timed out
+        MEM_ERROR_BUSY_TIMEOUT = 0x02, // still busy after BUSY_TIMEOUT_MS
+        MEM_ERROR_VERIFY = 0x03        // read back different from the programmed page
+    };
+    // Progress report every MEM_PROGRESS_STEP programmed bytes
+    static const uint32_t MEM_PROGRESS_STEP = 65536;
+
+    // Common part of the xxx_MEM_PROGRAM command (bytes 1 to 14). headerSize: bytes before each page in the buffer
+    // (opcode, address) filled by memProgram(). False if the profile is not valid or the page does not fit twice
+    // (data and read back) in the stream buffer.
+    bool memStart(const uint8_t *cmd, uint32_t headerSize, uint32_t eraseSize);
+    inline bool isMemRunning() const { return _memState != MEM_IDLE; }
+    // Stops the running programming (bus command or stream started)
+    void memAbort();
+    // To call from task() while running: progress reports (CmdStatus::PROGRESS) then the final response
+    CmdStatus memTask(uint8_t response[64]);
+
+    // Bus operations, called again while they return MEM_STEP_POLL or MEM_STEP_WAIT
+    virtual MEM_STEP memErase(uint32_t address) = 0;
+    // page: pageLen bytes preceded by the headerSize bytes free for the command
+    virtual MEM_STEP memProgram(uint32_t address, uint8_t *page, uint32_t pageLen) = 0;
+    // MEM_STEP_POLL while the memory is busy
+    virtual MEM_STEP memPollReady() = 0;
+    virtual MEM_STEP memReadBack(uint32_t address, uint8_t *dst, uint32_t len) = 0;
+
+    // Bytes of the current page: up to the page boundary or the end of the stream
+    uint32_t getMemPageLen() const;
+    inline uint8_t getMemAddressWidth() const { return _memAddressWidth; }
+    CmdStatus memEnd(uint8_t response[64], MEM_ERROR error);
+
+    MEM_STATE _memState;
+    MEM_ERROR _memError;
+    uint8_t _memReportId;
+    uint32_t _memAddress;
+    uint32_t _memNbBytes;
+    uint32_t _memNbDone;
+    uint32_t _memNbToDiscard;
+    uint32_t _memNextProgress;
+    uint32_t _memPageSize;
+    uint32_t _memHeaderSize;
+    uint32_t _memEraseSize; // 0: no erase
+    uint32_t _memBusyTimeoutMs;
+    absolute_time_t _memBusyDeadline;
+    uint8_t _memAddressWidth;
+    bool _memVerify;
+};
+
+
+#endif
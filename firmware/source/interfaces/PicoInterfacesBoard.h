@@ -54,6 +54,8 @@
 enum CmdStatus {
     OK = 0x01,
     NOK = 0x02,
+    TIMEOUT = 0x03, // asynchronous command not finished before its deadline (SYS_SET_CMD_TIMEOUT)
+    PROGRESS = 0x04, // intermediate response of a streamed command sent by task(), the final one follows
     NOT_FINISHED = 0xFE, // INTERNAL
     NOT_CONCERNED = 0xFF
 };
@@ -64,6 +66,30 @@ enum IRQ_EVENT {
     EVENT_FALLING = 0x02,
 };
 
+// SYS_GET_STATS sections
+enum STATS_SECTION {
+    STATS_SUMMARY = 0x00,
+    STATS_LOOP = 0x01,
+    STATS_CMD = 0x02,
+    STATS_TASK = 0x03
+};
+
+// SYS_TRACE_READ events. Interface index: construction order, see SYS_GET_STATS STATS_TASK
+enum TRACE_EVENT {
+    TRACE_CMD_RECEIVED = 0x01,    // ID: report ID, ARG: transport (0=HID; 1=BULK)
+    TRACE_CMD_START = 0x02,       // ID: report ID, process() called
+    TRACE_CMD_END = 0x03,         // ID: report ID, ARG: CmdStatus
+    TRACE_TASK_START = 0x04,      // ID: interface index
+    TRACE_TASK_END = 0x05,        // ID: interface index, ARG: CmdStatus
+    TRACE_DMA_START = 0x06,       // ID: interface index, ARG: NB_WORDS
+    TRACE_DMA_END = 0x07,         // ID: interface index
+    TRACE_CDC_READ = 0x08,        // ID: interface index, ARG: NB_BYTES
+    TRACE_RESPONSE_QUEUED = 0x09, // ID: report ID, ARG: queue level
+    TRACE_RESPONSE_SENT = 0x0A,   // ID: report ID, ARG: transport
+    TRACE_SLEEP = 0x0B,
+    TRACE_WAKE = 0x0C
+};
+
 // Each report size is is 64 bytes.
 // In general reports return | Report::ID | CmdStatus::OK or CmdStatus::NOK |
 namespace Report {
@@ -75,6 +101,52 @@ namespace Report {
         SYS_GET_SN = 0x11,
         // | SYS_GET_VN | => | SYS_GET_VN | CmdStatus::OK | MAJOR VERSION | MINOR VERSION | PATCH VERSION |
         SYS_GET_VN = 0x12,
+        // Commands are executed in order until one of them does not return CmdStatus::OK. RESPONSE_SIZE is the payload size returned for the command (response without its two header bytes).
+        // An asynchronous command (I2C transfer...) is waited for (up to its SYS_SET_CMD_TIMEOUT deadline, TIMEOUT status), the batch is answered once all have run.
+        // When the deadline of the batch is reached first, the command waited for is stopped.
+        // The end of a stream started by the batch is sent later, with the tag of the batch.
+        // | SYS_BATCH | NB_CMDS | (CMD_SIZE | RESPONSE_SIZE | CMD[CMD_SIZE]) * NB_CMDS | => | SYS_BATCH | CmdStatus::OK|NOK | NB_EXECUTED | (STATUS | PAYLOAD[RESPONSE_SIZE]) * NB_EXECUTED |
+        SYS_BATCH = 0x13,
+        // Command envelope to have several commands in flight: TAG (1..255) is copied in the responses of the command, including the ones sent later (end of stream...).
+        // The command is truncated to 62 bytes. The response is limited to | ID | STATUS | + 60 bytes: commands reading more data are
+        // answered NOK (UART and trace reads return less).
+        // | SYS_TAGGED | TAG | CMD[62] | => | SYS_TAGGED | TAG | RESPONSE[62] |
+        SYS_TAGGED = 0x14,
+        // Response queue usage. DEFERRED_CMDS: commands executed later because the queue was full, DROPPED_*: lost (should stay 0).
+        // HID commands received while 16 commands are already waiting are answered NOK (bulk ones wait in the endpoint). RESET=1 clears the counters.
+        // A bulk frame with a SIZE over 64 drops the rest of its USB packet, counted in DROPPED_CMDS.
+        // | SYS_GET_QUEUE_STATS | RESET | => | SYS_GET_QUEUE_STATS | CmdStatus::OK | SIZE | LEVEL | HIGH_WATER | DEFERRED_CMDS[4] | DROPPED_CMDS[4] | DROPPED_RESPONSES[4] |
+        SYS_GET_QUEUE_STATS = 0x15,
+        // Deadline of asynchronous commands (answered later, e.g. FREQ_COUNTER_GET_MEASUREMENT), they end with | ID | CmdStatus::TIMEOUT | when reached.
+        // REPORT_ID=0 sets all commands, TIMEOUT_MS=0 disables the timeout. Default is 2000 ms.
+        // | SYS_SET_CMD_TIMEOUT | REPORT_ID | TIMEOUT_MS[4] | => | SYS_SET_CMD_TIMEOUT | CmdStatus::OK |
+        SYS_SET_CMD_TIMEOUT = 0x16,
+        // Performance counters since boot or SYS_RESET_STATS, durations in us. One section per request, SECTION and INDEX are echoed.
+        // DURATION: | COUNT[4] | MAX_US[4] | TOTAL_US[8] | HISTOGRAM[4] * 8 | bucket 0: < 4 us, bucket i: [4^i, 4^(i+1)[ us, bucket 7: >= 16384 us
+        // STATS_SUMMARY: | SYS_GET_STATS | CmdStatus::OK | SECTION | 0 | ELAPSED_US[8] | SLEEP_US[8] | QUEUE_SIZE | QUEUE_HIGH_WATER | NB_INTERFACES | EXECUTED_CMDS_MASK[32] (bit = report ID) |
+        // STATS_LOOP: INDEX 0 = main loop iteration (sleep excluded), 1 = USB stack | SYS_GET_STATS | CmdStatus::OK | SECTION | INDEX | DURATION |
+        // STATS_CMD: INDEX = report ID, process() duration | SYS_GET_STATS | CmdStatus::OK | SECTION | INDEX | DURATION |
+        // STATS_TASK: INDEX < NB_INTERFACES, task() duration | SYS_GET_STATS | CmdStatus::OK | SECTION | INDEX | DURATION | FIRST_REPORT_ID | CDC_BYTES[8] |
+        // | SYS_GET_STATS | SECTION | INDEX | => see above
+        SYS_GET_STATS = 0x17,
+        // Clears the performance counters and the response queue counters
+        // | SYS_RESET_STATS | => | SYS_RESET_STATS | CmdStatus::OK |
+        SYS_RESET_STATS = 0x18,
+        // Events trace: ENABLE=1 clears the trace and starts it, ENABLE=0 stops it (the events are kept). Stopped at boot.
+        // | SYS_TRACE_CTRL | ENABLE | => | SYS_TRACE_CTRL | CmdStatus::OK | SIZE[4] | LEVEL[4] | DROPPED_EVENTS[4] |
+        SYS_TRACE_CTRL = 0x19,
+        // Oldest events first (removed from the trace), NB_EVENTS=0 when empty. TIME_US: 1 MHz timer (32 bits, wraps), TYPE: TRACE_EVENT
+        // | SYS_TRACE_READ | => | SYS_TRACE_READ | CmdStatus::OK | NB_EVENTS (max 7) | DROPPED_EVENTS[4] | (TIME_US[4] | TYPE | ID | ARG[2]) * NB_EVENTS |
+        SYS_TRACE_READ = 0x1A,
+        // CDC throughput self-tests on NB_BYTES: SINK reads and drops the bytes sent by the host, SOURCE sends bytes counting from 0 (modulo 256),
+        // LOOPBACK sends back the bytes received. CHUNK_SIZE: max bytes per CDC read/write call (0 or above the 1216 bytes buffer: buffer size).
+        // The first response acknowledges the command, the second one ends the test. ELAPSED_US: from the first to the last byte transferred.
+        // STALLS: times the test waited for the host (no CDC data to read or no room to write), STALL_US and MAX_STALL_US their total and longest durations.
+        // | SYS_BENCH_CDC_* | NB_BYTES[4] | CHUNK_SIZE[2] | => | SYS_BENCH_CDC_* | CmdStatus::OK | then
+        // | SYS_BENCH_CDC_* | CmdStatus::OK | ELAPSED_US[4] | NB_BYTES[4] | STALLS[4] | STALL_US[4] | MAX_STALL_US[4] |
+        SYS_BENCH_CDC_SINK = 0x1B,
+        SYS_BENCH_CDC_SOURCE = 0x1C,
+        SYS_BENCH_CDC_LOOPBACK = 0x1D,
 
         // GPIO
         // | GPIO_INIT_PIN | GP NUMBER | DIRECTION (0=INPUT; 1=OUTPUT) | PULL (0=NONE; 1=PULLUP; 2=PULLDOWN)
@@ -136,16 +208,35 @@ namespace Report {
         UART1_READ = UART0_READ + UART0_UART1_OFFSET,
 
         // SPI0
-        // | SPI0_INIT | MODE (To implement) | BAUDRATE[4] L.Endian |
+        // | SPI0_INIT | MODE (bit1: CPOL, bit0: CPHA) | BAUDRATE[4] L.Endian | settings of the device 0 (no CS)
         SPI0_INIT = 0x60,
+        // The running stream or memory programming is stopped. The other commands are answered NOK while a stream
+        // (SPI0_WRITE_FROM_UART, SPI0_TRANSFER_STREAM, SPI0_DISPLAY_WRITE) or SPI0_MEM_PROGRAM runs.
         // | SPI0_DEINIT |
         SPI0_DEINIT = 0x61,
         // | SPI0_WRITE | NB_BYTES[1] | PAYLOAD |
         SPI0_WRITE = 0x62,
         // | I2C0_READ | WRITE_BYTE | NB_BYTES[1] | => | SPI0_READ | CmdStatus::OK | PAYLOAD |
         SPI0_READ = 0x63,
-        // | SPI0_WRITE_FROM_UART | NB_BYTES[4] L.Endian | => First | SPI0_WRITE_FROM_UART | CmdStatus::OK | and after the CDC stream | SPI0_WRITE_FROM_UART | CmdStatus::OK |
+        // | SPI0_WRITE_FROM_UART | NB_BYTES[4] L.Endian | DEVICE | => First | SPI0_WRITE_FROM_UART | CmdStatus::OK | and after the CDC stream | SPI0_WRITE_FROM_UART | CmdStatus::OK |
         SPI0_WRITE_FROM_UART = 0x64,
+        // | SPI0_TRANSFER_STREAM | NB_BYTES[4] L.Endian | FILL (0: TX bytes from CDC, 1: FILL_BYTE) | FILL_BYTE | DEVICE (frames up to 8 bits) | => First | SPI0_TRANSFER_STREAM | CmdStatus::OK |, the NB_BYTES RX bytes on CDC, then | SPI0_TRANSFER_STREAM | CmdStatus::OK |
+        SPI0_TRANSFER_STREAM = 0x65,
+        // | SPI0_DISPLAY_PINS | CS_GP (0xFF: none) | DC_GP (0xFF: none) |
+        SPI0_DISPLAY_PINS = 0x66,
+        // | SPI0_DISPLAY_WRITE | FLAGS (bit0: 16-bit data frames) | NB_BYTES[4] L.Endian | LIST_SIZE | LIST | with LIST entries | DC (bit7, 1: data) NB (bits 0-6) | BYTES[NB] |
+        // => | SPI0_DISPLAY_WRITE | CmdStatus::OK | if NB_BYTES is 0, else first | SPI0_DISPLAY_WRITE | CmdStatus::OK | and after the NB_BYTES data of the CDC stream | SPI0_DISPLAY_WRITE | CmdStatus::OK |
+        SPI0_DISPLAY_WRITE = 0x67,
+        // | SPI0_MEM_PROGRAM | ADDRESS[4] L.Endian | NB_BYTES[4] L.Endian | PAGE_SIZE[2] L.Endian | ADDR_WIDTH | BUSY_TIMEOUT_MS[2] L.Endian | FLAGS (bit0: verify) | CS_GP | OP_WRITE_ENABLE | OP_PROGRAM | OP_READ_STATUS | BUSY_MASK | OP_READ | OP_ERASE (0: no erase) | ERASE_SIZE[4] L.Endian |
+        // => First | SPI0_MEM_PROGRAM | CmdStatus::OK |, | SPI0_MEM_PROGRAM | CmdStatus::PROGRESS | NB_BYTES_DONE[4] | every 64 KiB programmed, and at the end | SPI0_MEM_PROGRAM | CmdStatus::OK or NOK | NB_BYTES_DONE[4] | ERROR (1: bus, 2: busy timeout, 3: verify) |
+        SPI0_MEM_PROGRAM = 0x68,
+        // DEVICE: 0 for the settings of SPI0_INIT without CS, else a SPI0_DEVICE_CONFIG descriptor. The baudrate and format
+        // are only set again when the addressed device changes, its CS is asserted during the transfer
+        // | SPI0_DEVICE_CONFIG | DEVICE (1-4) | CS_GP (0xFF: none) | FLAGS (bit0: CS active high, bit1: LSB first) | MODE (bit1: CPOL, bit0: CPHA) | FRAME_BITS (4-16) | BAUDRATE[4] L.Endian |
+        SPI0_DEVICE_CONFIG = 0x69,
+        // | SPI0_DEVICE_TRANSFER | DEVICE | FLAGS (bit0: TX bytes from PAYLOAD else WRITE_BYTE repeated, bit1: CS kept asserted) | WRITE_BYTE | NB_BYTES (max 59) | PAYLOAD | => | SPI0_DEVICE_TRANSFER | CmdStatus::OK | RX PAYLOAD |
+        // Frames over 8 bits are L.Endian byte pairs
+        SPI0_DEVICE_TRANSFER = 0x6A,
 
         // SPI1: 0x7X
         SPI0_SPI1_OFFSET = 0x10,
@@ -154,18 +245,55 @@ namespace Report {
         SPI1_WRITE = SPI0_WRITE + SPI0_SPI1_OFFSET,
         SPI1_READ = SPI0_READ + SPI0_SPI1_OFFSET,
         SPI1_WRITE_FROM_UART = SPI0_WRITE_FROM_UART + SPI0_SPI1_OFFSET,
+        SPI1_TRANSFER_STREAM = SPI0_TRANSFER_STREAM + SPI0_SPI1_OFFSET,
+        SPI1_DISPLAY_PINS = SPI0_DISPLAY_PINS + SPI0_SPI1_OFFSET,
+        SPI1_DISPLAY_WRITE = SPI0_DISPLAY_WRITE + SPI0_SPI1_OFFSET,
+        SPI1_MEM_PROGRAM = SPI0_MEM_PROGRAM + SPI0_SPI1_OFFSET,
+        SPI1_DEVICE_CONFIG = SPI0_DEVICE_CONFIG + SPI0_SPI1_OFFSET,
+        SPI1_DEVICE_TRANSFER = SPI0_DEVICE_TRANSFER + SPI0_SPI1_OFFSET,
 
         // I2C0
         // | I2C0_INIT | PULLUP(1=True) | BAUDRATE[4] L.Endian |
         I2C0_INIT = 0x80,
+        // The running command (transfer, stream) is stopped and answered NOK, like with I2C0_BUS_CLEAR. The other commands
+        // are answered NOK while one runs.
         // | I2C0_DEINIT |
         I2C0_DEINIT = 0x81,
         // | I2C0_WRITE | ADDR | SEND_STOP | NB_BYTES[4] L.Endian | PAYLOAD |
+        // => | I2C0_WRITE | CmdStatus::OK, NOK (not acknowledged) or TIMEOUT (bus recovered) |, answered at the end of the DMA transfer
         I2C0_WRITE = 0x82,
-        // | I2C0_READ | ADDR | SEND_STOP | NB_BYTES => | I2C0_READ | CmdStatus::OK | PAYLOAD |
+        // | I2C0_READ | ADDR | SEND_STOP | NB_BYTES => | I2C0_READ | CmdStatus::OK | PAYLOAD | (NOK or TIMEOUT as I2C0_WRITE)
         I2C0_READ = 0x83,
         // | I2C0_WRITE_FROM_UART | ADDR | NB_BYTES[4] L.Endian | => First | I2C0_WRITE_FROM_UART | CmdStatus::OK | and after the CDC stream | I2C0_WRITE_FROM_UART | CmdStatus::OK |
         I2C0_WRITE_FROM_UART = 0x84,
+        // | I2C0_MEM_PROGRAM | ADDRESS[4] L.Endian | NB_BYTES[4] L.Endian | PAGE_SIZE[2] L.Endian | ADDR_WIDTH | BUSY_TIMEOUT_MS[2] L.Endian | FLAGS (bit0: verify) | ADDR |
+        // => First | I2C0_MEM_PROGRAM | CmdStatus::OK |, | I2C0_MEM_PROGRAM | CmdStatus::PROGRESS | NB_BYTES_DONE[4] | every 64 KiB programmed, and at the end | I2C0_MEM_PROGRAM | CmdStatus::OK or NOK | NB_BYTES_DONE[4] | ERROR (1: bus, 2: busy timeout, 3: verify) |
+        I2C0_MEM_PROGRAM = 0x85,
+        // Timeout of each transfer, a stuck bus is then cleared (SCL clocked until SDA is released, STOP). 0: from the
+        // number of bytes and the baudrate (default).
+        // | I2C0_SET_TIMEOUT | TIMEOUT_US[4] L.Endian |
+        I2C0_SET_TIMEOUT = 0x86,
+        // Up to 9 SCL clocks until the slave releases SDA, then a STOP. A read stream sends zeros for the bytes not read.
+        // | I2C0_BUS_CLEAR | => | I2C0_BUS_CLEAR | CmdStatus::OK | SDA_RELEASED (1=True) |
+        I2C0_BUS_CLEAR = 0x87,
+        // Register read: write then read after a repeated start, one transaction
+        // | I2C0_WRITE_READ | ADDR | NB_WRITE | NB_READ | WRITE_BYTES | => | I2C0_WRITE_READ | CmdStatus::OK | PAYLOAD |
+        I2C0_WRITE_READ = 0x88,
+        // Several write-then-read transactions (NB_WRITE or NB_READ can be 0), their read bytes concatenated (62 max)
+        // | I2C0_WRITE_READ_LIST | NB_ENTRIES | ADDR | NB_WRITE | NB_READ | WRITE_BYTES | ADDR | NB_WRITE | ... |
+        // => | I2C0_WRITE_READ_LIST | CmdStatus::OK | PAYLOAD | or | I2C0_WRITE_READ_LIST | CmdStatus::NOK or TIMEOUT | FAILED_ENTRY |
+        I2C0_WRITE_READ_LIST = 0x89,
+        // Read of any length (after the optional register bytes, repeated start), the data are sent on CDC
+        // | I2C0_READ_TO_STREAM | ADDR | NB_BYTES[4] L.Endian | NB_WRITE | WRITE_BYTES |
+        // => First | I2C0_READ_TO_STREAM | CmdStatus::OK |, NB_BYTES on CDC (zeros after an error) and at the end
+        // | I2C0_READ_TO_STREAM | CmdStatus::OK, NOK or TIMEOUT | NB_BYTES_READ[4] L.Endian |
+        I2C0_READ_TO_STREAM = 0x8A,
+        // Probe of the addresses FIRST_ADDR to LAST_ADDR, one transfer each: a 1-byte read if the bit of the address is set
+        // in READ_PROBE_MASK, a write of 0x00 otherwise. PROBE_TIMEOUT_US 0: from the baudrate. BITMAP bit n (byte n / 8): address
+        // n acknowledged. A timeout (bus cleared) ends the scan at LAST_PROBED.
+        // | I2C0_SCAN | FIRST_ADDR | LAST_ADDR | PROBE_TIMEOUT_US[2] L.Endian | READ_PROBE_MASK[16] |
+        // => | I2C0_SCAN | CmdStatus::OK or TIMEOUT | BITMAP[16] | LAST_PROBED |
+        I2C0_SCAN = 0x8B,
 
         // I2C1: 0x9X
         I2C0_I2C1_OFFSET = 0x10,
@@ -174,6 +302,13 @@ namespace Report {
         I2C1_WRITE = I2C0_WRITE + I2C0_I2C1_OFFSET,
         I2C1_READ = I2C0_READ + I2C0_I2C1_OFFSET,
         I2C1_WRITE_FROM_UART = I2C0_WRITE_FROM_UART + I2C0_I2C1_OFFSET,
+        I2C1_MEM_PROGRAM = I2C0_MEM_PROGRAM + I2C0_I2C1_OFFSET,
+        I2C1_SET_TIMEOUT = I2C0_SET_TIMEOUT + I2C0_I2C1_OFFSET,
+        I2C1_BUS_CLEAR = I2C0_BUS_CLEAR + I2C0_I2C1_OFFSET,
+        I2C1_WRITE_READ = I2C0_WRITE_READ + I2C0_I2C1_OFFSET,
+        I2C1_WRITE_READ_LIST = I2C0_WRITE_READ_LIST + I2C0_I2C1_OFFSET,
+        I2C1_READ_TO_STREAM = I2C0_READ_TO_STREAM + I2C0_I2C1_OFFSET,
+        I2C1_SCAN = I2C0_SCAN + I2C0_I2C1_OFFSET,
 
         // WS2812B (LED)
         // | WS2812B_INIT |
@@ -184,6 +319,23 @@ namespace Report {
         // ... and after the CDC stream (when transfer to led starting) | WS2812B_WRITE | CmdStatus::OK |
         WS2812B_WRITE = 0xA2,
 
+        // I2C TARGET: 0xA8-0xAC (second half of the WS2812B block), I2C0 or I2C1 in slave mode serving a register map
+        // of 256 bytes (1 byte register address, auto-increment). Writes to the registers set in READ_ONLY_MASK are ignored.
+        // | I2C_TARGET_INIT | I2C_INDEX | ADDR | PULLUP (1=True) | READ_ONLY_MASK[32] |
+        I2C_TARGET_INIT = 0xA8,
+        // | I2C_TARGET_DEINIT |
+        I2C_TARGET_DEINIT = 0xA9,
+        // Registers loaded at once from the CDC stream
+        // | I2C_TARGET_WRITE_MAP | FIRST_REG | NB_BYTES[2] L.Endian | => First | I2C_TARGET_WRITE_MAP | CmdStatus::OK | and after the CDC stream | I2C_TARGET_WRITE_MAP | CmdStatus::OK |
+        I2C_TARGET_WRITE_MAP = 0xAA,
+        // Registers read at once, sent on CDC
+        // | I2C_TARGET_READ_MAP | FIRST_REG | NB_BYTES[2] L.Endian | => First | I2C_TARGET_READ_MAP | CmdStatus::OK |, NB_BYTES on CDC and | I2C_TARGET_READ_MAP | CmdStatus::OK |
+        I2C_TARGET_READ_MAP = 0xAB,
+        // Registers written by the bus master (bit n of byte n / 8) and number of write transactions since the previous call.
+        // WAIT: answered at the end of the next write transaction if there is none (asynchronous), NOK if a wait is running.
+        // | I2C_TARGET_GET_CHANGES | WAIT (1=True) | => | I2C_TARGET_GET_CHANGES | CmdStatus::OK | NB_WRITES[2] L.Endian | CHANGED[32] |
+        I2C_TARGET_GET_CHANGES = 0xAC,
+
         // I2S
         // |I2S_INIT | MODE (0x01: mono, 0x02: stereo) => Mode not implemented,only stereo 16bit/channel |
         I2S_INIT = 0xB0,
@@ -208,8 +360,21 @@ namespace Report {
         FREQ_COUNTER_INIT = 0xE0,
         // | FREQ_COUNTER_DEINIT | GP NUMBER | => | FREQ_COUNTER_DEINIT | CmdStatus::OK/NOK | GP NUMBER |
         FREQ_COUNTER_DEINIT = 0xE1,
-        // | FREQ_COUNTER_GET_MEASUREMENT | GP NUMBER | => | FREQ_COUNTER_GET_MEASUREMENT | CmdStatus::OK/NOK | GP NUMBER | HIGH_CYCLES[4] L.Endian | LOW_CYCLES[4] L.Endian | err: 0x01=Timeout/No signal? (Not implemented yet) |
+        // Asynchronous: answered when the measurement is done, or with CmdStatus::TIMEOUT (no signal, see SYS_SET_CMD_TIMEOUT). One measurement at a time.
+        // | FREQ_COUNTER_GET_MEASUREMENT | GP NUMBER | => | FREQ_COUNTER_GET_MEASUREMENT | CmdStatus::OK/NOK/TIMEOUT | GP NUMBER | HIGH_CYCLES[4] L.Endian | LOW_CYCLES[4] L.Endian |
         FREQ_COUNTER_GET_MEASUREMENT = 0xE2,
+
+        // QSPI (PIO): 0xFX
+        // | QSPI_INIT | SCK_GP | IO0_GP (IO0-IO3 on consecutive GPIOs) | CS_GP (0xFF: none) | FREQ[4] L.Endian | => | QSPI_INIT | CmdStatus::OK/NOK | (NOK: no PIO state machine or program space)
+        // QSPI_WRITE and QSPI_READ transaction, phases skipped when their size is 0, LANES is 1, 2 or 4:
+        // | ID | CMD_LANES (0: no command) | COMMAND | ADDR_LANES | ADDR_BYTES (0-4) | ADDRESS[4] L.Endian (sent MSB first) | DUMMY_CYCLES | DATA_LANES | NB_BYTES[4] L.Endian |
+        // QSPI_WRITE => | QSPI_WRITE | CmdStatus::OK | if NB_BYTES is 0, else first | QSPI_WRITE | CmdStatus::OK | and after the NB_BYTES data of the CDC stream | QSPI_WRITE | CmdStatus::OK |
+        // QSPI_READ (NB_BYTES max 62) => | QSPI_READ | CmdStatus::OK | DATA |
+        QSPI_INIT = 0xF0,
+        // | QSPI_DEINIT |
+        QSPI_DEINIT = 0xF1,
+        QSPI_WRITE = 0xF2,
+        QSPI_READ = 0xF3,
     };
 }
 
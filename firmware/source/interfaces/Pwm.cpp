@@ -10,6 +10,16 @@
 
 Pwm::Pwm() {
     setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::PWM_INIT_PIN,
+        Report::ID::PWM_DEINIT_PIN,
+        Report::ID::PWM_SET_FREQ,
+        Report::ID::PWM_GET_FREQ,
+        Report::ID::PWM_SET_DUTY_U16,
+        Report::ID::PWM_GET_DUTY_U16,
+        Report::ID::PWM_SET_DUTY_NS,
+        Report::ID::PWM_GET_DUTY_NS
+    });
 }
 
 Pwm::~Pwm() {
@@ -0,0 +1,304 @@
+#include "Qspi.h"
+#include "string.h"
+
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "qspi.pio.h"
+#include "../Trace.h"
+
+Qspi *Qspi::_sQspi = nullptr;
+
+
+Qspi::Qspi(uint streamBufferSize)
+    : StreamedInterface(streamBufferSize, true), // next CDC chunk received while the DMA clocks out the previous one
+      _pio(pio0),
+      _sm(-1),
+      _offsetProgram(0),
+      _sckGP(0),
+      _io0GP(0),
+      _csGP(-1),
+      _dmaChannel(-1),
+      _dmaLen(0) {
+    _sQspi = this;
+    registerReports({
+        Report::ID::QSPI_INIT,
+        Report::ID::QSPI_DEINIT,
+        Report::ID::QSPI_WRITE,
+        Report::ID::QSPI_READ
+    });
+}
+
+Qspi::~Qspi() {
+
+}
+
+void Qspi::dmaHandler() {
+    if(_sQspi == nullptr || _sQspi->_dmaChannel < 0 || !(dma_hw->ints0 & (1u << _sQspi->_dmaChannel)))
+        return; // DMA_IRQ_0 is shared (SPI streams, WS2812B)
+    dma_hw->ints0 = 1u << _sQspi->_dmaChannel;
+    Trace::record(TRACE_EVENT::TRACE_DMA_END, _sQspi->getInterfaceIndex());
+    _sQspi->setPending(); // task() sends the next chunk
+}
+
+CmdStatus Qspi::process(uint8_t const *cmd, uint8_t response[64]) {
+    CmdStatus status = CmdStatus::NOT_CONCERNED;
+
+    if(_totalRemainingBytesToSend > 0) {
+        return CmdStatus::NOK; // data phase of the previous transaction still streamed
+    }
+
+    if(cmd[0] == Report::ID::QSPI_INIT) {
+        status = init(cmd);
+    } else if(cmd[0] == Report::ID::QSPI_DEINIT) {
+        status = deInit();
+    } else if(cmd[0] == Report::ID::QSPI_WRITE || cmd[0] == Report::ID::QSPI_READ) {
+        status = transaction(cmd, response);
+    }
+
+    return status;
+}
+
+CmdStatus Qspi::task(uint8_t response[64]) {
+    if(_totalRemainingBytesToSend == 0)
+        return CmdStatus::NOT_CONCERNED;
+
+    if(_dmaLen > 0 && !dma_channel_is_busy(_dmaChannel)) {
+        _totalRemainingBytesToSend -= _dmaLen;
+        _dmaLen = 0;
+    }
+
+    // Receive buffer: filled from CDC while the other one is clocked out
+    StreamBuffer &buf = getBuffer();
+    const uint32_t nbBytesToReceive = _totalRemainingBytesToSend - _dmaLen - buf.size();
+    if(nbBytesToReceive > 0 && buf.size() < buf.getAllocateSize())
+        streamRxRead(nbBytesToReceive);
+
+    if(_dmaLen == 0 && buf.size() > 0) {
+        startDmaWrite(buf.getDataPtr8(), buf.size());
+        switchBuffer();
+        getBuffer().setSize(0); // clocked out by the previous transfer
+    }
+
+    if(_totalRemainingBytesToSend == 0) {
+        waitIdle();
+        endTransaction();
+        response[0] = Report::ID::QSPI_WRITE;
+        return CmdStatus::OK;
+    }
+
+    const StreamBuffer &nextBuf = getBuffer();
+    if(_dmaLen > 0 && (nextBuf.size() == nextBuf.getAllocateSize() || _totalRemainingBytesToSend == _dmaLen + nextBuf.size()))
+        return CmdStatus::NOT_CONCERNED; // woken by dmaHandler
+    return CmdStatus::NOT_FINISHED;
+}
+
+CmdStatus Qspi::init(uint8_t const *cmd) {
+    const uint sckGP = cmd[1];
+    const uint io0GP = cmd[2];
+    const uint32_t freq = convertBytesToUInt32(&cmd[4]);
+    if(getInterfaceState() == InterfaceState::INTIALIZED || sckGP >= NUM_BANK0_GPIOS || io0GP + 4 > NUM_BANK0_GPIOS ||
+            (sckGP >= io0GP && sckGP < io0GP + 4) || freq == 0) {
+        return CmdStatus::NOK;
+    }
+
+    // Free state machine with room for the program, except the ones of WS2812B (pio0 SM0), I2S (pio1 SM1) and
+    // HUB75 (pio1 SM2 and SM3)
+    static const struct { PIO pio; uint sm; } candidates[] = {{pio0, 1}, {pio0, 2}, {pio0, 3}, {pio1, 0}};
+    _sm = -1;
+    for(const auto &candidate : candidates) {
+        if(!pio_sm_is_claimed(candidate.pio, candidate.sm) && pio_can_add_program(candidate.pio, &qspi_program)) {
+            pio_sm_claim(candidate.pio, candidate.sm);
+            _pio = candidate.pio;
+            _sm = static_cast<int>(candidate.sm);
+            break;
+        }
+    }
+    if(_sm < 0) {
+        return CmdStatus::NOK;
+    }
+    if(!acquireStreamBuffers()) {
+        pio_sm_unclaim(_pio, _sm);
+        _sm = -1;
+        return CmdStatus::NOK; // memory arena exhausted
+    }
+
+    if(_dmaChannel < 0) {
+        _dmaChannel = dma_claim_unused_channel(true);
+        dma_channel_set_irq0_enabled(_dmaChannel, true);
+        static bool dmaHandlerAdded = false;
+        if(!dmaHandlerAdded) {
+            irq_add_shared_handler(DMA_IRQ_0, dmaHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irq_set_enabled(DMA_IRQ_0, true);
+            dmaHandlerAdded = true;
+        }
+    }
+
+    _sckGP = sckGP;
+    _io0GP = io0GP;
+    _csGP = cmd[3] < NUM_BANK0_GPIOS ? cmd[3] : -1;
+    if(_csGP >= 0) {
+        gpio_init(_csGP);
+        gpio_set_dir(_csGP, GPIO_OUT);
+        gpio_put(_csGP, 1);
+    }
+    _offsetProgram = pio_add_program(_pio, &qspi_program);
+    qspi_program_init(_pio, _sm, _offsetProgram, _sckGP, _io0GP, static_cast<float>(freq));
+
+    setInterfaceState(InterfaceState::INTIALIZED);
+    return CmdStatus::OK;
+}
+
+CmdStatus Qspi::deInit() {
+    if(getInterfaceState() == InterfaceState::NOT_INITIALIZED) {
+        return CmdStatus::OK; // do nothing
+    }
+    if(_dmaChannel >= 0) {
+        dma_channel_set_irq0_enabled(_dmaChannel, false);
+        dma_channel_abort(_dmaChannel);
+        dma_channel_unclaim(_dmaChannel);
+        _dmaChannel = -1;
+    }
+    _dmaLen = 0;
+    _totalRemainingBytesToSend = 0;
+    endTransaction();
+    pio_sm_set_enabled(_pio, _sm, false);
+    pio_remove_program(_pio, &qspi_program, _offsetProgram);
+    pio_sm_unclaim(_pio, _sm);
+    _sm = -1;
+    releaseStreamBuffers();
+    setInterfaceState(InterfaceState::NOT_INITIALIZED);
+    return CmdStatus::OK;
+}
+
+static bool isValidLanes(uint8_t lanes) {
+    return lanes == 1 || lanes == 2 || lanes == 4;
+}
+
+CmdStatus Qspi::transaction(uint8_t const *cmd, uint8_t response[64]) {
+    const bool read = cmd[0] == Report::ID::QSPI_READ;
+    const uint8_t cmdLanes = cmd[1];
+    const uint8_t addrLanes = cmd[3];
+    const uint8_t addrBytes = cmd[4];
+    const uint32_t address = convertBytesToUInt32(&cmd[5]);
+    const uint8_t dummyCycles = cmd[9];
+    const uint8_t dataLanes = cmd[10];
+    const uint32_t nbBytes = convertBytesToUInt32(&cmd[11]);
+    if(getInterfaceState() != InterfaceState::INTIALIZED || (cmdLanes != 0 && !isValidLanes(cmdLanes)) ||
+            addrBytes > 4 || (addrBytes > 0 && !isValidLanes(addrLanes)) ||
+            (nbBytes > 0 && !isValidLanes(dataLanes)) || (read && nbBytes > getResponsePayloadSize())) {
+        return CmdStatus::NOK;
+    }
+
+    if(_csGP >= 0)
+        gpio_put(_csGP, 0);
+    if(cmdLanes != 0)
+        writePhase(cmdLanes, &cmd[2], 1);
+    if(addrBytes > 0) {
+        uint8_t addressBytes[4];
+        for(uint8_t it = 0; it < addrBytes; it++) {
+            addressBytes[it] = static_cast<uint8_t>(address >> (8 * (addrBytes - 1 - it)));
+        }
+        writePhase(addrLanes, addressBytes, addrBytes);
+    }
+    if(dummyCycles > 0) {
+        waitIdle();
+        dummyPhase(dummyCycles);
+    }
+
+    if(nbBytes == 0) {
+        waitIdle();
+        endTransaction();
+        return CmdStatus::OK;
+    }
+    waitIdle();
+    if(read) {
+        readPhase(dataLanes, &response[2], nbBytes);
+        endTransaction();
+        return CmdStatus::OK;
+    }
+
+    // Data phase of the CDC stream: one phase clocked as the DMA fills the TX FIFO, CS released by task()
+    startPhase(dataLanes, nbBytes * (8 / dataLanes), false);
+    flushStreamRx();
+    _bufferRx.setSize(0);
+    _bufferRx2.setSize(0);
+    _totalRemainingBytesToSend = nbBytes;
+    return CmdStatus::OK;
+}
+
+void Qspi::startPhase(uint8_t lanes, uint32_t nbCycles, bool in) {
+    // Outputs: the lanes of a write phase, the other IO are released (MISO, WP# and HOLD# pulled up)
+    const uint32_t ioMask = 0xFu << _io0GP;
+    const uint32_t outMask = in ? 0 : ((1u << lanes) - 1) << _io0GP;
+    pio_sm_set_pindirs_with_mask(_pio, _sm, outMask, ioMask);
+    pio_sm_set_in_pins(_pio, _sm, (in && lanes == 1) ? _io0GP + 1 : _io0GP);
+
+    // x = nbCycles - 1 through the OSR, emptied for the autopull of the data
+    pio_sm_put(_pio, _sm, nbCycles - 1);
+    pio_sm_exec_wait_blocking(_pio, _sm, pio_encode_pull(false, true));
+    pio_sm_exec(_pio, _sm, pio_encode_mov(pio_x, pio_osr));
+    pio_sm_exec(_pio, _sm, pio_encode_out(pio_null, 32));
+
+    uint loopOffset;
+    if(lanes == 1)
+        loopOffset = in ? qspi_offset_in1 : qspi_offset_out1;
+    else if(lanes == 2)
+        loopOffset = in ? qspi_offset_in2 : qspi_offset_out2;
+    else
+        loopOffset = in ? qspi_offset_in4 : qspi_offset_out4;
+    pio_sm_exec(_pio, _sm, pio_encode_jmp(_offsetProgram + loopOffset));
+}
+
+void Qspi::writePhase(uint8_t lanes, const uint8_t *src, uint32_t len) {
+    waitIdle();
+    startPhase(lanes, len * (8 / lanes), false);
+    for(uint32_t it = 0; it < len; it++) {
+        // Shifted out MSB first from bit 31
+        pio_sm_put_blocking(_pio, _sm, static_cast<uint32_t>(src[it]) << 24);
+    }
+}
+
+void Qspi::readPhase(uint8_t lanes, uint8_t *dst, uint32_t len) {
+    startPhase(lanes, len * (8 / lanes), true);
+    for(uint32_t it = 0; it < len; it++) {
+        // Pushed every 8 bits, MSB first in the low byte
+        dst[it] = static_cast<uint8_t>(pio_sm_get_blocking(_pio, _sm));
+    }
+    waitIdle();
+}
+
+void Qspi::dummyPhase(uint32_t nbCycles) {
+    startPhase(1, nbCycles, true);
+    // Sampled bits dropped: the RX FIFO is drained until the loop ends, then the partial byte of the ISR
+    const uint idle = _offsetProgram + qspi_offset_idle;
+    while(pio_sm_get_pc(_pio, _sm) != idle || !pio_sm_is_rx_fifo_empty(_pio, _sm)) {
+        if(!pio_sm_is_rx_fifo_empty(_pio, _sm))
+            (void)pio_sm_get(_pio, _sm);
+    }
+    pio_sm_exec(_pio, _sm, pio_encode_mov(pio_isr, pio_null));
+}
+
+void Qspi::waitIdle() {
+    const uint idle = _offsetProgram + qspi_offset_idle;
+    while(!pio_sm_is_tx_fifo_empty(_pio, _sm) || pio_sm_get_pc(_pio, _sm) != idle)
+        tight_loop_contents();
+}
+
+void Qspi::endTransaction() {
+    if(_csGP >= 0)
+        gpio_put(_csGP, 1);
+    // IO released between transactions
+    pio_sm_set_pindirs_with_mask(_pio, _sm, 0, 0xFu << _io0GP);
+}
+
+void Qspi::startDmaWrite(const uint8_t *src, uint32_t len) {
+    // 8-bit writes to the TX FIFO are replicated on the 4 byte lanes: the byte is in bits 24-31 for the autopull
+    dma_channel_config dmaConfig = dma_channel_get_default_config(_dmaChannel);
+    channel_config_set_transfer_data_size(&dmaConfig, DMA_SIZE_8);
+    channel_config_set_read_increment(&dmaConfig, true);
+    channel_config_set_write_increment(&dmaConfig, false);
+    channel_config_set_dreq(&dmaConfig, pio_get_dreq(_pio, _sm, true));
+    _dmaLen = len;
+    Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(len));
+    dma_channel_configure(_dmaChannel, &dmaConfig, &_pio->txf[_sm], src, len, true);
+}
@@ -0,0 +1,46 @@
+#ifndef _INTERFACE_QSPI_H
+#define _INTERFACE_QSPI_H
+
+#include "PicoInterfacesBoard.h"
+#include "StreamedInterface.h"
+#include "hardware/pio.h"
+
+// Quad-SPI master on a PIO state machine (qspi.pio): command, address, dummy and data phases of 1, 2 or 4 lanes.
+// The data of QSPI_WRITE come from CDC and are clocked out by a DMA channel from two buffers, like the SPI streams.
+class Qspi : public StreamedInterface {
+public:
+    Qspi(uint streamBufferSize);
+    virtual ~Qspi();
+
+    CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
+    CmdStatus task(uint8_t response[64]);
+
+protected:
+    CmdStatus init(uint8_t const *cmd);
+    CmdStatus deInit();
+    CmdStatus transaction(uint8_t const *cmd, uint8_t response[64]);
+    // Loads the number of SCK cycles and jumps to the loop of the phase, the state machine must be idle
+    void startPhase(uint8_t lanes, uint32_t nbCycles, bool in);
+    void writePhase(uint8_t lanes, const uint8_t *src, uint32_t len);
+    void readPhase(uint8_t lanes, uint8_t *dst, uint32_t len);
+    // SCK cycles with the IO released, before the data of a fast read
+    void dummyPhase(uint32_t nbCycles);
+    // Waits for the last bits of the write phase
+    void waitIdle();
+    void endTransaction();
+    void startDmaWrite(const uint8_t *src, uint32_t len);
+    static void dmaHandler();
+
+    PIO _pio;
+    int _sm; // -1 when not initialized
+    uint _offsetProgram;
+    uint _sckGP;
+    uint _io0GP;
+    int _csGP; // -1: none
+    int _dmaChannel;
+    uint32_t _dmaLen; // bytes in flight, 0 when the DMA channel is idle
+
+    static Qspi *_sQspi;
+};
+
+#endif
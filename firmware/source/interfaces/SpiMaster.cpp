@@ -1,14 +1,184 @@
 #include "SpiMaster.h"
 #include "string.h"
 
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "tusb.h"
+#include "../Stats.h"
+#include "../Trace.h"
+
+SPIMaster *SPIMaster::_sSpis[2] = {nullptr, nullptr};
+
+// LSB first devices: the SPI only shifts MSB first, their bytes are mirrored
+static void reverseBits(uint8_t *data, uint32_t len) {
+    static const uint8_t reversedNibbles[16] = {0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
+    for(uint32_t it = 0; it < len; it++) {
+        data[it] = static_cast<uint8_t>((reversedNibbles[data[it] & 0x0F] << 4) | reversedNibbles[data[it] >> 4]);
+    }
+}
+
+
+SpiJob::SpiJob(BaseInterface *owner)
+    : WorkerJob(owner), _spi(nullptr), _ops(), _nbOps(0) {
+}
+
+void SpiJob::setup(spi_inst_t *spi) {
+    _spi = spi;
+}
+
+void SpiJob::clear() {
+    _nbOps = 0;
+}
+
+SpiJob::Op &SpiJob::addOp(OP_TYPE type) {
+    // Sized for the longest command (memory program: write enable then page), the last one is overwritten beyond
+    if(_nbOps < MAX_OPS)
+        _nbOps++;
+    Op &op = _ops[_nbOps - 1];
+    op = Op();
+    op.type = type;
+    return op;
+}
+
+void SpiJob::addGpio(uint gp, bool value) {
+    Op &op = addOp(OP_GPIO);
+    op.gp = gp;
+    op.value = value;
+}
+
+void SpiJob::addFormat(uint dataBits, spi_cpol_t cpol, spi_cpha_t cpha) {
+    Op &op = addOp(OP_FORMAT);
+    op.len = dataBits;
+    op.cpol = cpol;
+    op.cpha = cpha;
+}
+
+void SpiJob::addWrite(const uint8_t *src, uint32_t len) {
+    Op &op = addOp(OP_WRITE);
+    op.src = src;
+    op.len = len;
+}
+
+void SpiJob::addRead(uint8_t *dst, uint32_t len) {
+    Op &op = addOp(OP_READ);
+    op.dst = dst;
+    op.len = len;
+}
+
+void SpiJob::addTransfer(const uint8_t *src, uint8_t *dst, uint32_t len, bool frame16) {
+    Op &op = addOp(frame16 ? OP_TRANSFER16 : OP_TRANSFER);
+    op.src = src;
+    op.dst = dst;
+    op.len = len;
+}
+
+void SpiJob::addDisplayList(const uint8_t *list, uint32_t len, int dcGP) {
+    Op &op = addOp(OP_DISPLAY_LIST);
+    op.src = list;
+    op.len = len;
+    op.gp = dcGP;
+}
+
+bool SpiJob::run() {
+    for(uint it = 0; it < _nbOps; it++) {
+        const Op &op = _ops[it];
+        switch(op.type) {
+        case OP_GPIO:
+            gpio_put(op.gp, op.value);
+            break;
+        case OP_FORMAT:
+            spi_set_format(_spi, op.len, op.cpol, op.cpha, SPI_MSB_FIRST);
+            break;
+        case OP_WRITE:
+            spi_write_blocking(_spi, op.src, op.len);
+            break;
+        case OP_READ:
+            spi_read_blocking(_spi, 0, op.dst, op.len);
+            break;
+        case OP_TRANSFER:
+            spi_write_read_blocking(_spi, op.src, op.dst, op.len);
+            break;
+        case OP_TRANSFER16:
+            spi_write16_read16_blocking(_spi, reinterpret_cast<const uint16_t *>(op.src),
+                                        reinterpret_cast<uint16_t *>(op.dst), op.len / 2);
+            break;
+        case OP_DISPLAY_LIST: {
+            // spi_write_blocking() returns when the bus is idle: DC is changed between the bytes
+            const uint8_t *entry = op.src;
+            const uint8_t *listEnd = op.src + op.len;
+            while(entry < listEnd) {
+                const uint8_t nb = *entry & 0x7F;
+                if(op.gp >= 0)
+                    gpio_put(op.gp, (*entry & 0x80) != 0);
+                spi_write_blocking(_spi, entry + 1, nb);
+                entry += 1 + nb;
+            }
+            break;
+        }
+        }
+    }
+    return true;
+}
+
 
 SPIMaster::SPIMaster(uint8_t spiIndex, uint streamBufferSize = 512)
-    : StreamedInterface(streamBufferSize),
+    : MemoryProgrammer(streamBufferSize, true), // next CDC chunk received while the DMA clocks out the previous one
       _spiInst(spiIndex == 0 ? spi0 : spi1),
       _clkGP(spiIndex == 0 ? U2IF_SPI0_CK : U2IF_SPI1_CK),
       _mosiGP(spiIndex == 0 ? U2IF_SPI0_MOSI : U2IF_SPI1_MOSI),
-      _misoGP(spiIndex == 0 ? U2IF_SPI0_MISO : U2IF_SPI1_MISO){
+      _misoGP(spiIndex == 0 ? U2IF_SPI0_MISO : U2IF_SPI1_MISO),
+      _dmaChannel(-1),
+      _dmaRxChannel(-1),
+      _dmaLen(0),
+      _streamReportId(0),
+      _job(this),
+      _jobReportId(0),
+      _devices(),
+      _currentDevice(NO_DEVICE),
+      _csDevice(NO_DEVICE),
+      _deviceTx(),
+      _deviceRx(),
+      _deviceNbBytes(0),
+      _deviceKeepCs(false),
+      _csGP(-1),
+      _dcGP(-1),
+      _frame16(false),
+      _displayList(),
+      _memCsGP(0),
+      _memOpWriteEnable(0),
+      _memOpProgram(0),
+      _memOpReadStatus(0),
+      _memBusyMask(0),
+      _memOpRead(0),
+      _memOpErase(0),
+      _memJobHeader(),
+      _memJobStatus(0),
+      _memJobRunning(false),
+      _transferStream(false),
+      _transferFill(false),
+      _fillByte(0),
+      _transferBytesToStart(0),
+      _transferStates{TRANSFER_FREE, TRANSFER_FREE},
+      _transferLens{0, 0},
+      _drainOffset(0),
+      _drainIndex(0) {
+    _sSpis[getInstIndex()] = this;
+    _job.setup(_spiInst);
 
+    const uint offset = getInstIndex() * Report::ID::SPI0_SPI1_OFFSET;
+    registerReports({
+        Report::ID::SPI0_INIT + offset,
+        Report::ID::SPI0_DEINIT + offset,
+        Report::ID::SPI0_WRITE + offset,
+        Report::ID::SPI0_READ + offset,
+        Report::ID::SPI0_WRITE_FROM_UART + offset,
+        Report::ID::SPI0_TRANSFER_STREAM + offset,
+        Report::ID::SPI0_DISPLAY_PINS + offset,
+        Report::ID::SPI0_DISPLAY_WRITE + offset,
+        Report::ID::SPI0_MEM_PROGRAM + offset,
+        Report::ID::SPI0_DEVICE_CONFIG + offset,
+        Report::ID::SPI0_DEVICE_TRANSFER + offset
+    });
 }
 
 SPIMaster::~SPIMaster() {
@@ -20,10 +190,29 @@ uint8_t SPIMaster::getInstIndex() {
     return _spiInst == spi1 ? 1 : 0;
 }
 
+void SPIMaster::dmaHandler() {
+    for(SPIMaster *spi : _sSpis) {
+        if(spi == nullptr || spi->_dmaChannel < 0)
+            continue;
+        const uint32_t mask = dma_hw->ints0 & ((1u << spi->_dmaChannel) | (1u << spi->_dmaRxChannel));
+        if(mask == 0)
+            continue;
+        dma_hw->ints0 = mask;
+        Trace::record(TRACE_EVENT::TRACE_DMA_END, spi->getInterfaceIndex());
+        spi->setPending(); // task() sends the next chunk
+    }
+}
+
 CmdStatus SPIMaster::process(uint8_t const *cmd, uint8_t response[64]) {
     CmdStatus status = CmdStatus::NOT_CONCERNED;
     const uint spiIndex = getInstIndex();
 
+    const uint8_t offset = spiIndex * Report::ID::SPI0_SPI1_OFFSET;
+    const bool busCmd = cmd[0] != Report::ID::SPI0_DEINIT + offset;
+    if(busCmd && (_dmaLen > 0 || _totalRemainingBytesToSend > 0 || isMemRunning() || _job.isBusy() || _jobReportId != 0)) {
+        return CmdStatus::NOK; // bus used by the stream or the memory programming, CS asserted
+    }
+
     if(cmd[0] == (Report::ID::SPI0_INIT + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
         status = init(cmd);
     } else if(cmd[0] == (Report::ID::SPI0_DEINIT + spiIndex * Report::ID::SPI0_SPI1_OFFSET) ) {
@@ -34,46 +223,222 @@ CmdStatus SPIMaster::process(uint8_t const *cmd, uint8_t response[64]) {
         status = read(cmd, response);
     } else if(cmd[0] == (Report::ID::SPI0_WRITE_FROM_UART + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
         status = writeFromUart(cmd);
+    } else if(cmd[0] == (Report::ID::SPI0_TRANSFER_STREAM + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
+        status = transferStream(cmd);
+    } else if(cmd[0] == (Report::ID::SPI0_DISPLAY_PINS + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
+        status = displayPins(cmd);
+    } else if(cmd[0] == (Report::ID::SPI0_DISPLAY_WRITE + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
+        status = displayWrite(cmd);
+    } else if(cmd[0] == (Report::ID::SPI0_MEM_PROGRAM + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
+        status = memProgramStart(cmd);
+    } else if(cmd[0] == (Report::ID::SPI0_DEVICE_CONFIG + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
+        status = deviceConfig(cmd);
+    } else if(cmd[0] == (Report::ID::SPI0_DEVICE_TRANSFER + spiIndex * Report::ID::SPI0_SPI1_OFFSET)) {
+        status = deviceTransfer(cmd);
     }
 
     return status;
 }
 
 CmdStatus SPIMaster::task(uint8_t response[64]) {
+    if(_job.isBusy())
+        return CmdStatus::NOT_CONCERNED; // setPending() by core1 at the end of the job
+    if(_jobReportId != 0)
+        return jobEnd(response);
+    if(isMemRunning())
+        return memTask(response);
     if(_totalRemainingBytesToSend == 0)
         return CmdStatus::NOT_CONCERNED;
 
-    bool error = false;
-    StreamBuffer &buf =  getBuffer();
-    while(_totalRemainingBytesToSend > 0 && streamRxAvailableSize() && !error){
-        streamRxRead();
-        uint nbBytes = std::min(_totalRemainingBytesToSend, buf.size());
-        int nbWritten = spi_write_blocking (_spiInst, buf.getDataPtr8(), nbBytes);
-        if(nbWritten != static_cast<int>(nbBytes)) {
-            error = true;
+    if(_transferStream)
+        return transferStreamTask(response);
+
+    if(_dmaLen > 0 && !dma_channel_is_busy(_dmaChannel)) {
+        _totalRemainingBytesToSend -= _dmaLen;
+        _dmaLen = 0;
+    }
+
+    // Receive buffer: filled from CDC while the other one is clocked out
+    StreamBuffer &buf = getBuffer();
+    const uint32_t nbBytesToReceive = _totalRemainingBytesToSend - _dmaLen - buf.size();
+    if(nbBytesToReceive > 0 && buf.size() < buf.getAllocateSize()) {
+        const uint32_t offset = buf.size();
+        streamRxRead(nbBytesToReceive);
+        if(isLsbFirst())
+            reverseBits(buf.getDataPtr8() + offset, buf.size() - offset);
+    }
+
+    // 16-bit frames: an odd last byte waits for the next one in the other buffer
+    const uint32_t len = _frame16 ? buf.size() & ~1u : buf.size();
+    if(_dmaLen == 0 && len > 0) {
+        startDmaWrite(buf.getDataPtr8(), len);
+        switchBuffer();
+        StreamBuffer &nextBuf = getBuffer();
+        nextBuf.setSize(0); // clocked out by the previous transfer
+        if(buf.size() > len) {
+            nextBuf.getDataPtr8()[0] = buf.getDataPtr8()[len];
+            nextBuf.setSize(1);
+        }
+    }
+
+    if(_totalRemainingBytesToSend == 0) {
+        endDmaWrite();
+        if(_streamReportId == Report::ID::SPI0_DISPLAY_WRITE + getInstIndex() * Report::ID::SPI0_SPI1_OFFSET) {
+            endDisplayWrite();
         } else {
-            _totalRemainingBytesToSend -= static_cast<uint>(nbWritten);
+            _frame16 = false;
+            releaseDeviceCs();
+        }
+        response[0] = _streamReportId;
+        return CmdStatus::OK;
+    }
+
+    const StreamBuffer &nextBuf = getBuffer();
+    if(_dmaLen > 0 && (nextBuf.size() == nextBuf.getAllocateSize() || _totalRemainingBytesToSend == _dmaLen + nextBuf.size()))
+        return CmdStatus::NOT_CONCERNED; // woken by dmaHandler
+    return CmdStatus::NOT_FINISHED;
+}
+
+void SPIMaster::startDmaWrite(const uint8_t *src, uint32_t len) {
+    dma_channel_config dmaConfig = dma_channel_get_default_config(_dmaChannel);
+    channel_config_set_transfer_data_size(&dmaConfig, _frame16 ? DMA_SIZE_16 : DMA_SIZE_8);
+    channel_config_set_read_increment(&dmaConfig, true);
+    channel_config_set_write_increment(&dmaConfig, false);
+    channel_config_set_dreq(&dmaConfig, spi_get_dreq(_spiInst, true));
+    _dmaLen = len;
+    Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(len));
+    dma_channel_configure(_dmaChannel, &dmaConfig, &spi_get_hw(_spiInst)->dr, src, _frame16 ? len / 2 : len, true);
+}
+
+CmdStatus SPIMaster::transferStreamTask(uint8_t response[64]) {
+    const int dmaIndex = _transferStates[0] == TRANSFER_IN_FLIGHT ? 0 : 1;
+    if(_dmaLen > 0 && !dma_channel_is_busy(_dmaRxChannel)) {
+        _transferStates[dmaIndex] = TRANSFER_DRAINING;
+        _dmaLen = 0;
+        if(isLsbFirst())
+            reverseBits((dmaIndex == 0 ? _bufferRx : _bufferRx2).getDataPtr8(), _transferLens[dmaIndex]);
+    }
+
+    drainTransferRx();
+    const bool draining = _transferStates[0] == TRANSFER_DRAINING || _transferStates[1] == TRANSFER_DRAINING;
+
+    // Next chunk: TX bytes received from CDC while the previous chunk is clocked
+    const int nextIndex = _drainIndex ^ (_transferStates[_drainIndex] == TRANSFER_FREE ? 0 : 1);
+    if(_transferBytesToStart > 0 && _transferStates[nextIndex] == TRANSFER_FREE) {
+        _currentBufferIndex = nextIndex;
+        StreamBuffer &buf = getBuffer();
+        uint32_t len = std::min(_transferBytesToStart, buf.getAllocateSize());
+        if(!_transferFill) {
+            // While draining, task() polls CDC IN: only read what is there, without waiting for CDC OUT
+            const uint32_t offset = buf.size();
+            if(buf.size() < len && (!draining || tud_cdc_available() > 0))
+                streamRxRead(len - buf.size());
+            len = buf.size();
+            if(isLsbFirst())
+                reverseBits(buf.getDataPtr8() + offset, len - offset);
+        }
+        if(_dmaLen == 0 && len > 0) {
+            _transferStates[nextIndex] = TRANSFER_IN_FLIGHT;
+            _transferLens[nextIndex] = len;
+            _transferBytesToStart -= len;
+            startDmaTransfer(buf.getDataPtr8(), len);
+            buf.setSize(0);
         }
-        buf.setSize(0);
-        //printf("->Total = %d\n", _totalRemainingBytesToSend);
+    }
 
-        break; // break ou pas ? est ce qu'on essaye de tout envoyer sans redonner la main a l'event loop ou on fait le contraire ?
+    if(_totalRemainingBytesToSend == 0) {
+        _transferStream = false;
+        releaseDeviceCs();
+        response[0] = Report::ID::SPI0_TRANSFER_STREAM + (getInstIndex() * Report::ID::SPI0_SPI1_OFFSET);
+        return CmdStatus::OK;
     }
 
-    if(error || _totalRemainingBytesToSend == 0) {
-        _totalRemainingBytesToSend = 0;
-        //printf("->END = %d\n", _totalRemainingBytesToSend);
-        response[0] = Report::ID::SPI0_WRITE_FROM_UART + (getInstIndex() * 0x10);
-        return error ? CmdStatus::NOK : CmdStatus::OK;
+    if(draining) {
+        cancelWaitCdcRx(); // CDC IN full, polled
+        return CmdStatus::NOT_FINISHED;
     }
+    if(_dmaLen > 0)
+        return CmdStatus::NOT_CONCERNED; // woken by dmaHandler (or CDC data if waiting for it)
     return CmdStatus::NOT_FINISHED;
 }
 
+void SPIMaster::drainTransferRx() {
+    while(_transferStates[_drainIndex] == TRANSFER_DRAINING) {
+        StreamBuffer &buf = _drainIndex == 0 ? _bufferRx : _bufferRx2;
+        const uint32_t len = _transferLens[_drainIndex];
+        const uint32_t nbWritten = tud_cdc_write(buf.getDataPtr8() + _drainOffset,
+                                                 std::min(len - _drainOffset, tud_cdc_write_available()));
+        tud_cdc_write_flush();
+        Stats::addCdcBytes(getInterfaceIndex(), nbWritten);
+        _drainOffset += nbWritten;
+        if(_drainOffset < len)
+            return; // CDC IN full
+        _drainOffset = 0;
+        _totalRemainingBytesToSend -= len;
+        _transferStates[_drainIndex] = TRANSFER_FREE;
+        _drainIndex ^= 1;
+    }
+}
+
+void SPIMaster::startDmaTransfer(uint8_t *buf, uint32_t len) {
+    dma_channel_config rxConfig = dma_channel_get_default_config(_dmaRxChannel);
+    channel_config_set_transfer_data_size(&rxConfig, DMA_SIZE_8);
+    channel_config_set_read_increment(&rxConfig, false);
+    channel_config_set_write_increment(&rxConfig, true);
+    channel_config_set_dreq(&rxConfig, spi_get_dreq(_spiInst, false));
+    dma_channel_config txConfig = dma_channel_get_default_config(_dmaChannel);
+    channel_config_set_transfer_data_size(&txConfig, DMA_SIZE_8);
+    channel_config_set_read_increment(&txConfig, !_transferFill);
+    channel_config_set_write_increment(&txConfig, false);
+    channel_config_set_dreq(&txConfig, spi_get_dreq(_spiInst, true));
+
+    _dmaLen = len;
+    Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(len));
+    // RX first: ready before the first byte is clocked
+    dma_channel_configure(_dmaRxChannel, &rxConfig, buf, &spi_get_hw(_spiInst)->dr, len, true);
+    dma_channel_configure(_dmaChannel, &txConfig, &spi_get_hw(_spiInst)->dr, _transferFill ? &_fillByte : buf, len, true);
+}
+
+void SPIMaster::endDmaWrite() {
+    while(spi_is_busy(_spiInst))
+        tight_loop_contents();
+    while(spi_is_readable(_spiInst))
+        (void)spi_get_hw(_spiInst)->dr;
+    spi_get_hw(_spiInst)->icr = SPI_SSPICR_RORIC_BITS;
+}
+
 CmdStatus SPIMaster::init(uint8_t const *cmd) {
-    uint32_t mode = cmd[1];
-    uint32_t baudrate = convertBytesToUInt32(&cmd[2]);
+    if(!acquireStreamBuffers()) {
+        return CmdStatus::NOK; // memory arena exhausted
+    }
+    const uint8_t mode = cmd[1];
+    const uint32_t baudrate = convertBytesToUInt32(&cmd[2]);
 
-    spi_init(_spiInst, baudrate);
+    if(_dmaChannel < 0) {
+        _dmaChannel = dma_claim_unused_channel(true);
+        _dmaRxChannel = dma_claim_unused_channel(true);
+        dma_channel_set_irq0_enabled(_dmaChannel, true);
+        dma_channel_set_irq0_enabled(_dmaRxChannel, true);
+        static bool dmaHandlerAdded = false;
+        if(!dmaHandlerAdded) {
+            // Shared with the other DMA_IRQ_0 users (WS2812B)
+            irq_add_shared_handler(DMA_IRQ_0, dmaHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irq_set_enabled(DMA_IRQ_0, true);
+            dmaHandlerAdded = true;
+        }
+    }
+
+    releaseDeviceCs();
+    SpiDevice &bus = _devices[0];
+    bus.baudrate = spi_init(_spiInst, baudrate);
+    bus.csGP = -1;
+    bus.csActiveHigh = false;
+    bus.lsbFirst = false;
+    bus.dataBits = 8;
+    bus.cpol = (mode & 0x02) ? SPI_CPOL_1 : SPI_CPOL_0;
+    bus.cpha = (mode & 0x01) ? SPI_CPHA_1 : SPI_CPHA_0;
+    _currentDevice = NO_DEVICE;
+    selectDevice(0);
     gpio_set_function(_clkGP, GPIO_FUNC_SPI);
     gpio_set_function(_mosiGP, GPIO_FUNC_SPI);
     gpio_set_function(_misoGP, GPIO_FUNC_SPI);
@@ -82,8 +447,47 @@ CmdStatus SPIMaster::init(uint8_t const *cmd) {
     return CmdStatus::OK;
 }
 
+void SPIMaster::abort(uint8_t reportId) {
+    // Deadline reached: the transfers of the job end, their response is dropped
+    if(reportId != 0 && reportId == _jobReportId) {
+        uint8_t response[HID_RESPONSE_SIZE];
+        waitJob();
+        jobEnd(response);
+    }
+}
+
+void SPIMaster::waitJob() {
+    _job.requestStop(); // not started if still queued
+    while(_job.isBusy()) {
+        tight_loop_contents();
+    }
+}
+
 CmdStatus SPIMaster::deInit() {
+    waitJob(); // answered NOK by task() if it belongs to a command
+    _memJobRunning = false;
+    if(_dmaChannel >= 0) {
+        dma_channel_set_irq0_enabled(_dmaChannel, false);
+        dma_channel_abort(_dmaChannel);
+        dma_channel_unclaim(_dmaChannel);
+        dma_channel_set_irq0_enabled(_dmaRxChannel, false);
+        dma_channel_abort(_dmaRxChannel);
+        dma_channel_unclaim(_dmaRxChannel);
+        _dmaChannel = -1;
+        _dmaRxChannel = -1;
+    }
+    _dmaLen = 0;
+    _totalRemainingBytesToSend = 0;
+    _transferStream = false;
+    _frame16 = false;
+    memAbort();
+    releaseDeviceCs();
+    for(SpiDevice &device : _devices) {
+        device.baudrate = 0;
+    }
+    _currentDevice = NO_DEVICE;
     spi_deinit(_spiInst);
+    releaseStreamBuffers();
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     return CmdStatus::OK;
 }
@@ -91,6 +495,8 @@ CmdStatus SPIMaster::deInit() {
 
 
 CmdStatus SPIMaster::write(const uint8_t *cmd){
+    if(!selectDevice(0))
+        return CmdStatus::NOK;
     const uint nbytes = cmd[1];
     int nbWritten = spi_write_blocking (_spiInst, cmd + 2, nbytes);
     if(nbWritten ==  PICO_ERROR_GENERIC || nbWritten != static_cast<int>(nbytes))
@@ -101,6 +507,8 @@ CmdStatus SPIMaster::write(const uint8_t *cmd){
 CmdStatus SPIMaster::read(const uint8_t *cmd, uint8_t *ret){
     const uint8_t writeByte = cmd[1];
     const uint nbytes = cmd[2];
+    if(nbytes > getResponsePayloadSize() || !selectDevice(0))
+        return CmdStatus::NOK;
     int nbRead = spi_read_blocking (_spiInst, writeByte, ret + 2, nbytes);
     if(nbRead ==  PICO_ERROR_GENERIC || nbRead != nbytes)
         return CmdStatus::NOK;
@@ -108,9 +516,325 @@ CmdStatus SPIMaster::read(const uint8_t *cmd, uint8_t *ret){
 }
 
 CmdStatus SPIMaster::writeFromUart(const uint8_t *cmd){
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::NOK;
+    }
+    const uint32_t nbBytes = convertBytesToUInt32(&cmd[1]);
+    if(!selectDevice(cmd[5]) || (_devices[cmd[5]].dataBits > 8 && (nbBytes & 1)))
+        return CmdStatus::NOK;
     flushStreamRx();
-    _totalRemainingBytesToSend = convertBytesToUInt32(&cmd[1]);
+    memAbort();
+    assertDeviceCs(); // released by task() after the last byte
+    _frame16 = _devices[cmd[5]].dataBits > 8;
+    _totalRemainingBytesToSend = nbBytes;
+    _transferStream = false;
+    _streamReportId = Report::ID::SPI0_WRITE_FROM_UART + getInstIndex() * Report::ID::SPI0_SPI1_OFFSET;
     //printf("Total = %d", _totalRemainingBytesToSend);
     return CmdStatus::OK;
 }
 
+CmdStatus SPIMaster::transferStream(const uint8_t *cmd){
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::NOK;
+    }
+    if(!selectDevice(cmd[7]) || _devices[cmd[7]].dataBits > 8)
+        return CmdStatus::NOK;
+    flushStreamRx();
+    endDmaWrite(); // RX FIFO must only hold the bytes of this transfer
+    memAbort();
+    assertDeviceCs(); // released by task() after the last RX byte
+    _totalRemainingBytesToSend = convertBytesToUInt32(&cmd[1]);
+    _transferBytesToStart = _totalRemainingBytesToSend;
+    _transferFill = cmd[5] != 0;
+    _fillByte = cmd[6];
+    if(isLsbFirst())
+        reverseBits(&_fillByte, 1);
+    _transferStates[0] = _transferStates[1] = TRANSFER_FREE;
+    _bufferRx.setSize(0);
+    _bufferRx2.setSize(0);
+    _drainOffset = 0;
+    _drainIndex = 0;
+    _transferStream = true;
+    return CmdStatus::OK;
+}
+
+CmdStatus SPIMaster::displayPins(const uint8_t *cmd){
+    _csGP = cmd[1] < NUM_BANK0_GPIOS ? cmd[1] : -1;
+    _dcGP = cmd[2] < NUM_BANK0_GPIOS ? cmd[2] : -1;
+    if(_csGP >= 0) {
+        gpio_init(_csGP);
+        gpio_set_dir(_csGP, GPIO_OUT);
+        gpio_put(_csGP, 1);
+    }
+    if(_dcGP >= 0) {
+        gpio_init(_dcGP);
+        gpio_set_dir(_dcGP, GPIO_OUT);
+    }
+    return CmdStatus::OK;
+}
+
+CmdStatus SPIMaster::displayWrite(const uint8_t *cmd){
+    if(getInterfaceState() != InterfaceState::INTIALIZED) {
+        return CmdStatus::NOK;
+    }
+    const uint32_t nbBytes = convertBytesToUInt32(&cmd[2]);
+    const bool frame16 = (cmd[1] & 0x01) != 0;
+    const uint8_t *entry = &cmd[7];
+    const uint8_t *listEnd = entry + cmd[6];
+    if(listEnd > cmd + 64 || (frame16 && (nbBytes & 1)) || !selectDevice(0))
+        return CmdStatus::NOK;
+    while(entry < listEnd) {
+        entry += 1 + (*entry & 0x7F);
+    }
+    if(entry != listEnd)
+        return CmdStatus::NOK;
+
+    // Command list sent by core1, then DC high and the data format for the CDC stream
+    memcpy(_displayList, &cmd[7], cmd[6]);
+    _job.clear();
+    if(_csGP >= 0)
+        _job.addGpio(_csGP, 0);
+    _job.addDisplayList(_displayList, cmd[6], _dcGP);
+    if(nbBytes > 0 && _dcGP >= 0)
+        _job.addGpio(_dcGP, 1);
+    if(nbBytes > 0 && frame16)
+        _job.addFormat(16, _devices[0].cpol, _devices[0].cpha); // device 0 restored at the end
+    if(!Core1Worker::submit(&_job))
+        return CmdStatus::NOK;
+    _frame16 = frame16 && nbBytes > 0;
+
+    if(nbBytes == 0) {
+        _jobReportId = cmd[0]; // answered at the end of the list
+        return CmdStatus::NOT_FINISHED;
+    }
+    // Data of the CDC stream clocked out after the list, CS released by task() after the last byte
+    flushStreamRx();
+    memAbort();
+    _totalRemainingBytesToSend = nbBytes;
+    _transferStream = false;
+    _streamReportId = Report::ID::SPI0_DISPLAY_WRITE + getInstIndex() * Report::ID::SPI0_SPI1_OFFSET;
+    return CmdStatus::OK;
+}
+
+void SPIMaster::endDisplayWrite() {
+    if(_frame16) {
+        _frame16 = false;
+        _currentDevice = NO_DEVICE;
+        selectDevice(0);
+    }
+    if(_csGP >= 0)
+        gpio_put(_csGP, 1);
+}
+
+CmdStatus SPIMaster::memProgramStart(const uint8_t *cmd){
+    if(getInterfaceState() != InterfaceState::INTIALIZED || cmd[15] >= NUM_BANK0_GPIOS || !selectDevice(0)) {
+        return CmdStatus::NOK;
+    }
+    const uint32_t eraseSize = cmd[21] != 0 ? convertBytesToUInt32(&cmd[22]) : 0;
+    if(!memStart(cmd, 1 + cmd[11], eraseSize))
+        return CmdStatus::NOK;
+    _memJobRunning = false;
+    _memCsGP = cmd[15];
+    _memOpWriteEnable = cmd[16];
+    _memOpProgram = cmd[17];
+    _memOpReadStatus = cmd[18];
+    _memBusyMask = cmd[19];
+    _memOpRead = cmd[20];
+    _memOpErase = cmd[21];
+    gpio_init(_memCsGP);
+    gpio_set_dir(_memCsGP, GPIO_OUT);
+    gpio_put(_memCsGP, 1);
+    return CmdStatus::OK;
+}
+
+uint32_t SPIMaster::memHeader(uint8_t *dst, uint8_t opcode, uint32_t address) {
+    const uint8_t width = getMemAddressWidth();
+    dst[0] = opcode;
+    for(uint8_t it = 0; it < width; it++) {
+        dst[1 + it] = static_cast<uint8_t>(address >> (8 * (width - 1 - it)));
+    }
+    return 1 + width;
+}
+
+void SPIMaster::memAddCommand(const uint8_t *src, uint32_t srcLen, uint8_t *dst, uint32_t len) {
+    _job.addGpio(_memCsGP, 0);
+    _job.addWrite(src, srcLen);
+    if(dst != nullptr)
+        _job.addRead(dst, len);
+    _job.addGpio(_memCsGP, 1);
+}
+
+MemoryProgrammer::MEM_STEP SPIMaster::memSubmitJob() {
+    if(!Core1Worker::submit(&_job))
+        return MEM_STEP_ERROR;
+    _memJobRunning = true;
+    return MEM_STEP_WAIT; // task() called again at the end of the job
+}
+
+MemoryProgrammer::MEM_STEP SPIMaster::memErase(uint32_t address) {
+    if(_memJobRunning) {
+        _memJobRunning = false;
+        return MEM_STEP_DONE;
+    }
+    if(!selectDevice(0)) // baudrate and format of the memory, whatever ran between two steps
+        return MEM_STEP_ERROR;
+    const uint32_t headerSize = memHeader(_memJobHeader, _memOpErase, address);
+    _job.clear();
+    memAddCommand(&_memOpWriteEnable, 1);
+    memAddCommand(_memJobHeader, headerSize);
+    return memSubmitJob();
+}
+
+MemoryProgrammer::MEM_STEP SPIMaster::memProgram(uint32_t address, uint8_t *page, uint32_t pageLen) {
+    if(_memJobRunning) {
+        _memJobRunning = false;
+        return MEM_STEP_DONE;
+    }
+    if(!selectDevice(0))
+        return MEM_STEP_ERROR;
+    // Opcode and address written in the free bytes before the page: one transfer
+    uint8_t *frame = page - _memHeaderSize;
+    memHeader(frame, _memOpProgram, address);
+    _job.clear();
+    memAddCommand(&_memOpWriteEnable, 1);
+    memAddCommand(frame, _memHeaderSize + pageLen);
+    return memSubmitJob();
+}
+
+MemoryProgrammer::MEM_STEP SPIMaster::memPollReady() {
+    if(_memJobRunning) {
+        _memJobRunning = false;
+        return (_memJobStatus & _memBusyMask) != 0 ? MEM_STEP_POLL : MEM_STEP_DONE;
+    }
+    if(!selectDevice(0))
+        return MEM_STEP_ERROR;
+    _memJobStatus = 0;
+    _job.clear();
+    memAddCommand(&_memOpReadStatus, 1, &_memJobStatus, 1);
+    return memSubmitJob();
+}
+
+MemoryProgrammer::MEM_STEP SPIMaster::memReadBack(uint32_t address, uint8_t *dst, uint32_t len) {
+    if(_memJobRunning) {
+        _memJobRunning = false;
+        return MEM_STEP_DONE;
+    }
+    if(!selectDevice(0))
+        return MEM_STEP_ERROR;
+    const uint32_t headerSize = memHeader(_memJobHeader, _memOpRead, address);
+    _job.clear();
+    memAddCommand(_memJobHeader, headerSize, dst, len);
+    return memSubmitJob();
+}
+
+CmdStatus SPIMaster::deviceConfig(const uint8_t *cmd){
+    const uint8_t index = cmd[1];
+    const bool lsbFirst = (cmd[3] & 0x02) != 0;
+    const uint dataBits = cmd[5];
+    const uint32_t baudrate = convertBytesToUInt32(&cmd[6]);
+    if(getInterfaceState() != InterfaceState::INTIALIZED || index == 0 || index >= NB_DEVICES || baudrate == 0 ||
+            dataBits < 4 || dataBits > 16 || (lsbFirst && dataBits > 8))
+        return CmdStatus::NOK;
+
+    if(_csDevice == index)
+        releaseDeviceCs();
+    SpiDevice &device = _devices[index];
+    device.baudrate = baudrate;
+    device.csGP = cmd[2] < NUM_BANK0_GPIOS ? cmd[2] : -1;
+    device.csActiveHigh = (cmd[3] & 0x01) != 0;
+    device.lsbFirst = lsbFirst;
+    device.dataBits = dataBits;
+    device.cpol = (cmd[4] & 0x02) ? SPI_CPOL_1 : SPI_CPOL_0;
+    device.cpha = (cmd[4] & 0x01) ? SPI_CPHA_1 : SPI_CPHA_0;
+    if(device.csGP >= 0) {
+        gpio_init(device.csGP);
+        gpio_set_dir(device.csGP, GPIO_OUT);
+        gpio_put(device.csGP, !device.csActiveHigh);
+    }
+    if(_currentDevice == index)
+        _currentDevice = NO_DEVICE; // applied on next access
+    return CmdStatus::OK;
+}
+
+CmdStatus SPIMaster::deviceTransfer(const uint8_t *cmd){
+    const uint8_t index = cmd[1];
+    const uint8_t flags = cmd[2];
+    const uint32_t nbBytes = cmd[4];
+    if(getInterfaceState() != InterfaceState::INTIALIZED || nbBytes > std::min(64u - 5, getResponsePayloadSize()) || !selectDevice(index))
+        return CmdStatus::NOK;
+    const bool frame16 = _devices[index].dataBits > 8;
+    if(frame16 && (nbBytes & 1))
+        return CmdStatus::NOK;
+
+    // Frames over 8 bits: 16-bit buffers, L.Endian byte pairs on this CPU
+    uint8_t *tx8 = reinterpret_cast<uint8_t *>(_deviceTx);
+    if(flags & 0x01)
+        memcpy(tx8, &cmd[5], nbBytes);
+    else
+        memset(tx8, cmd[3], nbBytes);
+    if(isLsbFirst())
+        reverseBits(tx8, nbBytes);
+
+    _job.clear();
+    _job.addTransfer(tx8, reinterpret_cast<uint8_t *>(_deviceRx), nbBytes, frame16);
+    assertDeviceCs();
+    if(!Core1Worker::submit(&_job)) {
+        releaseDeviceCs();
+        return CmdStatus::NOK;
+    }
+    _deviceNbBytes = nbBytes;
+    _deviceKeepCs = (flags & 0x02) != 0;
+    _jobReportId = cmd[0];
+    return CmdStatus::NOT_FINISHED; // answered by task() at the end of the job
+}
+
+CmdStatus SPIMaster::jobEnd(uint8_t response[64]) {
+    const uint8_t offset = getInstIndex() * Report::ID::SPI0_SPI1_OFFSET;
+    response[0] = _jobReportId;
+    _jobReportId = 0;
+    if(getInterfaceState() != InterfaceState::INTIALIZED)
+        return CmdStatus::NOK; // stopped by SPIx_DEINIT
+
+    if(response[0] == Report::ID::SPI0_DISPLAY_WRITE + offset) {
+        endDisplayWrite();
+        return CmdStatus::OK;
+    }
+    if(!_deviceKeepCs)
+        releaseDeviceCs();
+    uint8_t *rx8 = reinterpret_cast<uint8_t *>(_deviceRx);
+    if(isLsbFirst())
+        reverseBits(rx8, _deviceNbBytes);
+    memcpy(&response[2], rx8, _deviceNbBytes);
+    return CmdStatus::OK;
+}
+
+bool SPIMaster::selectDevice(uint8_t index) {
+    if(index >= NB_DEVICES || _devices[index].baudrate == 0)
+        return false;
+    if(_csDevice != index)
+        releaseDeviceCs();
+    if(_currentDevice != index) {
+        const SpiDevice &device = _devices[index];
+        spi_set_baudrate(_spiInst, device.baudrate);
+        // Order always MSB first (only one supported by the SPI), see lsbFirst
+        spi_set_format(_spiInst, device.dataBits, device.cpol, device.cpha, SPI_MSB_FIRST);
+        _currentDevice = index;
+    }
+    return true;
+}
+
+void SPIMaster::assertDeviceCs() {
+    const SpiDevice &device = _devices[_currentDevice];
+    if(device.csGP >= 0)
+        gpio_put(device.csGP, device.csActiveHigh);
+    _csDevice = _currentDevice;
+}
+
+void SPIMaster::releaseDeviceCs() {
+    if(_csDevice == NO_DEVICE)
+        return;
+    const SpiDevice &device = _devices[_csDevice];
+    if(device.csGP >= 0)
+        gpio_put(device.csGP, !device.csActiveHigh);
+    _csDevice = NO_DEVICE;
+}
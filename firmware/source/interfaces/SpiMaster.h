@@ -2,31 +2,182 @@
 #define _INTERFACE_SPI_MASTER_H
 
 #include "PicoInterfacesBoard.h"
-#include "StreamedInterface.h"
+#include "MemoryProgrammer.h"
+#include "../Core1Worker.h"
 #include "hardware/spi.h"
 
+// Blocking transfers of a command (device transfer, display command list, memory programming step) run on core1,
+// core0 serves the other interfaces meanwhile. The buffers given to the operations belong to core1 while busy.
+class SpiJob : public WorkerJob {
+public:
+    SpiJob(BaseInterface *owner);
+
+    void setup(spi_inst_t *spi);
+    // Operations run in order, until clear()
+    void clear();
+    void addGpio(uint gp, bool value);
+    void addFormat(uint dataBits, spi_cpol_t cpol, spi_cpha_t cpha);
+    void addWrite(const uint8_t *src, uint32_t len);
+    // 0x00 clocked out
+    void addRead(uint8_t *dst, uint32_t len);
+    // frame16: L.Endian byte pairs, len in bytes
+    void addTransfer(const uint8_t *src, uint8_t *dst, uint32_t len, bool frame16);
+    // SPIx_DISPLAY_WRITE list, DC (dcGP, -1: none) set before each entry
+    void addDisplayList(const uint8_t *list, uint32_t len, int dcGP);
+
+protected:
+    bool run();
+
+    enum OP_TYPE {
+        OP_GPIO = 0x00,
+        OP_FORMAT = 0x01,
+        OP_WRITE = 0x02,
+        OP_READ = 0x03,
+        OP_TRANSFER = 0x04,
+        OP_TRANSFER16 = 0x05,
+        OP_DISPLAY_LIST = 0x06
+    };
+    struct Op {
+        OP_TYPE type;
+        const uint8_t *src;
+        uint8_t *dst;
+        uint32_t len; // bytes, data bits of OP_FORMAT
+        int gp;       // OP_GPIO pin, DC of OP_DISPLAY_LIST
+        bool value;
+        spi_cpol_t cpol;
+        spi_cpha_t cpha;
+    };
+    Op &addOp(OP_TYPE type);
+
+    static const uint MAX_OPS = 8;
+    spi_inst_t *_spi;
+    Op _ops[MAX_OPS];
+    uint _nbOps;
+};
 
-class SPIMaster : public StreamedInterface {
+class SPIMaster : public MemoryProgrammer {
 public:
     SPIMaster(uint8_t i2cIndex, uint streamBufferSize);
     virtual ~SPIMaster();
 
     CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
     CmdStatus task(uint8_t response[64]);
+    void abort(uint8_t reportId);
 
 protected:
     CmdStatus init(uint8_t const *cmd);
     CmdStatus deInit();
     CmdStatus write(const uint8_t *cmd);
     CmdStatus writeFromUart(const uint8_t *cmd);
+    CmdStatus transferStream(const uint8_t *cmd);
+    CmdStatus transferStreamTask(uint8_t response[64]);
     CmdStatus read(const uint8_t *cmd, uint8_t *ret);
+    CmdStatus deviceConfig(const uint8_t *cmd);
+    CmdStatus deviceTransfer(const uint8_t *cmd);
+    // Job of _jobReportId ended: CS released, CmdStatus::NOK if SPIx_DEINIT came meanwhile
+    CmdStatus jobEnd(uint8_t response[64]);
+    // Waits for the job running on core1
+    void waitJob();
+    // Applies the baudrate and format of the device if another one was used before, releases the CS kept asserted
+    // by another device. False if the device is not configured.
+    bool selectDevice(uint8_t index);
+    void assertDeviceCs();
+    void releaseDeviceCs();
+    inline bool isLsbFirst() const { return _currentDevice < NB_DEVICES && _devices[_currentDevice].lsbFirst; }
+    CmdStatus displayPins(const uint8_t *cmd);
+    CmdStatus displayWrite(const uint8_t *cmd);
+    // Releases CS and restores the 8-bit frames at the end of the SPIx_DISPLAY_WRITE data
+    void endDisplayWrite();
+    // SPIx_MEM_PROGRAM, SPI NOR flash: each step is a few blocking transfers run by the core1 job, MEM_STEP_WAIT
+    // until it ends
+    CmdStatus memProgramStart(const uint8_t *cmd);
+    MEM_STEP memErase(uint32_t address);
+    MEM_STEP memProgram(uint32_t address, uint8_t *page, uint32_t pageLen);
+    MEM_STEP memPollReady();
+    MEM_STEP memReadBack(uint32_t address, uint8_t *dst, uint32_t len);
+    // Opcode and big endian address, returns the header size
+    uint32_t memHeader(uint8_t *dst, uint8_t opcode, uint32_t address);
+    // Operations of a memory command: CS asserted around src (then len read bytes if dst)
+    void memAddCommand(const uint8_t *src, uint32_t srcLen, uint8_t *dst = nullptr, uint32_t len = 0);
+    MEM_STEP memSubmitJob();
     uint8_t getInstIndex();
+    // Stream chunk clocked out by the DMA channel (paced by the SPI TX DREQ)
+    void startDmaWrite(const uint8_t *src, uint32_t len);
+    // Waits for the last bytes in the TX FIFO, drops the RX FIFO filled by the write-only transfers
+    void endDmaWrite();
+    // Full-duplex chunk: RX bytes written in place of the TX bytes (an RX byte comes after its TX byte is read)
+    void startDmaTransfer(uint8_t *buf, uint32_t len);
+    // RX bytes of the completed chunks to CDC, in chunk order
+    void drainTransferRx();
+    // Shared DMA_IRQ_0 handler of the SPI instances
+    static void dmaHandler();
 
     spi_inst_t *_spiInst;
     uint _clkGP;
     uint _mosiGP;
     uint _misoGP;
+    int _dmaChannel;
+    int _dmaRxChannel;
+    uint32_t _dmaLen; // bytes in flight, 0 when the DMA channel is idle
+    uint8_t _streamReportId; // final response of the write stream
+    SpiJob _job;
+    uint8_t _jobReportId; // command answered by task() at the end of the job, 0: none
+
+    // SPIx_DEVICE_CONFIG descriptors, the device 0 is set by SPIx_INIT
+    struct SpiDevice {
+        uint baudrate; // 0: not configured
+        int csGP;      // -1: no CS
+        bool csActiveHigh;
+        bool lsbFirst; // bytes mirrored by the firmware, the SPI only shifts MSB first
+        uint dataBits;
+        spi_cpol_t cpol;
+        spi_cpha_t cpha;
+    };
+    static const uint8_t NB_DEVICES = 5;
+    static const uint8_t NO_DEVICE = 0xFF;
+    SpiDevice _devices[NB_DEVICES];
+    uint8_t _currentDevice; // settings applied to the SPI, NO_DEVICE after another format
+    uint8_t _csDevice;      // CS asserted, NO_DEVICE if none
+    // SPIx_DEVICE_TRANSFER buffers of the job, 16-bit aligned for the frames over 8 bits
+    uint16_t _deviceTx[(64 - 5 + 1) / 2];
+    uint16_t _deviceRx[(64 - 5 + 1) / 2];
+    uint8_t _deviceNbBytes;
+    bool _deviceKeepCs;
+
+    // SPIx_DISPLAY_WRITE
+    int _csGP; // -1 when not bound
+    int _dcGP;
+    bool _frame16; // data stream clocked out as 16-bit frames (RGB565 pixels in CPU order)
+    uint8_t _displayList[HID_CMD_SIZE]; // command list sent by the job
+
+    // SPIx_MEM_PROGRAM profile
+    uint _memCsGP;
+    uint8_t _memOpWriteEnable;
+    uint8_t _memOpProgram;
+    uint8_t _memOpReadStatus;
+    uint8_t _memBusyMask;
+    uint8_t _memOpRead;
+    uint8_t _memOpErase;
+    uint8_t _memJobHeader[5];
+    uint8_t _memJobStatus;
+    bool _memJobRunning; // step submitted, its result is read when called again
+
+    // SPIx_TRANSFER_STREAM, a chunk per stream buffer
+    enum TRANSFER_STATE {
+        TRANSFER_FREE = 0x00,      // receiving the TX bytes from CDC (or fill byte)
+        TRANSFER_IN_FLIGHT = 0x01, // clocked by DMA
+        TRANSFER_DRAINING = 0x02   // RX bytes written to CDC
+    };
+    bool _transferStream;
+    bool _transferFill;
+    uint8_t _fillByte;
+    uint32_t _transferBytesToStart;
+    TRANSFER_STATE _transferStates[2];
+    uint32_t _transferLens[2];
+    uint32_t _drainOffset;
+    int _drainIndex; // oldest completed chunk
+
+    static SPIMaster *_sSpis[2];
 };
 
 #endif
-
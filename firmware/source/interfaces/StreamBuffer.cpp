@@ -1,12 +1,26 @@
 #include "StreamBuffer.h"
 
+#include "../MemoryArena.h"
 
 
 StreamBuffer::StreamBuffer(uint streamBufferSize)
-    : _buffer(streamBufferSize/4 + 2, 0), _bufSize(0) {
+    : _buffer(nullptr), _nbWords(streamBufferSize/4 + 2), _bufSize(0) {
 
 }
 
 StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+bool StreamBuffer::allocate() {
+    if(_buffer == nullptr)
+        _buffer = static_cast<uint32_t*>(MemoryArena::allocate(_nbWords*4));
+    _bufSize = 0;
+    return _buffer != nullptr;
+}
 
+void StreamBuffer::release() {
+    MemoryArena::release(_buffer);
+    _buffer = nullptr;
+    _bufSize = 0;
 }
@@ -2,21 +2,25 @@
 #define _INTERFACE_STREAM_BUFFER_H
 
 #include <stdio.h>
-#include <vector>
+#include "pico.h"
 
 
+// Buffer taken from the memory arena between allocate() and release()
 class StreamBuffer {
 public:
     StreamBuffer(uint streamBufferSize);
     virtual ~StreamBuffer();
-    inline uint32_t getAllocateSize() const {return static_cast<uint32_t>(_buffer.size()*4);}
-    inline uint8_t* getDataPtr8() {return (uint8_t*)_buffer.data();}
-    inline uint32_t* getDataPtr32() {return static_cast<uint32_t*>(_buffer.data());}
+    bool allocate();
+    void release();
+    inline bool isAllocated() const {return _buffer != nullptr;}
+    inline uint32_t getAllocateSize() const {return isAllocated() ? _nbWords*4 : 0;}
+    inline uint8_t* getDataPtr8() {return (uint8_t*)_buffer;}
+    inline uint32_t* getDataPtr32() {return _buffer;}
     inline void setSize(uint32_t size) {_bufSize = size;}
     inline uint32_t size() const {return _bufSize;}
 protected:
-    //std::vector<uint8_t> _buffer;
-    std::vector<uint32_t> _buffer; // to be 32-bit aligned for ws2812b
+    uint32_t *_buffer; // 32-bit aligned for ws2812b
+    uint32_t _nbWords;
     uint _bufSize;
 };
 
@@ -2,26 +2,50 @@
 //#include <algorithm>
 
 #include "tusb.h"
+#include "../Stats.h"
+#include "../Trace.h"
 
 StreamedInterface::StreamedInterface(uint streamBufferSize, bool doubleBuffer)
-    : _bufferRx(streamBufferSize), _bufferRx2(doubleBuffer ? streamBufferSize : 0), _totalRemainingBytesToSend(0), _currentBufferIndex(0){
+    : _bufferRx(streamBufferSize), _bufferRx2(doubleBuffer ? streamBufferSize : 0), _totalRemainingBytesToSend(0), _currentBufferIndex(0), _doubleBuffer(doubleBuffer){
 }
 
 StreamedInterface::~StreamedInterface() {
 
 }
 
+bool StreamedInterface::acquireStreamBuffers() {
+    if(!_bufferRx.allocate() || (_doubleBuffer && !_bufferRx2.allocate())) {
+        releaseStreamBuffers();
+        return false;
+    }
+    _currentBufferIndex = 0;
+    return true;
+}
+
+void StreamedInterface::releaseStreamBuffers() {
+    _bufferRx.release();
+    _bufferRx2.release();
+    _totalRemainingBytesToSend = 0;
+}
+
 void StreamedInterface::flushStreamRx() {
     tud_cdc_read_flush();
 }
 
 uint32_t StreamedInterface::streamRxAvailableSize() {
-    return tud_cdc_available();
+    const uint32_t available = tud_cdc_available();
+    if(available == 0)
+        waitCdcRx();
+    return available;
 }
 
-uint32_t StreamedInterface::streamRxRead() {
+uint32_t StreamedInterface::streamRxRead(uint32_t maxSize) {
     StreamBuffer &buf = getBuffer();
-    uint32_t nbByteCanRead = std::min(buf.getAllocateSize() - buf.size(), streamRxAvailableSize());
-    buf.setSize(buf.size() + tud_cdc_read(buf.getDataPtr8() + buf.size(), nbByteCanRead));
+    uint32_t nbByteCanRead = std::min({buf.getAllocateSize() - buf.size(), streamRxAvailableSize(), maxSize});
+    const uint32_t nbRead = tud_cdc_read(buf.getDataPtr8() + buf.size(), nbByteCanRead);
+    Stats::addCdcBytes(getInterfaceIndex(), nbRead);
+    if(nbRead > 0)
+        Trace::record(TRACE_EVENT::TRACE_CDC_READ, getInterfaceIndex(), static_cast<uint16_t>(nbRead));
+    buf.setSize(buf.size() + nbRead);
     return buf.size();
 }
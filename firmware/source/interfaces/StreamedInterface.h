@@ -1,6 +1,7 @@
 #ifndef _STREAMED_INTERFACES_PICO_H
 #define _STREAMED_INTERFACES_PICO_H
 
+#include <algorithm>
 #include "BaseInterface.h"
 #include "StreamBuffer.h"
 
@@ -14,14 +15,19 @@ public:
     inline StreamBuffer & getBuffer() {return (_currentBufferIndex == 0 ? _bufferRx : _bufferRx2);}
 
 protected:
+    // Buffers taken from the memory arena at init and given back at deinit: false if the arena is exhausted
+    bool acquireStreamBuffers();
+    void releaseStreamBuffers();
     void flushStreamRx();
     uint32_t streamRxAvailableSize();
-    uint32_t streamRxRead();
+    // Appends at most maxSize bytes to the current buffer, returns its size
+    uint32_t streamRxRead(uint32_t maxSize = UINT32_MAX);
 
     StreamBuffer _bufferRx;
     StreamBuffer _bufferRx2;
     uint32_t _totalRemainingBytesToSend;
     int _currentBufferIndex;
+    bool _doubleBuffer;
 };
 
 
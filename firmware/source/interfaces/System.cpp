@@ -1,11 +1,28 @@
 #include "System.h"
 
+#include <string.h>
+#include <algorithm>
+
 #include "hardware/watchdog.h"
 #include "pico/unique_id.h"
 
-System::System()
- : _needReset(false), count(0){
+System::System(ResponseQueue &responseQueue, AsyncCmds &asyncCmds)
+ : _responseQueue(responseQueue), _asyncCmds(asyncCmds), _needReset(false), count(0),
+   _batchRunning(false), _batchDone(false), _batchStatus(CmdStatus::OK), _batchRoute(), _batchCmd(), _batchResponse(),
+   _batchNbDone(0), _batchCmdIndex(0), _batchResponseIndex(0), _batchWaitReportId(0) {
     setInterfaceState(InterfaceState::INTIALIZED);
+    registerReports({
+        Report::ID::SYS_RESET,
+        Report::ID::SYS_GET_SN,
+        Report::ID::SYS_GET_VN,
+        Report::ID::SYS_BATCH,
+        Report::ID::SYS_GET_QUEUE_STATS,
+        Report::ID::SYS_SET_CMD_TIMEOUT,
+        Report::ID::SYS_GET_STATS,
+        Report::ID::SYS_RESET_STATS,
+        Report::ID::SYS_TRACE_CTRL,
+        Report::ID::SYS_TRACE_READ
+    });
 }
 
 System::~System() {
@@ -31,17 +48,232 @@ CmdStatus System::process(uint8_t const *cmd, uint8_t response[64]) {
         response[3] = PROJECT_VER_MINOR;
         response[4] = PROJECT_VER_PATCH;
         status = CmdStatus::OK;
+    } else if(cmd[0] == Report::ID::SYS_BATCH) {
+        status = batch(cmd, response);
+    } else if(cmd[0] == Report::ID::SYS_GET_QUEUE_STATS) {
+        status = getQueueStats(cmd, response);
+    } else if(cmd[0] == Report::ID::SYS_SET_CMD_TIMEOUT) {
+        _asyncCmds.setTimeout(cmd[1], convertBytesToUInt32(&cmd[2]));
+        status = CmdStatus::OK;
+    } else if(cmd[0] == Report::ID::SYS_GET_STATS) {
+        status = getStats(cmd, response);
+    } else if(cmd[0] == Report::ID::SYS_RESET_STATS) {
+        Stats::reset();
+        _responseQueue.resetStats();
+        status = CmdStatus::OK;
+    } else if(cmd[0] == Report::ID::SYS_TRACE_CTRL) {
+        status = traceCtrl(cmd, response);
+    } else if(cmd[0] == Report::ID::SYS_TRACE_READ) {
+        status = traceRead(response);
     }
 
     return status;
 }
 
+CmdStatus System::batch(uint8_t const *cmd, uint8_t response[64]) {
+    const uint8_t nbCmds = cmd[1];
+    response[2] = 0;
+    if(_batchRunning)
+        return CmdStatus::NOK; // one batch waiting at a time
+
+    // Check the whole batch before executing anything
+    uint cmdIndex = 2;
+    uint responseIndex = 3;
+    for(uint8_t it = 0; it < nbCmds; it++) {
+        if(cmdIndex + 2 > HID_CMD_SIZE)
+            return CmdStatus::NOK;
+        const uint cmdSize = cmd[cmdIndex];
+        const uint responseSize = cmd[cmdIndex + 1];
+        cmdIndex += 2 + cmdSize;
+        responseIndex += 1 + responseSize;
+        if(cmdSize == 0 || cmdIndex > HID_CMD_SIZE || responseIndex > 2 + getResponsePayloadSize())
+            return CmdStatus::NOK;
+        if(cmd[cmdIndex - cmdSize] == Report::ID::SYS_BATCH)
+            return CmdStatus::NOK;
+    }
+
+    memcpy(_batchCmd, cmd, HID_CMD_SIZE);
+    memset(_batchResponse, 0, HID_RESPONSE_SIZE);
+    _batchRoute = _asyncCmds.getCurrentRoute();
+    _batchNbDone = 0;
+    _batchCmdIndex = 2;
+    _batchResponseIndex = 3;
+    const CmdStatus status = runBatch();
+    if(status == CmdStatus::NOT_FINISHED) {
+        _batchRunning = true;
+        return status; // answered by task() once the sub-commands have run
+    }
+    memcpy(&response[2], &_batchResponse[2], HID_RESPONSE_SIZE - 2);
+    return status;
+}
+
+CmdStatus System::runBatch() {
+    uint8_t subCmd[HID_CMD_SIZE];
+    uint8_t subResponse[HID_RESPONSE_SIZE];
+    // Only RESPONSE_SIZE bytes of each sub-command are copied, checked with the payload size of the batch
+    setResponsePayloadSize(HID_RESPONSE_SIZE - 2);
+    while(_batchNbDone < _batchCmd[1]) {
+        const uint cmdSize = _batchCmd[_batchCmdIndex];
+        memset(subCmd, 0, HID_CMD_SIZE);
+        memcpy(subCmd, &_batchCmd[_batchCmdIndex + 2], cmdSize);
+        memset(subResponse, 0, HID_RESPONSE_SIZE);
+
+        CmdStatus subStatus = CmdStatus::NOT_CONCERNED;
+        BaseInterface *handler = BaseInterface::getReportHandler(subCmd[0]);
+        if(handler != nullptr) {
+            const uint32_t processStartUs = Stats::now();
+            Trace::record(TRACE_EVENT::TRACE_CMD_START, subCmd[0]);
+            subStatus = handler->process(subCmd, subResponse);
+            Trace::record(TRACE_EVENT::TRACE_CMD_END, subCmd[0], subStatus);
+            Stats::recordCmd(subCmd[0], processStartUs);
+            handler->setPending();
+            if(subStatus == CmdStatus::NOT_FINISHED) {
+                // Its response comes back to resumeBatch(), with its deadline (SYS_SET_CMD_TIMEOUT)
+                if(_asyncCmds.start(subCmd[0], handler, {0, CmdTransport::BATCH})) {
+                    _batchWaitReportId = subCmd[0];
+                    return CmdStatus::NOT_FINISHED;
+                }
+                handler->abort(subCmd[0]);
+                subStatus = CmdStatus::NOK;
+            } else if(subStatus == CmdStatus::OK) {
+                _asyncCmds.accept(subCmd[0], _batchRoute); // end of a stream sent on the route of the batch
+            }
+        }
+
+        if(!recordBatchResponse(subStatus, subResponse))
+            return CmdStatus::NOK;
+    }
+    return CmdStatus::OK;
+}
+
+bool System::recordBatchResponse(CmdStatus subStatus, uint8_t const *subResponse) {
+    const uint cmdSize = _batchCmd[_batchCmdIndex];
+    const uint responseSize = _batchCmd[_batchCmdIndex + 1];
+    _batchResponse[_batchResponseIndex] = subStatus;
+    memcpy(&_batchResponse[_batchResponseIndex + 1], &subResponse[2], responseSize);
+    _batchResponse[2] = ++_batchNbDone;
+    _batchCmdIndex += 2 + cmdSize;
+    _batchResponseIndex += 1 + responseSize;
+    return subStatus == CmdStatus::OK;
+}
+
+void System::resumeBatch(uint8_t const *response) {
+    const CmdStatus subStatus = static_cast<CmdStatus>(response[1]);
+    if(!_batchRunning || _batchDone || response[0] != _batchWaitReportId || subStatus == CmdStatus::PROGRESS)
+        return; // batch ended by its deadline
+    _batchWaitReportId = 0;
+    CmdStatus status = CmdStatus::NOK;
+    if(recordBatchResponse(subStatus, response))
+        status = runBatch();
+    if(status == CmdStatus::NOT_FINISHED)
+        return;
+    _batchStatus = status;
+    _batchDone = true;
+    setPending();
+}
+
+CmdStatus System::getQueueStats(uint8_t const *cmd, uint8_t response[64]) {
+    const ResponseQueue::Stats &stats = _responseQueue.stats();
+    response[2] = static_cast<uint8_t>(ResponseQueue::SIZE);
+    response[3] = static_cast<uint8_t>(_responseQueue.level());
+    response[4] = static_cast<uint8_t>(stats.highWater);
+    convertUInt32ToBytes(stats.deferredCmds, &response[5]);
+    convertUInt32ToBytes(stats.droppedCmds, &response[9]);
+    convertUInt32ToBytes(stats.droppedResponses, &response[13]);
+
+    if(cmd[1])
+        _responseQueue.resetStats();
+    return CmdStatus::OK;
+}
+
+CmdStatus System::getStats(uint8_t const *cmd, uint8_t response[64]) {
+    const uint8_t section = cmd[1];
+    const uint8_t index = cmd[2];
+    response[2] = section;
+    response[3] = index;
+
+    if(section == STATS_SECTION::STATS_SUMMARY) {
+        convertUInt64ToBytes(Stats::getElapsedUs(), &response[4]);
+        convertUInt64ToBytes(Stats::getSleepUs(), &response[12]);
+        response[20] = static_cast<uint8_t>(ResponseQueue::SIZE);
+        response[21] = static_cast<uint8_t>(_responseQueue.stats().highWater);
+        response[22] = static_cast<uint8_t>(BaseInterface::getInterfaceCount());
+        memset(&response[23], 0, 32);
+        for(uint reportId = 0; reportId < 256; reportId++) {
+            if(Stats::getCmd(static_cast<uint8_t>(reportId)).count > 0)
+                response[23 + reportId / 8] |= static_cast<uint8_t>(1u << (reportId % 8));
+        }
+    } else if(section == STATS_SECTION::STATS_LOOP && index <= 1) {
+        convertDurationToBytes(index == 0 ? Stats::getLoop() : Stats::getUsb(), &response[4]);
+    } else if(section == STATS_SECTION::STATS_CMD) {
+        convertDurationToBytes(Stats::getCmd(index), &response[4]);
+    } else if(section == STATS_SECTION::STATS_TASK && index < BaseInterface::getInterfaceCount()) {
+        const Stats::InterfaceStats &interfaceStats = Stats::getInterface(index);
+        convertDurationToBytes(interfaceStats.task, &response[4]);
+        response[52] = BaseInterface::getInterface(index)->getFirstReportId();
+        convertUInt64ToBytes(interfaceStats.cdcBytes, &response[53]);
+    } else {
+        return CmdStatus::NOK;
+    }
+    return CmdStatus::OK;
+}
+
+CmdStatus System::traceCtrl(uint8_t const *cmd, uint8_t response[64]) {
+    if(cmd[1])
+        Trace::start();
+    else
+        Trace::stop();
+    convertUInt32ToBytes(Trace::SIZE, &response[2]);
+    convertUInt32ToBytes(Trace::level(), &response[6]);
+    convertUInt32ToBytes(Trace::getDroppedEvents(), &response[10]);
+    return CmdStatus::OK;
+}
+
+CmdStatus System::traceRead(uint8_t response[64]) {
+    static const uint MAX_EVENTS = (HID_RESPONSE_SIZE - 7) / sizeof(Trace::Event);
+    Trace::Event events[MAX_EVENTS];
+    const uint nbEvents = Trace::read(events, std::min<uint>(MAX_EVENTS, (getResponsePayloadSize() - 5) / sizeof(Trace::Event)));
+    response[2] = static_cast<uint8_t>(nbEvents);
+    convertUInt32ToBytes(Trace::getDroppedEvents(), &response[3]);
+    for(uint it = 0; it < nbEvents; it++) {
+        uint8_t *dst = &response[7 + it * 8];
+        convertUInt32ToBytes(events[it].timeUs, &dst[0]);
+        dst[4] = events[it].type;
+        dst[5] = events[it].id;
+        convertUInt16ToBytes(events[it].arg, &dst[6]);
+    }
+    return CmdStatus::OK;
+}
+
+// | COUNT[4] | MAX_US[4] | TOTAL_US[8] | HISTOGRAM[4] * Stats::NB_BUCKETS | (48 bytes)
+void System::convertDurationToBytes(const Stats::Duration &duration, uint8_t *array) {
+    convertUInt32ToBytes(duration.count, &array[0]);
+    convertUInt32ToBytes(duration.maxUs, &array[4]);
+    convertUInt64ToBytes(duration.totalUs, &array[8]);
+    for(uint bucket = 0; bucket < Stats::NB_BUCKETS; bucket++) {
+        convertUInt32ToBytes(duration.histogram[bucket], &array[16 + bucket * 4]);
+    }
+}
+
+void System::convertUInt64ToBytes(uint64_t value, uint8_t *array) {
+    convertUInt32ToBytes(static_cast<uint32_t>(value), &array[0]);
+    convertUInt32ToBytes(static_cast<uint32_t>(value >> 32), &array[4]);
+}
+
 CmdStatus System::task(uint8_t response[64]) {
-    (void)response;
     CmdStatus status = CmdStatus::NOT_CONCERNED;
 
+    if(_batchDone) {
+        _batchDone = false;
+        _batchRunning = false;
+        response[0] = Report::ID::SYS_BATCH;
+        memcpy(&response[2], &_batchResponse[2], HID_RESPONSE_SIZE - 2);
+        return _batchStatus;
+    }
+
     if(_needReset) {
         count++; // give some time in event loop to send System ACK
+        status = CmdStatus::NOT_FINISHED;
     }
 
     if(_needReset && count > 10) {
@@ -52,3 +284,15 @@ CmdStatus System::task(uint8_t response[64]) {
     return status;
 }
 
+void System::abort(uint8_t reportId) {
+    // Deadline of the batch reached: its sub-command is stopped, its response can't end the next batch
+    if(reportId == Report::ID::SYS_BATCH) {
+        BaseInterface *handler = BaseInterface::getReportHandler(_batchWaitReportId);
+        if(handler != nullptr && _asyncCmds.getRoute(_batchWaitReportId).transport == CmdTransport::BATCH
+           && _asyncCmds.complete(_batchWaitReportId))
+            handler->abort(_batchWaitReportId);
+        _batchWaitReportId = 0;
+        _batchRunning = false;
+        _batchDone = false;
+    }
+}
@@ -3,18 +3,52 @@
 
 #include "PicoInterfacesBoard.h"
 #include "BaseInterface.h"
+#include "../ResponseQueue.h"
+#include "../AsyncCmds.h"
+#include "../Stats.h"
+#include "../Trace.h"
 
 
 class System : public BaseInterface {
 public:
-    System();
+    System(ResponseQueue &responseQueue, AsyncCmds &asyncCmds);
     virtual ~System();
 
     CmdStatus process(uint8_t const *cmd, uint8_t response[64]);
     CmdStatus task(uint8_t response[64]);
+    void abort(uint8_t reportId);
+    // Response of the asynchronous sub-command the batch waits for (CmdTransport::BATCH route)
+    void resumeBatch(uint8_t const *response);
 protected:
+    CmdStatus batch(uint8_t const *cmd, uint8_t response[64]);
+    // Runs the sub-commands from _batchCmdIndex, CmdStatus::NOT_FINISHED while one of them is asynchronous
+    CmdStatus runBatch();
+    // | STATUS | PAYLOAD[RESPONSE_SIZE] | of the running sub-command, false if the batch ends on it
+    bool recordBatchResponse(CmdStatus subStatus, uint8_t const *subResponse);
+    CmdStatus getQueueStats(uint8_t const *cmd, uint8_t response[64]);
+    CmdStatus getStats(uint8_t const *cmd, uint8_t response[64]);
+    CmdStatus traceCtrl(uint8_t const *cmd, uint8_t response[64]);
+    CmdStatus traceRead(uint8_t response[64]);
+    static void convertDurationToBytes(const Stats::Duration &duration, uint8_t *array);
+    static void convertUInt64ToBytes(uint64_t value, uint8_t *array);
+
+    ResponseQueue &_responseQueue;
+    AsyncCmds &_asyncCmds;
+
     bool _needReset;
     uint count;
+
+    // SYS_BATCH waiting for an asynchronous sub-command, answered by task() at the end
+    bool _batchRunning;
+    bool _batchDone;
+    CmdStatus _batchStatus;
+    CmdRoute _batchRoute;
+    uint8_t _batchCmd[HID_CMD_SIZE];
+    uint8_t _batchResponse[HID_RESPONSE_SIZE];
+    uint8_t _batchNbDone;
+    uint _batchCmdIndex;
+    uint _batchResponseIndex;
+    uint8_t _batchWaitReportId; // asynchronous sub-command waited for, 0: none
 };
 
 
@@ -2,6 +2,20 @@
 #include "string.h"
 #include <algorithm>
 
+#include "hardware/irq.h"
+
+static Uart* _uarts[2] = {nullptr, nullptr};
+
+// RX interrupt is disabled until task() has emptied the RX FIFO
+static void uart0_irq_handler() {
+    uart_set_irq_enables(uart0, false, false);
+    _uarts[0]->setPending();
+}
+
+static void uart1_irq_handler() {
+    uart_set_irq_enables(uart1, false, false);
+    _uarts[1]->setPending();
+}
 
 Uart::Uart(uint uartIndex, uint streamBufferSize)
     : StreamedInterface(streamBufferSize),
@@ -10,6 +24,15 @@ Uart::Uart(uint uartIndex, uint streamBufferSize)
     _rxGP(uartIndex == 0 ? U2IF_UART0_RX : U2IF_UART1_RX) {
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     queue_init(&_rxUartQueue, 1, RX_REPORT_QUEUE_SIZE);
+    _uarts[uartIndex] = this;
+
+    const uint offset = uartIndex * Report::ID::UART0_UART1_OFFSET;
+    registerReports({
+        Report::ID::UART0_INIT + offset,
+        Report::ID::UART0_DEINIT + offset,
+        Report::ID::UART0_WRITE + offset,
+        Report::ID::UART0_READ + offset
+    });
 }
 
 Uart::~Uart() {
@@ -52,6 +75,11 @@ CmdStatus Uart::task(uint8_t response[64]) {
         }
     }
 
+    if(getInterfaceState() == InterfaceState::INTIALIZED && !uart_is_readable(_uartInst)) {
+        uart_set_irq_enables(_uartInst, true, false);
+        status = CmdStatus::NOT_CONCERNED;
+    }
+
     return status;
 }
 
@@ -60,12 +88,19 @@ CmdStatus Uart::init(uint8_t const *cmd) {
     uart_init(_uartInst, baudrate);
     gpio_set_function(_txGP, GPIO_FUNC_UART);
     gpio_set_function(_rxGP, GPIO_FUNC_UART);
+
+    const uint irq = getInstIndex() == 0 ? UART0_IRQ : UART1_IRQ;
+    irq_set_exclusive_handler(irq, getInstIndex() == 0 ? uart0_irq_handler : uart1_irq_handler);
+    irq_set_enabled(irq, true);
+    uart_set_irq_enables(_uartInst, true, false);
     setInterfaceState(InterfaceState::INTIALIZED);
     return CmdStatus::OK;
 }
 
 CmdStatus Uart::deInit() {
     /*TODO*/
+    uart_set_irq_enables(_uartInst, false, false);
+    irq_set_enabled(getInstIndex() == 0 ? UART0_IRQ : UART1_IRQ, false);
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     return CmdStatus::OK;
 }
@@ -73,7 +108,7 @@ CmdStatus Uart::deInit() {
 // | UART_READ_FROM_UART | CmdStatus::OK | NB_BYTES[1] | PAYLOAD
 CmdStatus Uart::read(const uint8_t *report, uint8_t *response){
     (void)report;
-    uint8_t size = static_cast<uint8_t>(std::min(queue_get_level(&_rxUartQueue), HID_RESPONSE_SIZE - 3u ));
+    uint8_t size = static_cast<uint8_t>(std::min(queue_get_level(&_rxUartQueue), getResponsePayloadSize() - 1u));
     response[2] = size;
     uint8_t index = 3;
     while(index <(3+size)) {
@@ -6,20 +6,32 @@
 #include "hardware/dma.h"
 #include "hardware/irq.h"
 #include "ws2812.pio.h"
+#include "../Trace.h"
 
 static const PIO _pio = pio0;
 static const uint _sm = 0;
 static int _dmaChannel;
-static bool _dmaInProgress = false;
+static volatile bool _dmaInProgress = false;
+static Ws2812b* _ws2812b = nullptr;
 
 static void dma_handler() {
+    if(!(dma_hw->ints0 & (1u << _dmaChannel)))
+        return; // DMA_IRQ_0 is shared (SPI streams)
     _dmaInProgress = false;
+    Trace::record(TRACE_EVENT::TRACE_DMA_END, _ws2812b->getInterfaceIndex());
+    _ws2812b->setPending(); // task() ends the transfer
     // Clear the interrupt request.
     dma_hw->ints0 = 1u << _dmaChannel;
 }
 
 Ws2812b::Ws2812b(uint maxLeds)
     : StreamedInterface(maxLeds * 4 +1 /**/), _maxLeds(maxLeds), _internalState(INTERNAL_STATE::IDLE) {
+    _ws2812b = this;
+    registerReports({
+        Report::ID::WS2812B_INIT,
+        Report::ID::WS2812B_DEINIT,
+        Report::ID::WS2812B_WRITE
+    });
     initDma();
 }
 
@@ -55,7 +67,7 @@ CmdStatus Ws2812b::task(uint8_t response[64]) {
         response[0] = Report::ID::WS2812B_WRITE;
         status = CmdStatus::OK;
     } else if(_internalState == INTERNAL_STATE::TRANSFER_IN_PROGRESS && _dmaInProgress) {
-        status = CmdStatus::NOT_FINISHED;
+        status = CmdStatus::NOT_CONCERNED; // woken by dma_handler
     } else if(_internalState == INTERNAL_STATE::TRANSFER_IN_PROGRESS) { // !_dmaInProgress
         _internalState = INTERNAL_STATE::TRANSFER_FINISHED;
         status = CmdStatus::NOT_FINISHED;
@@ -73,6 +85,9 @@ CmdStatus Ws2812b::init(uint8_t const *cmd) {
     if(getInterfaceState() == InterfaceState::INTIALIZED) {
         return CmdStatus::NOK;
     }
+    if(!acquireStreamBuffers()) {
+        return CmdStatus::NOK; // memory arena exhausted
+    }
 
     _offsetProgram = pio_add_program(_pio, &ws2812_program);
     const uint pinId = cmd[1];
@@ -92,8 +107,10 @@ CmdStatus Ws2812b::deinit(uint8_t const *cmd) {
     dma_channel_wait_for_finish_blocking(_dmaChannel);
     pio_sm_set_enabled(_pio, _sm, false);
     _dmaInProgress = false;
+    _internalState = INTERNAL_STATE::IDLE;
 
     pio_remove_program(_pio, &ws2812_program, _offsetProgram);
+    releaseStreamBuffers();
     setInterfaceState(InterfaceState::NOT_INITIALIZED);
     return CmdStatus::OK;
 }
@@ -101,7 +118,7 @@ CmdStatus Ws2812b::deinit(uint8_t const *cmd) {
 CmdStatus Ws2812b::write(uint8_t const *cmd, uint8_t response[64]) {
     const uint32_t nbBytes = convertBytesToUInt32(&cmd[1]);
     response[2] = 0x00;
-    if(_internalState != INTERNAL_STATE::IDLE){
+    if(_internalState != INTERNAL_STATE::IDLE || getInterfaceState() != InterfaceState::INTIALIZED){
         response[2] = 0x02;
         return CmdStatus::NOK;
     } else if(nbBytes > (_maxLeds * 4)) {
@@ -134,9 +151,8 @@ void Ws2812b::initDma() {
     // Tell the DMA to raise IRQ line 0 when the channel finishes a block
     dma_channel_set_irq0_enabled(_dmaChannel, true);
 
-    // Configure the processor to run dma_handler() when DMA IRQ 0 is asserted
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
-    //irq_add_shared_handler(DMA_IRQ_0, dma_handler, 0); => if DMA ira0 is shared
+    // Configure the processor to run dma_handler() when DMA IRQ 0 is asserted, shared with the SPI streams
+    irq_add_shared_handler(DMA_IRQ_0, dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
     irq_set_enabled(DMA_IRQ_0, true);
 }
 
@@ -149,6 +165,7 @@ void Ws2812b::startTransfer(uint32_t *pixelBuf, uint32_t nbPixels) {
 
     // Async version
     _dmaInProgress = true;
+    Trace::record(TRACE_EVENT::TRACE_DMA_START, getInterfaceIndex(), static_cast<uint16_t>(nbPixels));
     // Give the channel a new wave table entry to read from, and re-trigger it
     dma_channel_transfer_from_buffer_now(_dmaChannel, pixelBuf, nbPixels);
 }
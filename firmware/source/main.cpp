@@ -14,28 +14,59 @@ extern "C" {
 }
 #include "board_config.h"
 #include "ModeActivity.h"
+#include "ResponseQueue.h"
+#include "AsyncCmds.h"
+#include "Stats.h"
+#include "Trace.h"
 #include "interfaces/I2cMaster.h"
+#include "interfaces/I2cTarget.h"
 #include "interfaces/SpiMaster.h"
 #include "interfaces/Gpio.h"
 #include "interfaces/System.h"
 #include "interfaces/Pwm.h"
 #include "interfaces/Adc.h"
 #include "interfaces/Uart.h"
+#include "interfaces/GroupGpio.h"
+#include "interfaces/CdcBench.h"
+// PIO interfaces
+#if WS2812_ENABLED
 #include "interfaces/Ws2812b.h"
+#endif
+#if I2S_ENABLED
 #include "interfaces/I2s.h"
+#endif
+#if HUB75_ENABLED
 #include "interfaces/Hub75.h"
-#include "interfaces/GroupGpio.h"
+#endif
+#if FREQ_COUNTER_ENABLED
 #include "interfaces/FreqCounter.h"
+#endif
+#if QSPI_ENABLED
+#include "interfaces/Qspi.h"
+#endif
 
 
-void sendOrSaveResponse(uint8_t response[64]);
+bool processCmd(uint8_t const *buffer, uint16_t bufsize, CmdTransport transport);
+void executeCmd(uint8_t const *buffer, CmdTransport transport);
+void processQueuedCmds();
+void processRejectedCmds();
+void processExpiredCmds();
+void processBulkCmds();
+void sendOrSaveResponse(uint8_t response[64], const CmdRoute &route);
+bool sendResponse(CmdTransport transport, uint8_t const *response);
 void sendSavedResponses();
+bool hasPendingWork();
 
 
 // ModeActivity
 static ModeActivity modeActivity;
+// Responses waiting for their endpoint
+static ResponseQueue responseQueue;
+// Commands answered later by task()
+static AsyncCmds asyncCmds;
 // Interfaces
-static System sys;
+static System sys(responseQueue, asyncCmds);
+static CdcBench cdcBench(19*64);
 
 #if GPIO_ENABLED
 static Gpio gpio;
@@ -50,6 +81,10 @@ static I2CMaster ic2_0(0, 19*64);
 static I2CMaster ic2_1(1, 19*64);
 #endif
 
+#if I2C0_ENABLED || I2C1_ENABLED
+static I2CTarget i2cTarget;
+#endif
+
 #if SPI0_ENABLED
 static SPIMaster spi_0(0, 19*64);
 #endif
@@ -90,6 +125,10 @@ static Hub75 hub75(HUB75_MAX_LEDS*4);
 static FreqCounter freqCounter;
 #endif
 
+#if QSPI_ENABLED
+static Qspi qspi(19*64);
+#endif
+
 static std::vector<BaseInterface*> interfaces = { 
 &gpio
 , &group_gpio
@@ -99,6 +138,9 @@ static std::vector<BaseInterface*> interfaces = {
 #if I2C1_ENABLED
 , &ic2_1
 #endif
+#if I2C0_ENABLED || I2C1_ENABLED
+, &i2cTarget
+#endif
 #if SPI0_ENABLED
 , &spi_0
 #endif
@@ -129,11 +171,30 @@ static std::vector<BaseInterface*> interfaces = {
 #if FREQ_COUNTER_ENABLED
 , &freqCounter
 #endif
+#if QSPI_ENABLED
+, &qspi
+#endif
+, &cdcBench
 , &sys
 };
 
-static queue_t tx_report_queue;
-static const uint TX_REPORT_QUEUE_SIZE = 20;
+// Commands received from USB callbacks, executed by the main loop outside tud_task() when there is room for their response
+struct QueuedCmd {
+    CmdTransport transport;
+    uint8_t data[HID_CMD_SIZE];
+};
+
+static queue_t cmd_queue;
+static const uint CMD_QUEUE_SIZE = 16;
+
+// HID commands received while cmd_queue is full, answered NOK by the main loop
+struct RejectedCmd {
+    CmdRoute route;
+    uint8_t reportId;
+};
+
+static queue_t rejected_queue;
+static const uint REJECTED_QUEUE_SIZE = 16;
 
 //--------------------------------------------------------------------+
 // Main loop function
@@ -143,43 +204,161 @@ int main(void) {
 
     modeActivity.init();
 
-    queue_init(&tx_report_queue, HID_RESPONSE_SIZE, TX_REPORT_QUEUE_SIZE);
+    queue_init(&cmd_queue, sizeof(QueuedCmd), CMD_QUEUE_SIZE);
+    queue_init(&rejected_queue, sizeof(RejectedCmd), REJECTED_QUEUE_SIZE);
     tusb_init();
 
     while (1) {
+        const uint32_t loopStartUs = Stats::now();
         tud_task(); // tinyusb device task
+        Stats::recordUsb(loopStartUs);
+        sendSavedResponses();
+        processBulkCmds();
+        processQueuedCmds();
+        processRejectedCmds();
+        processExpiredCmds();
         static uint8_t response[HID_RESPONSE_SIZE];
-        for (uint8_t index = 0; index < static_cast<uint8_t>(interfaces.size()); index++) {
+        uint32_t pending = BaseInterface::takePendingMask();
+        for (uint8_t index = 0; index < static_cast<uint8_t>(interfaces.size()) && pending; index++) {
+          BaseInterface *interface = interfaces[index];
+          if(!(pending & interface->getPendingBit()))
+            continue;
+          // Tasks are resumed once responses have been sent, nothing is dropped
+          if(responseQueue.isFull())
+            break;
+          pending &= ~interface->getPendingBit();
           response[0] = 0x00;
-          CmdStatus ret = interfaces[index]->task(response);
+          const uint32_t taskStartUs = Stats::now();
+          Trace::record(TRACE_EVENT::TRACE_TASK_START, interface->getInterfaceIndex());
+          CmdStatus ret = interface->task(response);
+          Trace::record(TRACE_EVENT::TRACE_TASK_END, interface->getInterfaceIndex(), ret);
+          Stats::recordTask(interface->getInterfaceIndex(), taskStartUs);
 
           if(ret != CmdStatus::NOT_CONCERNED && ret != CmdStatus::NOT_FINISHED) {
             modeActivity.setBlinking();
             response[1] = ret;
-            sendOrSaveResponse(response);
+            const CmdRoute route = asyncCmds.getRoute(response[0]);
+            if(ret != CmdStatus::PROGRESS)
+                asyncCmds.complete(response[0]);
+            sendOrSaveResponse(response, route);
           } else if(ret == CmdStatus::NOT_FINISHED) {
             //modeActivity.setBlinkingInfinite();
           }
+
+          if(ret != CmdStatus::NOT_CONCERNED && !interface->isWaitingCdcRx())
+            interface->setPending();
         }
+        BaseInterface::setPendingMask(pending); // not serviced in this pass
 
         sendSavedResponses();
+        tud_vendor_write_flush(); // several responses can share one bulk packet
+
+        Stats::recordLoop(loopStartUs);
+
+        // Woken by USB, DMA/UART IRQs, command deadlines or setPending()
+        if(!hasPendingWork()) {
+            const uint32_t sleepStartUs = Stats::now();
+            Trace::record(TRACE_EVENT::TRACE_SLEEP, 0);
+            __wfe();
+            Trace::record(TRACE_EVENT::TRACE_WAKE, 0);
+            Stats::recordSleep(sleepStartUs);
+        }
     }
 }
 
-bool processCmd(uint8_t const *buffer, uint16_t bufsize){
+bool processCmd(uint8_t const *buffer, uint16_t bufsize, CmdTransport transport){
     if(bufsize != 64)
         return false;
 
+    static QueuedCmd queued;
+    queued.transport = transport;
+    memcpy(queued.data, buffer, HID_CMD_SIZE);
+    // HID OUT endpoint is rearmed by TinyUSB, it can not NAK: answered NOK if the queue is full (bulk stops reading instead)
+    if(!queue_try_add(&cmd_queue, &queued)) {
+        RejectedCmd rejected = {{0, transport}, buffer[0]};
+        if(buffer[0] == Report::ID::SYS_TAGGED) {
+            rejected.route.tag = buffer[1];
+            rejected.reportId = buffer[2];
+        }
+        if(!queue_try_add(&rejected_queue, &rejected))
+            responseQueue.stats().droppedCmds++;
+        return true;
+    }
+    Trace::record(TRACE_EVENT::TRACE_CMD_RECEIVED, buffer[0], transport);
+    if(responseQueue.isFull()) {
+        responseQueue.stats().deferredCmds++;
+    }
+    return true;
+}
+
+void processQueuedCmds() {
+    static QueuedCmd queued;
+    while(!responseQueue.isFull() && queue_try_remove(&cmd_queue, &queued)) {
+        executeCmd(queued.data, queued.transport);
+    }
+}
+
+void processRejectedCmds() {
+    static uint8_t response[HID_RESPONSE_SIZE];
+    RejectedCmd rejected;
+    while(!responseQueue.isFull() && queue_try_remove(&rejected_queue, &rejected)) {
+        memset(response, 0, HID_RESPONSE_SIZE);
+        response[0] = rejected.reportId;
+        response[1] = CmdStatus::NOK;
+        sendOrSaveResponse(response, rejected.route);
+    }
+}
+
+void processExpiredCmds() {
+    static uint8_t response[HID_RESPONSE_SIZE];
+    uint8_t reportId;
+    CmdRoute route;
+    while(!responseQueue.isFull() && asyncCmds.takeExpired(&reportId, &route)) {
+        memset(response, 0, HID_RESPONSE_SIZE);
+        response[0] = reportId;
+        response[1] = CmdStatus::TIMEOUT;
+        sendOrSaveResponse(response, route);
+    }
+}
+
+void executeCmd(uint8_t const *buffer, CmdTransport transport) {
     modeActivity.setBlinkingInfinite();
 
+    // Unwrap tagged command, its responses are tagged in sendOrSaveResponse()
+    static uint8_t taggedCmd[HID_CMD_SIZE];
+    uint8_t tag = 0;
+    if(buffer[0] == Report::ID::SYS_TAGGED) {
+        tag = buffer[1];
+        memcpy(taggedCmd, &buffer[2], HID_CMD_SIZE - 2);
+        memset(&taggedCmd[HID_CMD_SIZE - 2], 0, 2);
+        buffer = taggedCmd;
+    }
+    const CmdRoute route = {tag, transport};
+    asyncCmds.setCurrentRoute(route);
+    BaseInterface::setResponsePayloadSize(tag != 0 ? HID_RESPONSE_SIZE - 4 : HID_RESPONSE_SIZE - 2);
+
     CmdStatus ret = CmdStatus::NOT_CONCERNED;
     static uint8_t response[HID_RESPONSE_SIZE];
-      for (uint8_t index = 0; index < static_cast<uint8_t>(interfaces.size()); index++) {
-        response[0] = 0x00;
-        ret = interfaces[index]->process(buffer, response);
-        if(ret != CmdStatus::NOT_CONCERNED)
-          break;
-      }
+    response[0] = 0x00;
+    // Report IDs are claimed by interfaces at construction
+    BaseInterface *handler = BaseInterface::getReportHandler(buffer[0]);
+    if(handler != nullptr) {
+        const uint32_t processStartUs = Stats::now();
+        Trace::record(TRACE_EVENT::TRACE_CMD_START, buffer[0]);
+        ret = handler->process(buffer, response);
+        Trace::record(TRACE_EVENT::TRACE_CMD_END, buffer[0], ret);
+        Stats::recordCmd(buffer[0], processStartUs);
+        handler->setPending(); // task() takes over the command if needed
+        if(ret == CmdStatus::NOT_FINISHED) {
+            if(asyncCmds.start(buffer[0], handler, route)) {
+                return; // response sent by task()
+            }
+            handler->abort(buffer[0]);
+            ret = CmdStatus::NOK;
+        } else if(ret == CmdStatus::OK) {
+            asyncCmds.accept(buffer[0], route); // a stream can go on in task()
+        }
+    }
 
     if(ret != CmdStatus::NOT_CONCERNED) {
     response[0] = buffer[0];
@@ -190,25 +369,59 @@ bool processCmd(uint8_t const *buffer, uint16_t bufsize){
     }
 
     modeActivity.setBlinking();
-    sendOrSaveResponse(response);
-    return true;
+    sendOrSaveResponse(response, route);
+}
+
+void sendOrSaveResponse(uint8_t response[64], const CmdRoute &route) {
+    if(route.transport == CmdTransport::BATCH) {
+        sys.resumeBatch(response);
+        return;
+    }
+    if(route.tag != 0) {
+        // The last 2 bytes are never used: commands are limited by BaseInterface::getResponsePayloadSize()
+        memmove(&response[2], &response[0], HID_RESPONSE_SIZE - 2);
+        response[0] = Report::ID::SYS_TAGGED;
+        response[1] = route.tag;
+    }
+
+    // Saved responses are sent first to keep the order
+    if(!responseQueue.isEmpty() || !sendResponse(route.transport, response)) {
+        responseQueue.push(route.transport, response); // only counted as dropped if full, callers check room first
+        Trace::record(TRACE_EVENT::TRACE_RESPONSE_QUEUED, response[0], static_cast<uint16_t>(responseQueue.level()));
+    }
 }
 
-void sendOrSaveResponse(uint8_t response[64]) {
-    if(!tud_hid_n_ready(0)) {
-        queue_try_add(&tx_report_queue, response); // lost if queue is full
+bool sendResponse(CmdTransport transport, uint8_t const *response) {
+    if(transport == CmdTransport::BULK) {
+        if(tud_vendor_write_available() < HID_RESPONSE_SIZE + 1)
+            return false;
+        const uint8_t size = HID_RESPONSE_SIZE;
+        tud_vendor_write(&size, 1);
+        tud_vendor_write(response, HID_RESPONSE_SIZE);
     } else {
+        if(!tud_hid_n_ready(0))
+            return false;
         tud_hid_report(0, response, HID_RESPONSE_SIZE);
     }
+    Trace::record(TRACE_EVENT::TRACE_RESPONSE_SENT, response[0], transport);
+    return true;
+}
+
+bool hasPendingWork() {
+    if(BaseInterface::hasPendingInterfaces())
+        return true;
+    if(!responseQueue.isFull() && (!queue_is_empty(&cmd_queue) || !queue_is_empty(&rejected_queue)))
+        return true;
+    return !queue_is_full(&cmd_queue) && tud_vendor_available();
 }
 
+// Send as many saved responses as the endpoints accept
 void sendSavedResponses() {
-    if(queue_is_empty(&tx_report_queue) || !tud_hid_n_ready(0)) {
-        return;
-    }
-    static uint8_t response[HID_RESPONSE_SIZE];
-    if(queue_try_remove(&tx_report_queue, response)) {
-        tud_hid_report(0, response, HID_RESPONSE_SIZE);
+    ResponseQueue::Entry *entry;
+    while((entry = responseQueue.front()) != nullptr) {
+        if(!sendResponse(entry->transport, entry->data))
+            break;
+        responseQueue.pop();
     }
 }
 
@@ -264,7 +477,53 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
     (void) instance;;
     (void) report_id;
     (void) report_type;
-    processCmd(buffer, bufsize);
+    processCmd(buffer, bufsize, CmdTransport::HID); // only queued, executed by the main loop
+}
+
+//--------------------------------------------------------------------+
+// USB Vendor: bulk command channel
+//--------------------------------------------------------------------+
+
+// Same commands and responses as HID, framed as | SIZE | DATA[SIZE] | to put several of them in one bulk packet.
+// Commands are zero padded to 64 bytes, SIZE=0 is ignored. Responses are always | 64 | RESPONSE[64] |.
+void processBulkCmds() {
+    static uint8_t cmd[HID_CMD_SIZE];
+    static uint8_t cmdSize = 0;
+    static uint8_t cmdReceived = 0;
+    static uint8_t rx[CFG_TUD_VENDOR_EPSIZE];
+    static uint32_t rxSize = 0;
+    static uint32_t rxIndex = 0;
+
+    // Data stays in the endpoint (NAK) while commands can not be queued
+    while(!queue_is_full(&cmd_queue)) {
+        if(rxIndex == rxSize) {
+            if(!tud_vendor_available())
+                break;
+            rxSize = tud_vendor_read(rx, sizeof(rx));
+            rxIndex = 0;
+            continue;
+        }
+
+        const uint8_t byte = rx[rxIndex++];
+        if(cmdSize == 0) {
+            if(byte > HID_CMD_SIZE) {
+                // Framing lost: the rest of the packet is dropped, not run as commands
+                responseQueue.stats().droppedCmds++;
+                rxIndex = rxSize;
+                continue;
+            }
+            cmdSize = byte;
+            cmdReceived = 0;
+            memset(cmd, 0, HID_CMD_SIZE);
+            continue;
+        }
+
+        cmd[cmdReceived++] = byte;
+        if(cmdReceived == cmdSize) {
+            cmdSize = 0;
+            processCmd(cmd, HID_CMD_SIZE, CmdTransport::BULK);
+        }
+    }
 }
 
 //--------------------------------------------------------------------+
@@ -283,4 +542,5 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
 void tud_cdc_rx_cb(uint8_t itf)
 {
     (void) itf;
+    BaseInterface::signalCdcRx();
 }
@@ -85,7 +85,7 @@ extern "C" {
 #define CFG_TUD_MSC             0
 #define CFG_TUD_HID             1
 #define CFG_TUD_MIDI            0
-#define CFG_TUD_VENDOR          0
+#define CFG_TUD_VENDOR          1
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
 #define CFG_TUD_HID_BUFSIZE     64
@@ -95,6 +95,11 @@ extern "C" {
 #define CFG_TUD_CDC_RX_BUFSIZE   (CFG_TUD_CDC_EP_BUFSIZE * 2)
 #define CFG_TUD_CDC_TX_BUFSIZE   (CFG_TUD_CDC_EP_BUFSIZE * 2)
 
+// Bulk command channel
+#define CFG_TUD_VENDOR_EPSIZE     64
+#define CFG_TUD_VENDOR_RX_BUFSIZE (8*64)
+#define CFG_TUD_VENDOR_TX_BUFSIZE (8*64)
+
 
 
 #ifdef __cplusplus
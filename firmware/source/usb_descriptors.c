@@ -152,6 +152,7 @@ enum {
     ITF_NUM_CDC = 0,
     ITF_NUM_CDC_DATA,
     ITF_NUM_HID,
+    ITF_NUM_VENDOR,
     ITF_NUM_TOTAL
 };
 
@@ -162,9 +163,10 @@ enum {
 
 
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_VENDOR_DESC_LEN)
 
 #define EPNUM_HID   0x03
+#define EPNUM_VENDOR   0x04
 
 uint8_t const desc_configuration[] =
         {
@@ -176,7 +178,10 @@ uint8_t const desc_configuration[] =
 
                 // Interface number, string index, protocol, report descriptor len, EP In & Out address, size & polling interval
                 TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, 5, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID,
-                                         0x80 | EPNUM_HID, CFG_TUD_HID_BUFSIZE, /*10*/ 1)
+                                         0x80 | EPNUM_HID, CFG_TUD_HID_BUFSIZE, /*10*/ 1),
+
+                // Interface number, string index, EP Out & IN address, EP size
+                TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, 6, EPNUM_VENDOR, 0x80 | EPNUM_VENDOR, CFG_TUD_VENDOR_EPSIZE)
         };
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
@@ -200,6 +205,7 @@ char const *string_desc_arr[] =
                 "",                      // 3: Serials, should use chip ID
                 "CDC Streamed data channel"  ,           // 4: CDC Interface
                 "HID Command channel",                     // 5: HID
+                "Bulk Command channel",                    // 6: Vendor
         };
 
 static uint16_t _desc_str[32];
@@ -17,4 +17,7 @@ setup(
         "micropython-cpython-ustruct==0.0",
         "micropython-cpython-micropython==0.1.1",
     ],
+    extras_require={
+        "bulk": ["pyusb>=1.2"],
+    },
 )
@@ -1,4 +1,5 @@
 from .i2c import I2C
+from .i2c_target import I2CTarget
 from .pin import Pin
 from .group_pin import GroupPin
 from .signal import Signal
@@ -11,6 +12,7 @@ from .ws2812b import WS2812B
 from .hub75 import HUB75
 from .u2if_const import u2if
 from .freqcounter import FreqCounter
+from .qspi import QSPI
 from .u2if import Device
 
 
@@ -0,0 +1,61 @@
+import usb.core
+import usb.util
+
+VENDOR_INTERFACE_CLASS = 0xFF
+BULK_READ_SIZE = 512
+
+
+class BulkDevice(object):
+    """Bulk command channel of the firmware vendor interface.
+
+    It has the same write()/read() as hid.Device so it can replace it to send commands.
+    Commands and responses are framed as | SIZE | DATA[SIZE] | on the bulk endpoints.
+    """
+
+    def __init__(self, vid, pid, serial_number=None, timeout_ms=5000):
+        self._timeout_ms = timeout_ms
+        self._dev = usb.core.find(
+            idVendor=vid,
+            idProduct=pid,
+            custom_match=lambda d: serial_number is None
+            or usb.util.get_string(d, d.iSerialNumber).lower() == serial_number.lower(),
+        )
+        if self._dev is None:
+            raise ValueError("No bulk command channel found")
+
+        cfg = self._dev.get_active_configuration()
+        intf = usb.util.find_descriptor(
+            cfg, bInterfaceClass=VENDOR_INTERFACE_CLASS
+        )
+        if intf is None:
+            raise ValueError("Firmware without bulk command channel")
+        self._interface_number = intf.bInterfaceNumber
+        usb.util.claim_interface(self._dev, self._interface_number)
+        self._ep_out = usb.util.find_descriptor(
+            intf,
+            custom_match=lambda e: usb.util.endpoint_direction(e.bEndpointAddress)
+            == usb.util.ENDPOINT_OUT,
+        )
+        self._ep_in = usb.util.find_descriptor(
+            intf,
+            custom_match=lambda e: usb.util.endpoint_direction(e.bEndpointAddress)
+            == usb.util.ENDPOINT_IN,
+        )
+        self._rx = bytearray()
+
+    def close(self):
+        usb.util.release_interface(self._dev, self._interface_number)
+        usb.util.dispose_resources(self._dev)
+
+    def write(self, data):
+        # First byte is the HID report number, zero padding is done by the firmware
+        cmd = bytes(data[1:]).rstrip(b"\0") or b"\0"
+        self._ep_out.write(bytes([len(cmd)]) + cmd, self._timeout_ms)
+
+    def read(self, size):
+        while not self._rx or len(self._rx) < 1 + self._rx[0]:
+            self._rx += self._ep_in.read(BULK_READ_SIZE, self._timeout_ms)
+        frame_size = self._rx[0]
+        res = bytes(self._rx[1 : 1 + frame_size])
+        del self._rx[: 1 + frame_size]
+        return res[:size]
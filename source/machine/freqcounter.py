@@ -116,6 +116,8 @@ class FreqCounter:
             bytes([report_const.FREQ_COUNTER_GET_MEASUREMENT, self.pin_id])
         )
 
+        if res[1] == report_const.TIMEOUT:
+            raise TimeoutError(f"FreqCounter no signal on pin {self.pin_id}.")
         if res[1] != report_const.OK:
             raise RuntimeError(f"FreqCounter measurement failed on pin {self.pin_id}.")
 
@@ -0,0 +1,133 @@
+import socket
+import time
+
+DEFAULT_ADDRESS = "localhost:4015"
+CHANNEL_HID = 0x00
+CHANNEL_CDC = 0x01
+CHANNEL_BULK = 0x02
+MAX_FRAME_SIZE = 0xFFFF
+
+
+class HostConnection(object):
+    """Socket of the firmware host build (firmware/host), in place of the USB interfaces.
+
+    Frames are | CHANNEL | SIZE[2] L.Endian | DATA[SIZE] | in both directions. The hid, serial and bulk
+    attributes have the methods of hid.Device, serial.Serial and BulkDevice used by Device.
+    """
+
+    def __init__(self, address=None, timeout_s=5.0):
+        host, port = (address or DEFAULT_ADDRESS).rsplit(":", 1)
+        # The firmware restarts its process on reset, retry while it is not listening
+        deadline = time.monotonic() + timeout_s
+        while True:
+            try:
+                self._sock = socket.create_connection((host, int(port)), timeout=timeout_s)
+                break
+            except OSError:
+                if time.monotonic() > deadline:
+                    raise
+                time.sleep(0.05)
+        self._sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._rx = {CHANNEL_HID: bytearray(), CHANNEL_CDC: bytearray(), CHANNEL_BULK: bytearray()}
+        self._hid_reports = []
+        self.hid = _HostHid(self)
+        self.serial = _HostSerial(self)
+        self.bulk = _HostBulk(self)
+
+    def close(self):
+        self._sock.close()
+
+    def wait_closed(self):
+        """Wait for the firmware to close the connection (reset), then close it."""
+        try:
+            while self._sock.recv(4096):
+                pass
+        except OSError:
+            pass
+        self._sock.close()
+
+    def send(self, channel, data):
+        data = bytes(data)
+        for offset in range(0, max(len(data), 1), MAX_FRAME_SIZE):
+            chunk = data[offset:offset + MAX_FRAME_SIZE]
+            self._sock.sendall(bytes([channel]) + len(chunk).to_bytes(2, byteorder='little') + chunk)
+
+    def _recv_exact(self, size):
+        buf = bytearray()
+        while len(buf) < size:
+            chunk = self._sock.recv(size - len(buf))
+            if not chunk:
+                raise ConnectionError("Host firmware disconnected")
+            buf += chunk
+        return buf
+
+    def _receive_frame(self):
+        header = self._recv_exact(3)
+        data = self._recv_exact(int.from_bytes(header[1:3], byteorder='little'))
+        if header[0] == CHANNEL_HID:
+            self._hid_reports.append(bytes(data))
+        else:
+            self._rx[header[0]] += data
+
+    def read_hid_report(self):
+        while not self._hid_reports:
+            self._receive_frame()
+        return self._hid_reports.pop(0)
+
+    def read_stream(self, channel, size):
+        while len(self._rx[channel]) < size:
+            self._receive_frame()
+        res = bytes(self._rx[channel][:size])
+        del self._rx[channel][:size]
+        return res
+
+
+class _HostHid(object):
+    def __init__(self, connection):
+        self._connection = connection
+        self.serial = None
+
+    def close(self):
+        self._connection.close()
+
+    def write(self, data):
+        # First byte is the HID report number
+        self._connection.send(CHANNEL_HID, data[1:])
+
+    def read(self, size):
+        return self._connection.read_hid_report()[:size]
+
+
+class _HostSerial(object):
+    def __init__(self, connection):
+        self._connection = connection
+
+    def reset_output_buffer(self):
+        pass
+
+    def flush(self):
+        pass
+
+    def write(self, data):
+        self._connection.send(CHANNEL_CDC, data)
+        return len(data)
+
+    def read(self, size=1):
+        return self._connection.read_stream(CHANNEL_CDC, size)
+
+
+class _HostBulk(object):
+    def __init__(self, connection):
+        self._connection = connection
+
+    def close(self):
+        self._connection.close()
+
+    def write(self, data):
+        # Same framing as BulkDevice on the vendor endpoints
+        cmd = bytes(data[1:]).rstrip(b"\0") or b"\0"
+        self._connection.send(CHANNEL_BULK, bytes([len(cmd)]) + cmd)
+
+    def read(self, size):
+        frame_size = self._connection.read_stream(CHANNEL_BULK, 1)[0]
+        return self._connection.read_stream(CHANNEL_BULK, frame_size)[:size]
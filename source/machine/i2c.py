@@ -32,8 +32,13 @@ class I2C(object):
             raise RuntimeError("I2c deinit error.")
 
     # MicroPython I2C methods
-    def scan(self):
-        return self._i2c_scan()
+    def scan(self, *, start=0x08, end=0x77, read_probe=None, timeout_us=0):
+        """Addresses acknowledged between start and end, probed by the firmware in one report. read_probe: addresses
+        probed by a 1-byte read instead of a 1-byte write, by default the EEPROM ranges (0x30-0x37, 0x50-0x5F) like
+        i2cdetect. timeout_us: timeout of each probe, 0: from the frequency."""
+        if read_probe is None:
+            read_probe = list(range(0x30, 0x38)) + list(range(0x50, 0x60))
+        return self._i2c_scan(start, end, read_probe, timeout_us)
 
     def readfrom(self, addr, nbytes, stop=True):
         buf = bytearray(nbytes)
@@ -49,19 +54,91 @@ class I2C(object):
     def writevto(self, addr, vector, stop=True):
         raise RuntimeError('Not implemented')
 
+    def writeto_then_readfrom(self, addr, out_buffer, in_buffer):
+        """Write then read after a repeated start, in one transaction and one report (reads up to 62 bytes)."""
+        in_buffer[:] = self._i2c_write_read_list([(addr, bytes(out_buffer), len(in_buffer))])[0]
+
     # MicroPython I2C convenient methods
-    def readfrom_mem(self, addr, memaddr, nbytes):
-        self.writeto(addr, bytes([memaddr]), False)
-        return self.readfrom(addr, nbytes, True)
+    def readfrom_mem(self, addr, memaddr, nbytes, *, addrsize=8):
+        buf = bytearray(nbytes)
+        self.readfrom_mem_into(addr, memaddr, buf, addrsize=addrsize)
+        return buf
 
-    def readfrom_mem_into(self, addr, memaddr, buf):
-        self.writeto(addr, bytes([memaddr]), False)
-        return self.readfrom_into(addr, buf, True)
+    def readfrom_mem_into(self, addr, memaddr, buf, *, addrsize=8):
+        memaddr = memaddr.to_bytes(addrsize // 8, byteorder='big')
+        if len(buf) > report_const.HID_REPORT_SIZE - 2:
+            # EEPROM dump, FIFO: one transaction, data returned on CDC
+            return self._i2c_read_stream(addr, buf, memaddr)
+        buf[:] = self._i2c_write_read_list([(addr, memaddr, len(buf))])[0]
+
+    def readfrom_mem_list(self, requests):
+        """Register blocks of several devices read with few reports: requests is a list of (addr, memaddr, nbytes),
+        memaddr being an int (1 byte) or bytes. Each block is one transaction (repeated start), the blocks of a report
+        run one after the other in the firmware. Returns the list of the blocks read."""
+        entries = []
+        for addr, memaddr, nbytes in requests:
+            if isinstance(memaddr, int):
+                memaddr = bytes([memaddr])
+            entries.append((addr, bytes(memaddr), nbytes))
+        return self._i2c_write_read_list(entries)
 
     def writeto_mem(self, addr, memaddr, buf, stop=True):
         return self.writeto(addr, bytes([memaddr]) + bytes(buf), stop)
 
+    def program_eeprom(self, addr, memaddr, data, *, page_size=16, addrsize=8, verify=True,
+                       busy_timeout_ms=20, progress=None):
+        """Program an I2C EEPROM: the firmware writes the pages, polls the end of their write cycle (ACK) and reads
+        them back if verify. addrsize: memory address size in bits. progress(nb_bytes_done) is called every 64 KiB.
+        Returns the number of bytes programmed.
+        """
+        report_id = (
+            report_const.I2C0_MEM_PROGRAM
+            if self.i2c_index == 0
+            else report_const.I2C1_MEM_PROGRAM
+        )
+        report = (
+            bytes([report_id])
+            + memaddr.to_bytes(4, byteorder='little')
+            + len(data).to_bytes(4, byteorder='little')
+            + page_size.to_bytes(2, byteorder='little')
+            + bytes([addrsize // 8])
+            + busy_timeout_ms.to_bytes(2, byteorder='little')
+            + bytes([0x01 if verify else 0x00, addr])
+        )
+        return self._device.program_memory(report, data, progress)
+
+    def set_timeout(self, timeout_us=0):
+        """Timeout of each transfer, after which the firmware clears the bus and the call raises. 0: computed from
+        the number of bytes and the frequency."""
+        report_id = (
+            report_const.I2C0_SET_TIMEOUT
+            if self.i2c_index == 0
+            else report_const.I2C1_SET_TIMEOUT
+        )
+        res = self._device.send_report(bytes([report_id]) + timeout_us.to_bytes(4, byteorder='little'))
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C set timeout error.")
+
+    def bus_clear(self):
+        """Clock SCL until a stuck slave releases SDA, then send a STOP. Returns True if SDA is released."""
+        report_id = (
+            report_const.I2C0_BUS_CLEAR
+            if self.i2c_index == 0
+            else report_const.I2C1_BUS_CLEAR
+        )
+        res = self._device.send_report(bytes([report_id]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C bus clear error.")
+        return res[2] == 0x01
+
     # Internal methods
+    @staticmethod
+    def _check_transfer(res, operation):
+        if res[1] == report_const.TIMEOUT:
+            raise RuntimeError("I2C %s timeout (bus cleared)." % operation)
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C %s error." % operation)
+
     def _i2c_configure(self, baudrate=100000, pullup=False):
         res = self._device.send_report(
             bytes(
@@ -77,26 +154,91 @@ class I2C(object):
         if res[1] != report_const.OK:
             raise RuntimeError("I2C init error.")
 
-    def _i2c_scan(self, start=0, end=0x79):
-        found = []
-        for addr in range(start, end + 1):
-            try:
-                self._i2c_writeto(addr, b"\x00\x00\x00")
-            except RuntimeError:
-                continue
-            found.append(addr)
-        return found
+    def _i2c_scan(self, start, end, read_probe, timeout_us):
+        report_id = (
+            report_const.I2C0_SCAN
+            if self.i2c_index == 0
+            else report_const.I2C1_SCAN
+        )
+        if not 0 <= start <= end <= 0x7F:
+            raise ValueError("I2C scan range must be within 0x00-0x7F.")
+        read_mask = 0
+        for addr in read_probe:
+            read_mask |= 1 << addr
+        res = self._device.send_report(
+            bytes([report_id, start, end])
+            + timeout_us.to_bytes(2, byteorder='little')
+            + read_mask.to_bytes(16, byteorder='little')
+        )
+        if res[1] == report_const.TIMEOUT:
+            raise RuntimeError("I2C scan timeout at 0x%02x (bus cleared)." % res[18])
+        self._check_transfer(res, "scan")
+        bitmap = int.from_bytes(bytes(res[2:18]), byteorder='little')
+        return [addr for addr in range(start, end + 1) if bitmap & (1 << addr)]
+
+    def _i2c_write_read_list(self, entries):
+        """entries: list of (addr, out_bytes, nbytes), packed in I2Cx_WRITE_READ_LIST reports."""
+        report_id = (
+            report_const.I2C0_WRITE_READ_LIST
+            if self.i2c_index == 0
+            else report_const.I2C1_WRITE_READ_LIST
+        )
+        blocks = []
+        index = 0
+        while index < len(entries):
+            payload = b""
+            nb_entries = 0
+            nb_read = 0
+            for addr, out_bytes, nbytes in entries[index:]:
+                entry = bytes([addr, len(out_bytes), nbytes]) + out_bytes
+                if nb_entries > 0 and (2 + len(payload) + len(entry) > report_const.HID_REPORT_SIZE
+                                       or nb_read + nbytes > report_const.HID_REPORT_SIZE - 2):
+                    break
+                payload += entry
+                nb_entries += 1
+                nb_read += nbytes
+            res = self._device.send_report(bytes([report_id, nb_entries]) + payload)
+            if res[1] != report_const.OK:
+                addr = entries[index + res[2]][0] if res[2] < nb_entries else entries[index][0]
+                self._check_transfer(res, "read of 0x%02x" % addr)
+            offset = 2
+            for addr, out_bytes, nbytes in entries[index:index + nb_entries]:
+                blocks.append(bytes(res[offset:offset + nbytes]))
+                offset += nbytes
+            index += nb_entries
+        return blocks
+
+    def _i2c_read_stream(self, addr, buf, out_bytes=b""):
+        report_id = (
+            report_const.I2C0_READ_TO_STREAM
+            if self.i2c_index == 0
+            else report_const.I2C1_READ_TO_STREAM
+        )
+        nb_bytes = len(buf)
+        res = self._device.send_report(
+            bytes([report_id, addr]) + nb_bytes.to_bytes(4, byteorder='little') + bytes([len(out_bytes)]) + out_bytes
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C read error.")
+        # NB_BYTES are sent whatever the result, zeros after an error
+        received = self._device.read_serial(nb_bytes)
+        res = self._device.read_hid(report_id)
+        self._check_transfer(res, "read")
+        if len(received) != nb_bytes:
+            raise RuntimeError("I2C read error.")
+        buf[:] = received
 
     def _i2c_readfrom_into(self, addr, buf, stop=True):
         read_size = len(buf)
+        if stop and read_size > report_const.HID_REPORT_SIZE - 2:
+            return self._i2c_read_stream(addr, buf)
         report_id = (
             report_const.I2C0_READ if self.i2c_index == 0 else report_const.I2C1_READ
         )
         res = self._device.send_report(
             bytes([report_id, addr, 0x01 if stop else 0x00, read_size])
         )
-        if res[1] != report_const.OK:
-            raise RuntimeError("I2C read error.")
+        self._check_transfer(res, "read")
         for i in range(read_size):
             buf[i] = res[i + 2]
 
@@ -125,8 +267,7 @@ class I2C(object):
 
         self._device.write_serial(buf)
         res = self._device.read_hid(report_id)
-        if res[1] != report_const.OK:
-            raise RuntimeError("I2C write error.")
+        self._check_transfer(res, "write")
 
     def _i2c_writeto_direct(self, addr, buf, stop=True):
         report_id = (
@@ -143,7 +284,6 @@ class I2C(object):
                 + remain_bytes.to_bytes(4, byteorder='little')
                 + buf[start : (start + chunk)]
             )
-            if res[1] != report_const.OK:
-                raise RuntimeError("I2C write error.")
+            self._check_transfer(res, "write")
 
             start += chunk
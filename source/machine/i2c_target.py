@@ -0,0 +1,84 @@
+from .u2if import Device
+from . import u2if_const as report_const
+
+
+class I2CTarget(object):
+    """I2C0 or I2C1 in target (slave) mode, emulating a peripheral at addr: the firmware serves the transactions of the
+    bus master from a map of 256 registers (1 byte register address, auto-increment), the host loads and reads it and
+    gets the registers written by the master. Writes to the registers of read_only are ignored.
+
+        target = I2CTarget(i2c_index=1, addr=0x42, read_only=[0x0F])
+        target.write_registers(0x0F, b"\\xA5")       # WHO_AM_I
+        nb_writes, changed = target.changes(wait=True)
+        config = target.read_registers(0x20, 4)
+    """
+    NB_REGISTERS = 256
+
+    def __init__(self, *, i2c_index=0, addr=0x42, pullup=False, read_only=(), serial_number_str=None):
+        self.i2c_index = i2c_index
+        self.addr = addr
+        self._initialized = False
+        self._device = Device(serial_number_str=serial_number_str)
+        read_only_mask = 0
+        for reg in read_only:
+            read_only_mask |= 1 << reg
+        res = self._device.send_report(
+            bytes([report_const.I2C_TARGET_INIT, i2c_index, addr, 0x01 if pullup else 0x00])
+            + read_only_mask.to_bytes(self.NB_REGISTERS // 8, byteorder='little')
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C target init error (bus used by I2C?).")
+        self._initialized = True
+
+    def __del__(self):
+        self.deinit()
+
+    def deinit(self):
+        if not self._initialized:
+            return
+        res = self._device.send_report(bytes([report_const.I2C_TARGET_DEINIT]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C target deinit error.")
+        self._initialized = False
+
+    def write_registers(self, first, data):
+        """Registers from first, updated at once (a bus master never reads a value half written)."""
+        data = bytes(data)
+        self._check_range(first, len(data))
+        report_id = report_const.I2C_TARGET_WRITE_MAP
+        res = self._device.send_report(bytes([report_id, first]) + len(data).to_bytes(2, byteorder='little'))
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C target write error.")
+        self._device.write_serial(data)
+        res = self._device.read_hid(report_id)
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C target write error.")
+
+    def read_registers(self, first=0, nbytes=NB_REGISTERS):
+        """Registers from first, read at once."""
+        self._check_range(first, nbytes)
+        report_id = report_const.I2C_TARGET_READ_MAP
+        res = self._device.send_report(bytes([report_id, first]) + nbytes.to_bytes(2, byteorder='little'))
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C target read error.")
+        data = self._device.read_serial(nbytes)
+        res = self._device.read_hid(report_id)
+        if res[1] != report_const.OK or len(data) != nbytes:
+            raise RuntimeError("I2C target read error.")
+        return bytes(data)
+
+    def changes(self, wait=False):
+        """(number of write transactions, registers written) by the bus master since the previous call. wait: until
+        the next write transaction if there is none (raises on the command timeout, Device.set_command_timeout())."""
+        res = self._device.send_report(bytes([report_const.I2C_TARGET_GET_CHANGES, 0x01 if wait else 0x00]))
+        if res[1] == report_const.TIMEOUT:
+            raise RuntimeError("I2C target: no write before the command timeout.")
+        if res[1] != report_const.OK:
+            raise RuntimeError("I2C target changes error.")
+        nb_writes = int.from_bytes(bytes(res[2:4]), byteorder='little')
+        changed = int.from_bytes(bytes(res[4:4 + self.NB_REGISTERS // 8]), byteorder='little')
+        return nb_writes, [reg for reg in range(self.NB_REGISTERS) if changed & (1 << reg)]
+
+    def _check_range(self, first, nbytes):
+        if nbytes <= 0 or first < 0 or first + nbytes > self.NB_REGISTERS:
+            raise ValueError("I2C target registers must be within 0x00-0xFF.")
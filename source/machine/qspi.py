@@ -0,0 +1,82 @@
+from .u2if import Device
+from . import u2if_const as report_const
+
+
+class QSPI(object):
+    """Quad-SPI master on a PIO state machine (mode 0). A transaction has a command, address, dummy cycles and data
+    phases, each of 1, 2 or 4 lanes (IO0 to IO3 on consecutive GPIOs, IO1 is MISO with 1 lane). The data of write()
+    are streamed from CDC.
+
+        qspi = QSPI(sck=Pin(2), io0=Pin(3), cs=Pin(7), baudrate=40_000_000)
+        qspi.write(pixels, command=0x32, address=0x002C00, address_bytes=3, data_lanes=4)
+        jedec_id = qspi.read(3, command=0x9F)
+    """
+
+    def __init__(self, sck, io0, cs=None, baudrate=10000000, serial_number_str=None):
+        self._initialized = False
+        self._device = Device(serial_number_str=serial_number_str)
+        self._pins = [getattr(pin, "id", pin) for pin in (sck, io0)]
+        self._pins.append(0xFF if cs is None else getattr(cs, "id", cs))
+        self._baudrate = baudrate
+        self.init()
+
+    def __del__(self):
+        self.deinit()
+
+    def init(self):
+        res = self._device.send_report(
+            bytes([report_const.QSPI_INIT] + self._pins) + self._baudrate.to_bytes(4, byteorder='little')
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("QSPI init error (no free PIO state machine?).")
+        self._initialized = True
+
+    def deinit(self):
+        if not self._initialized:
+            return
+        res = self._device.send_report(bytes([report_const.QSPI_DEINIT]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("QSPI deinit error.")
+        self._initialized = False
+
+    def write(self, data=b"", *, command=None, command_lanes=1, address=None, address_bytes=3, address_lanes=1,
+              dummy_cycles=0, data_lanes=4):
+        """Transaction with a data phase written from the CDC stream. Phases are skipped when command or address
+        is None, or dummy_cycles or data is empty."""
+        report_id = report_const.QSPI_WRITE
+        data = bytes(data)
+        res = self._device.send_report(
+            self._header(report_id, command, command_lanes, address, address_bytes, address_lanes, dummy_cycles,
+                         data_lanes, len(data))
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("QSPI write error.")
+        if data:
+            self._device.write_serial(data)
+            res = self._device.read_hid(report_id)
+            if res[1] != report_const.OK:
+                raise RuntimeError("QSPI write error.")
+
+    def read(self, nbytes, *, command=None, command_lanes=1, address=None, address_bytes=3, address_lanes=1,
+             dummy_cycles=0, data_lanes=1):
+        """Transaction with a data phase read by the firmware (up to 62 bytes)."""
+        if nbytes > report_const.HID_REPORT_SIZE - 2:
+            raise ValueError("QSPI reads are limited to %d bytes." % (report_const.HID_REPORT_SIZE - 2))
+        res = self._device.send_report(
+            self._header(report_const.QSPI_READ, command, command_lanes, address, address_bytes, address_lanes,
+                         dummy_cycles, data_lanes, nbytes)
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("QSPI read error.")
+        return bytes(res[2:2 + nbytes])
+
+    @staticmethod
+    def _header(report_id, command, command_lanes, address, address_bytes, address_lanes, dummy_cycles, data_lanes,
+                nb_bytes):
+        return (
+            bytes([report_id, 0 if command is None else command_lanes, command or 0])
+            + bytes([address_lanes, 0 if address is None else address_bytes])
+            + (address or 0).to_bytes(4, byteorder='little')
+            + bytes([dummy_cycles, data_lanes])
+            + nb_bytes.to_bytes(4, byteorder='little')
+        )
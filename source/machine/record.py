@@ -0,0 +1,91 @@
+"""Record the HID reports and CDC data exchanged with the firmware, to replay them as a benchmark (see replay.py).
+
+    device = Device()
+    device.record_start("workload.u2if")
+    ...  # workload
+    device.record_stop()
+
+or, without modifying a script: U2IF_RECORD=workload.u2if python3 examples/hub75_64x32.py
+
+The file has one JSON object per line: {"t": seconds since the start, "op": operation, ...}
+ - hid_write: "data" hex of the 64 bytes report
+ - hid_read: "id" report ID of the response read (-1 on read timeout)
+ - cdc_write: "data" hex of the bytes
+ - cdc_read: "size" number of bytes read
+"""
+import json
+import time
+
+OP_HID_WRITE = "hid_write"
+OP_HID_READ = "hid_read"
+OP_CDC_WRITE = "cdc_write"
+OP_CDC_READ = "cdc_read"
+
+
+class Recorder(object):
+    def __init__(self, path):
+        self._file = open(path, "w")
+        self._start = time.perf_counter()
+
+    def close(self):
+        self._file.close()
+
+    def add(self, op, **values):
+        line = {"t": round(time.perf_counter() - self._start, 6), "op": op}
+        line.update(values)
+        self._file.write(json.dumps(line) + "\n")
+
+
+class RecordingHid(object):
+    """hid.Device (or BulkDevice) that records its writes and reads."""
+
+    def __init__(self, hid, recorder):
+        self.wrapped = hid
+        self._recorder = recorder
+
+    def __getattr__(self, name):
+        return getattr(self.wrapped, name)
+
+    def write(self, data):
+        # First byte is the HID report number
+        self._recorder.add(OP_HID_WRITE, data=bytes(data[1:]).hex())
+        return self.wrapped.write(data)
+
+    def read(self, size, *args, **kwargs):
+        res = self.wrapped.read(size, *args, **kwargs)
+        self._recorder.add(OP_HID_READ, id=res[0] if res else -1)
+        return res
+
+
+class RecordingSerial(object):
+    """serial.Serial that records its writes and reads."""
+
+    def __init__(self, serial, recorder):
+        self.wrapped = serial
+        self._recorder = recorder
+
+    def __getattr__(self, name):
+        return getattr(self.wrapped, name)
+
+    def write(self, data):
+        self._recorder.add(OP_CDC_WRITE, data=bytes(data).hex())
+        return self.wrapped.write(data)
+
+    def read(self, size=1):
+        res = self.wrapped.read(size)
+        self._recorder.add(OP_CDC_READ, size=len(res))
+        return res
+
+
+def load(path):
+    """Return the recorded operations: list of dict, data decoded to bytes."""
+    ops = []
+    with open(path) as file:
+        for line in file:
+            if not line.strip():
+                continue
+            op = json.loads(line)
+            if "data" in op:
+                op["data"] = bytes.fromhex(op["data"])
+            ops.append(op)
+    return ops
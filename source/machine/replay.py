@@ -0,0 +1,117 @@
+"""Replay a recording of record.py against a board or the firmware host build, as a performance test.
+
+    python3 -m machine.replay workload.u2if [--pace original] [--repeat 10] [--transport host]
+
+The HID reports and CDC data are sent again in the recorded order, and as many HID reports and CDC bytes
+are read as during the recording. At maximum rate (default), an operation starts as soon as the previous
+one ends. With the original pacing, each operation waits for its recorded time.
+The result gives commands/s, CDC bytes/s and the command latency percentiles: time from the report
+write to the read of its response (first response with the same report ID, or the same tag for SYS_TAGGED).
+"""
+import argparse
+import time
+from collections import deque
+from . import record
+from . import u2if_const as report_const
+from .u2if import Device
+
+PACE_MAX = "max"
+PACE_ORIGINAL = "original"
+PERCENTILES = (50, 90, 99)
+
+
+def _response_key(report):
+    if report[0] == report_const.SYS_TAGGED:
+        return report[0], report[1]
+    return report[0]
+
+
+def _percentile(sorted_values, percent):
+    # Nearest rank
+    if not sorted_values:
+        return None
+    rank = max(0, -(-len(sorted_values) * percent // 100) - 1)
+    return sorted_values[rank]
+
+
+def replay(ops, device=None, pace=PACE_MAX, repeat=1):
+    """Replay ops (record.load()) and return the measures as a dict, latencies in us."""
+    device = device or Device()
+    hid = device._hid
+    serial = device._serial
+    in_flight = {}
+    latencies = []
+    nb_commands = 0
+    nb_cdc_bytes = 0
+
+    start = time.perf_counter()
+    for _ in range(repeat):
+        loop_start = time.perf_counter()
+        for op in ops:
+            if pace == PACE_ORIGINAL:
+                delay = loop_start + op["t"] - time.perf_counter()
+                if delay > 0:
+                    time.sleep(delay)
+
+            if op["op"] == record.OP_HID_WRITE:
+                hid.write(b"\0" + op["data"])
+                in_flight.setdefault(_response_key(op["data"]), deque()).append(time.perf_counter())
+                nb_commands += 1
+            elif op["op"] == record.OP_HID_READ:
+                if op["id"] < 0:
+                    continue  # read timeout of the recording, nothing to read
+                res = hid.read(report_const.HID_REPORT_SIZE)
+                sent = in_flight.get(_response_key(res))
+                if sent:
+                    latencies.append((time.perf_counter() - sent.popleft()) * 1e6)
+            elif op["op"] == record.OP_CDC_WRITE:
+                serial.write(op["data"])
+                nb_cdc_bytes += len(op["data"])
+            elif op["op"] == record.OP_CDC_READ:
+                nb_cdc_bytes += len(serial.read(op["size"]))
+        serial.flush()
+    elapsed = time.perf_counter() - start
+
+    latencies.sort()
+    result = {
+        "elapsed_s": elapsed,
+        "commands": nb_commands,
+        "commands_per_s": nb_commands / elapsed if elapsed > 0 else 0.0,
+        "cdc_bytes": nb_cdc_bytes,
+        "cdc_bytes_per_s": nb_cdc_bytes / elapsed if elapsed > 0 else 0.0,
+        "latency_max_us": latencies[-1] if latencies else None,
+    }
+    for percent in PERCENTILES:
+        result["latency_p%d_us" % percent] = _percentile(latencies, percent)
+    return result
+
+
+def format_result(result):
+    lines = [
+        "elapsed      %.3f s" % result["elapsed_s"],
+        "commands     %d (%.0f/s)" % (result["commands"], result["commands_per_s"]),
+        "cdc bytes    %d (%.0f B/s)" % (result["cdc_bytes"], result["cdc_bytes_per_s"]),
+    ]
+    if result["latency_max_us"] is not None:
+        lines.append("latency us   " + "  ".join(
+            ["p%d %.0f" % (percent, result["latency_p%d_us" % percent]) for percent in PERCENTILES]
+            + ["max %.0f" % result["latency_max_us"]]))
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay a u2if recording (machine.record) as a benchmark.")
+    parser.add_argument("path")
+    parser.add_argument("--pace", choices=(PACE_MAX, PACE_ORIGINAL), default=PACE_MAX)
+    parser.add_argument("--repeat", type=int, default=1)
+    parser.add_argument("--transport", choices=("hid", "bulk", "host", "host_bulk"), default="hid")
+    parser.add_argument("--address", help="host:port of the firmware host build")
+    parser.add_argument("--serial-number", help="board S/N when several are connected")
+    args = parser.parse_args()
+
+    device = Device(serial_number_str=args.serial_number, transport=args.transport, address=args.address)
+    print(format_result(replay(record.load(args.path), device, args.pace, args.repeat)))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,8 +1,28 @@
+import threading
 from .u2if import Device
 from . import u2if_const as report_const
 
 
 class SPI(object):
+    MSB = 0
+    LSB = 1
+    # Bytes of a SPIx_DEVICE_TRANSFER report, longer transfers are streamed
+    _DEVICE_PAYLOAD_SIZE = 59
+    # Entries of write_display(): DC pin level
+    COMMAND = 0
+    DATA = 1
+    # Bytes of the SPIx_DISPLAY_WRITE command list in one report
+    _DISPLAY_LIST_SIZE = 57
+    # program_flash() opcodes, 25xx NOR flash with 3 bytes addresses (4 bytes: program 0x12, read 0x13, erase 0x21)
+    FLASH_OPCODES = {
+        "write_enable": 0x06,
+        "program": 0x02,
+        "read_status": 0x05,
+        "busy_mask": 0x01,
+        "read": 0x03,
+        "erase": 0x20,
+    }
+
     def __init__(self, *, spi_index=0, serial_number_str=None):
         self.spi_index = spi_index
         self._initialized = False
@@ -11,11 +31,11 @@ class SPI(object):
     def __del__(self):
         self.deinit()
 
-    def init(self, baudrate=1000000):
+    def init(self, baudrate=1000000, *, polarity=0, phase=0):
         report_id = (
             report_const.SPI0_INIT if self.spi_index == 0 else report_const.SPI1_INIT
         )
-        mode = 0x00  # to implement
+        mode = (polarity << 1) | phase
         res = self._device.send_report(
             bytes([report_id, mode]) + baudrate.to_bytes(4, byteorder='little')
         )
@@ -35,22 +55,130 @@ class SPI(object):
         if res[1] != report_const.OK:
             raise RuntimeError("SPI deinit error.")
 
-    def read(self, nbytes, write=0):
+    def configure_device(self, device, cs=None, baudrate=1000000, *, polarity=0, phase=0, bits=8, firstbit=MSB,
+                         cs_active_high=False):
+        """Describe a device of the bus (device: 1 to 4) for read/write(..., device=device): the firmware only
+        changes the baudrate and format when the addressed device changes, and drives its CS (Pin or GPIO number,
+        None: no CS) around each transfer. With bits over 8, the buffers hold 16-bit little endian frames.
+        """
+        report_id = (
+            report_const.SPI0_DEVICE_CONFIG
+            if self.spi_index == 0
+            else report_const.SPI1_DEVICE_CONFIG
+        )
+        flags = (0x01 if cs_active_high else 0x00) | (0x02 if firstbit == SPI.LSB else 0x00)
+        res = self._device.send_report(
+            bytes([report_id, device, 0xFF if cs is None else getattr(cs, "id", cs), flags, (polarity << 1) | phase, bits])
+            + baudrate.to_bytes(4, byteorder='little')
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("SPI device config error.")
+
+    def read(self, nbytes, write=0, *, device=0, keep_cs=False):
         buf = bytearray(nbytes)
-        self.readfrom_into(buf, write)
+        self.readinto(buf, write, device=device, keep_cs=keep_cs)
         return buf
 
-    def readinto(self, buf, write=0):
+    def readinto(self, buf, write=0, *, device=0, keep_cs=False):
+        if device or keep_cs:
+            return self._spi_device_transfer(device, buf, write_byte=write, keep_cs=keep_cs)
         return self._read_from_into(buf, write)
 
-    def write(self, buf):
+    def write(self, buf, *, device=0, keep_cs=False):
+        """keep_cs: CS left asserted for the next transfer of the device (up to 59 bytes)."""
+        if device or keep_cs:
+            return self._spi_device_transfer(device, None, write_buf=buf, keep_cs=keep_cs)
         return self._spi_write(buf)
 
-    def write_readinto(self, write_buf, read_buf):
-        raise RuntimeError('Not implemented')
+    def write_readinto(self, write_buf, read_buf, *, device=0, keep_cs=False):
+        if len(write_buf) != len(read_buf):
+            raise ValueError("Buffers must have the same length.")
+        if device or keep_cs:
+            return self._spi_device_transfer(device, read_buf, write_buf=write_buf, keep_cs=keep_cs)
+        self._spi_transfer_stream(read_buf, write_buf=write_buf)
+
+    def display_pins(self, cs=None, dc=None):
+        """Bind the CS and DC pins (Pin or GPIO number) driven by the firmware in write_display()."""
+        report_id = (
+            report_const.SPI0_DISPLAY_PINS
+            if self.spi_index == 0
+            else report_const.SPI1_DISPLAY_PINS
+        )
+        pins = [0xFF if pin is None else getattr(pin, "id", pin) for pin in (cs, dc)]
+        res = self._device.send_report(bytes([report_id] + pins))
+        if res[1] != report_const.OK:
+            raise RuntimeError("SPI display pins error.")
+
+    def write_display(self, entries, data=None, frame16=False):
+        """Write a display command list, then data, with CS low and DC set by the firmware.
+
+        entries: list of (SPI.COMMAND or SPI.DATA, bytes). data: bytes written with DC high after the list,
+        as 16-bit frames if frame16 (RGB565 pixels as uint16 in CPU order, e.g. a numpy uint16 array).
+        """
+        report_id = (
+            report_const.SPI0_DISPLAY_WRITE
+            if self.spi_index == 0
+            else report_const.SPI1_DISPLAY_WRITE
+        )
+        lists = [b""]
+        for dc, buf in entries:
+            buf = bytes(buf)
+            size = self._DISPLAY_LIST_SIZE - 1
+            for start in range(0, len(buf), size):
+                entry = bytes([(dc << 7) | min(len(buf) - start, size)]) + buf[start:start + size]
+                if len(lists[-1]) + len(entry) > self._DISPLAY_LIST_SIZE:
+                    lists.append(b"")
+                lists[-1] += entry
+        data = bytes(data) if data is not None else b""
+
+        # CS is released at the end of each report: the data are sent with the last list
+        for index, cmd_list in enumerate(lists):
+            nb_bytes = len(data) if index == len(lists) - 1 else 0
+            res = self._device.send_report(
+                bytes([report_id, 0x01 if frame16 else 0x00])
+                + nb_bytes.to_bytes(4, byteorder='little')
+                + bytes([len(cmd_list)]) + cmd_list
+            )
+            if res[1] != report_const.OK:
+                raise RuntimeError("SPI display write error.")
+        if data:
+            self._device.write_serial(data)
+            res = self._device.read_hid(report_id)
+            if res[1] != report_const.OK:
+                raise RuntimeError("SPI display write error.")
+
+    def program_flash(self, cs, address, data, *, page_size=256, address_width=3, erase_size=4096,
+                      verify=True, busy_timeout_ms=1000, opcodes=None, progress=None):
+        """Program a SPI NOR flash: the firmware erases the sectors (erase_size, 0: no erase), programs the pages,
+        polls the status and reads them back if verify. cs: Pin or GPIO number. progress(nb_bytes_done) is called
+        every 64 KiB. Returns the number of bytes programmed.
+        """
+        report_id = (
+            report_const.SPI0_MEM_PROGRAM
+            if self.spi_index == 0
+            else report_const.SPI1_MEM_PROGRAM
+        )
+        ops = dict(self.FLASH_OPCODES, **(opcodes or {}))
+        if not erase_size:
+            ops["erase"] = 0x00
+        report = (
+            bytes([report_id])
+            + address.to_bytes(4, byteorder='little')
+            + len(data).to_bytes(4, byteorder='little')
+            + page_size.to_bytes(2, byteorder='little')
+            + bytes([address_width])
+            + busy_timeout_ms.to_bytes(2, byteorder='little')
+            + bytes([0x01 if verify else 0x00, getattr(cs, "id", cs)])
+            + bytes([ops["write_enable"], ops["program"], ops["read_status"], ops["busy_mask"], ops["read"], ops["erase"]])
+            + erase_size.to_bytes(4, byteorder='little')
+        )
+        return self._device.program_memory(report, data, progress)
 
     def _read_from_into(self, buf, write_byte=0):
         read_size = len(buf)
+        if read_size > report_const.HID_REPORT_SIZE - 2:
+            self._spi_transfer_stream(buf, write_byte=write_byte)
+            return
         report_id = (
             report_const.SPI0_READ if self.spi_index == 0 else report_const.SPI1_READ
         )
@@ -82,7 +210,28 @@ class SPI(object):
                 raise RuntimeError("SPI write direct error.")
             start += chunk
 
-    def _spi_write_stream(self, buf):
+    def _spi_device_transfer(self, device, read_buf, write_buf=None, write_byte=0, keep_cs=False):
+        nb_bytes = len(write_buf) if read_buf is None else len(read_buf)
+        if nb_bytes > self._DEVICE_PAYLOAD_SIZE:
+            if keep_cs:
+                raise ValueError("keep_cs transfers are limited to %d bytes." % self._DEVICE_PAYLOAD_SIZE)
+            if read_buf is None:
+                return self._spi_write_stream(write_buf, device)
+            return self._spi_transfer_stream(read_buf, write_buf=write_buf, write_byte=write_byte, device=device)
+        report_id = (
+            report_const.SPI0_DEVICE_TRANSFER
+            if self.spi_index == 0
+            else report_const.SPI1_DEVICE_TRANSFER
+        )
+        flags = (0x01 if write_buf is not None else 0x00) | (0x02 if keep_cs else 0x00)
+        payload = bytes(write_buf) if write_buf is not None else b""
+        res = self._device.send_report(bytes([report_id, device, flags, write_byte, nb_bytes]) + payload)
+        if res[1] != report_const.OK:
+            raise RuntimeError("SPI device transfer error.")
+        if read_buf is not None:
+            read_buf[:] = res[2:2 + nb_bytes]
+
+    def _spi_write_stream(self, buf, device=0):
         self._device.reset_output_serial()
         report_id = (
             report_const.SPI0_WRITE_FROM_UART
@@ -91,7 +240,7 @@ class SPI(object):
         )
         remain_bytes = len(buf)
         res = self._device.send_report(
-            bytes([report_id]) + remain_bytes.to_bytes(4, byteorder='little')
+            bytes([report_id]) + remain_bytes.to_bytes(4, byteorder='little') + bytes([device])
         )
         if res[1] != report_const.OK:
             raise RuntimeError("SPI write error.")
@@ -100,3 +249,33 @@ class SPI(object):
         res = self._device.read_hid(report_id)
         if res[1] != report_const.OK:
             raise RuntimeError("SPI write error.")
+
+    def _spi_transfer_stream(self, read_buf, write_buf=None, write_byte=0, device=0):
+        # Full-duplex: TX bytes from write_buf (or write_byte repeated), RX bytes returned on CDC
+        report_id = (
+            report_const.SPI0_TRANSFER_STREAM
+            if self.spi_index == 0
+            else report_const.SPI1_TRANSFER_STREAM
+        )
+        nb_bytes = len(read_buf)
+        if nb_bytes == 0:
+            return
+        fill = 1 if write_buf is None else 0
+        res = self._device.send_report(
+            bytes([report_id]) + nb_bytes.to_bytes(4, byteorder='little') + bytes([fill, write_byte, device])
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("SPI transfer error.")
+
+        writer = None
+        if write_buf is not None:
+            # Written while reading: the firmware stops clocking when the RX bytes are not read
+            writer = threading.Thread(target=self._device.write_serial, args=(bytes(write_buf),))
+            writer.start()
+        received = self._device.read_serial(nb_bytes)
+        if writer is not None:
+            writer.join()
+        res = self._device.read_hid(report_id)
+        if res[1] != report_const.OK or len(received) != nb_bytes:
+            raise RuntimeError("SPI transfer error.")
+        read_buf[:] = received
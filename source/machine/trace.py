@@ -0,0 +1,125 @@
+"""Convert a firmware events trace (Device.read_trace()) to a Chrome/Perfetto JSON timeline.
+
+    device = Device()
+    device.trace_start()
+    ...  # workload
+    device.trace_stop()
+    events = device.read_trace()
+    trace.save_chrome_trace(events, "u2if_trace.json", trace.interface_names(device.get_stats()))
+
+Open the file in chrome://tracing or https://ui.perfetto.dev
+"""
+import json
+from . import u2if_const as report_const
+
+_REPORT_PREFIXES = (
+    "SYS_", "GPIO_", "GROUP_GPIO_", "PWM_", "ADC_", "UART0_", "UART1_", "SPI0_", "SPI1_",
+    "I2C0_", "I2C1_", "WS2812B_", "I2S_", "HUB75_", "FREQ_COUNTER_",
+)
+
+_PID = 1
+_TID_USB = 1
+_TID_COMMANDS = 2
+_TID_LOOP = 3
+_TID_INTERFACES = 100  # + interface index, DMA: + 100
+
+
+def report_names():
+    """Report ID => name, from u2if_const."""
+    names = {}
+    for name, value in vars(report_const).items():
+        if name.startswith(_REPORT_PREFIXES) and not name.endswith("_OFFSET") and isinstance(value, int):
+            names.setdefault(value, name)
+    return names
+
+
+def interface_names(stats):
+    """Interface index => name, from Device.get_stats() (first report ID of each interface)."""
+    names = report_names()
+    result = {}
+    for index, interface in enumerate(stats["interfaces"]):
+        name = names.get(interface["first_report_id"])
+        prefixes = [prefix for prefix in _REPORT_PREFIXES if name and name.startswith(prefix)]
+        # Report name without the command: WS2812B_INIT => WS2812B
+        result[index] = max(prefixes, key=len)[:-1] if prefixes else "INTERFACE_%d" % index
+    return result
+
+
+def _unwrap_times(events):
+    # 32 bits us timer, events are in order
+    offset = 0
+    last = None
+    for event in events:
+        if last is not None and event["time_us"] < last:
+            offset += 1 << 32
+        last = event["time_us"]
+        yield event["time_us"] + offset, event
+
+
+def to_chrome_trace(events, names=None):
+    """Return the Chrome trace event format dict of events (list of dict from Device.read_trace())."""
+    names = names or {}
+    reports = report_names()
+
+    def report(report_id):
+        return reports.get(report_id, "0x%02X" % report_id)
+
+    def interface(index):
+        return names.get(index, "INTERFACE_%d" % index)
+
+    trace_events = []
+    threads = {_TID_USB: "USB", _TID_COMMANDS: "Commands", _TID_LOOP: "Main loop"}
+
+    def add(ph, name, ts, tid, args=None):
+        trace_event = {"name": name, "ph": ph, "ts": ts, "pid": _PID, "tid": tid}
+        if ph == "i":
+            trace_event["s"] = "t"
+        if args:
+            trace_event["args"] = args
+        trace_events.append(trace_event)
+
+    start = None
+    for ts, event in _unwrap_times(events):
+        if start is None:
+            start = ts
+        ts -= start
+        kind, ident, arg = event["type"], event["id"], event["arg"]
+        if kind == report_const.TRACE_CMD_RECEIVED:
+            add("i", "received " + report(ident), ts, _TID_USB, {"transport": "bulk" if arg else "hid"})
+        elif kind == report_const.TRACE_CMD_START:
+            add("B", report(ident), ts, _TID_COMMANDS)
+        elif kind == report_const.TRACE_CMD_END:
+            add("E", report(ident), ts, _TID_COMMANDS, {"status": arg})
+        elif kind in (report_const.TRACE_TASK_START, report_const.TRACE_TASK_END):
+            threads[_TID_INTERFACES + ident] = interface(ident)
+            if kind == report_const.TRACE_TASK_START:
+                add("B", "task", ts, _TID_INTERFACES + ident)
+            else:
+                add("E", "task", ts, _TID_INTERFACES + ident, {"status": arg})
+        elif kind == report_const.TRACE_DMA_START:
+            threads[_TID_INTERFACES + 100 + ident] = interface(ident) + " DMA"
+            add("B", "dma", ts, _TID_INTERFACES + 100 + ident, {"words": arg})
+        elif kind == report_const.TRACE_DMA_END:
+            threads[_TID_INTERFACES + 100 + ident] = interface(ident) + " DMA"
+            add("E", "dma", ts, _TID_INTERFACES + 100 + ident)
+        elif kind == report_const.TRACE_CDC_READ:
+            threads[_TID_INTERFACES + ident] = interface(ident)
+            add("i", "cdc read", ts, _TID_INTERFACES + ident, {"bytes": arg})
+        elif kind == report_const.TRACE_RESPONSE_QUEUED:
+            add("i", "queued " + report(ident), ts, _TID_USB, {"level": arg})
+        elif kind == report_const.TRACE_RESPONSE_SENT:
+            add("i", "sent " + report(ident), ts, _TID_USB, {"transport": "bulk" if arg else "hid"})
+        elif kind == report_const.TRACE_SLEEP:
+            add("B", "sleep", ts, _TID_LOOP)
+        elif kind == report_const.TRACE_WAKE:
+            add("E", "sleep", ts, _TID_LOOP)
+
+    for tid, name in threads.items():
+        trace_events.append({"name": "thread_name", "ph": "M", "pid": _PID, "tid": tid, "args": {"name": name}})
+    trace_events.append({"name": "process_name", "ph": "M", "pid": _PID, "args": {"name": "u2if"}})
+    return {"traceEvents": trace_events, "displayTimeUnit": "ms"}
+
+
+def save_chrome_trace(events, path, names=None):
+    with open(path, "w") as f:
+        json.dump(to_chrome_trace(events, names), f)
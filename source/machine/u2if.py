@@ -1,12 +1,20 @@
+import atexit
+import os
+import threading
 import time
-import hid
+from collections import deque
+try:
+    import hid
+except ImportError:  # hidapi library not installed: only the host transport can be used
+    hid = None
 import serial
 from . import helper
 from . import u2if_const as report_const
 
 COMPATIBLE_BOARD_PID_VID = [
     # (VID, PID)
-    (0xCAFE, 0x4005),  # pico
+    (0xCAFE, 0x4015),  # pico
+    (0xCAFE, 0x4005),  # pico (older firmware without bulk command channel)
     (0x239A, 0x00F1),  # Adafruit Feather
     (0x239A, 0x8130),  # Adafruit Feather CAN Bus
     (0x239A, 0x812C),  # Adafruit Feather ThinkInk
@@ -19,19 +27,53 @@ COMPATIBLE_BOARD_PID_VID = [
 
 
 class Device(metaclass=helper.Singleton):
-    def __init__(self, serial_number_str=None):
+    def __init__(self, serial_number_str=None, transport="hid", address=None):
+        """transport: "hid" or "bulk" (vendor bulk endpoints, needs pyusb) to send the commands.
+
+        "host" and "host_bulk" use the firmware host build (firmware/host) listening on address
+        ("host:port", default localhost:4015) instead of a board.
+        """
+        if transport in ("host", "host_bulk"):
+            self._open_host(address, bulk=transport == "host_bulk")
+        else:
+            self._open_usb(serial_number_str, bulk=transport == "bulk")
+        self.firmware_version = self._get_firmware_version()
+        # self._report_events_list = []
+        self._irq_event_callbacks = {}
+        self._last_tag = 0
+        self._tagged_responses = {}
+        self._recorder = None
+        if os.environ.get("U2IF_RECORD"):
+            self.record_start(os.environ["U2IF_RECORD"])
+
+    def _open_usb(self, serial_number_str, bulk):
         self.vid, self.pid, self.serial_number = self._get_compatible_board_and_reset(
             serial_number_str
         )
         if self.serial_number is None:
             raise ValueError("No board found")
         time.sleep(1)
-        self._hid = hid.Device(self.vid, self.pid, self.serial_number)
+        if bulk:
+            from .bulk import BulkDevice
+
+            self._hid = BulkDevice(self.vid, self.pid, self.serial_number)
+        else:
+            self._hid = hid.Device(self.vid, self.pid, self.serial_number)
         device = helper.find_serial_port(self.vid, self.pid, self.serial_number)
         self._serial = serial.Serial(device)
-        self.firmware_version = self._get_firmware_version()
-        # self._report_events_list = []
-        self._irq_event_callbacks = {}
+
+    def _open_host(self, address, bulk):
+        from .host import HostConnection
+
+        connection = HostConnection(address)
+        self._hid = connection.hid
+        self._reset()
+        connection.wait_closed()  # host firmware process restarted
+        connection = HostConnection(address)
+        self.vid, self.pid = None, None
+        self._hid = connection.bulk if bulk else connection.hid
+        self._serial = connection.serial
+        self.serial_number = self._get_serial_number()
 
     def _reset(self):
         res = self.send_report(bytes([report_const.SYS_RESET]), response=True)
@@ -69,10 +111,279 @@ class Device(metaclass=helper.Singleton):
             return res
         return None
 
+    def send_batch(self, commands):
+        """Execute several commands in one report.
+
+        commands is a list of (report, response_size) where response_size is the number of
+        payload bytes expected back for this command. Returns a list of (status, payload) for
+        the executed commands: execution stops after the first command that is not OK. Commands answered
+        later by the firmware (I2C transfers) are waited for, up to their timeout (set_command_timeout()).
+        """
+        report = bytes([report_const.SYS_BATCH, len(commands)])
+        for cmd, response_size in commands:
+            report += bytes([len(cmd), response_size]) + bytes(cmd)
+        if len(report) > report_const.HID_REPORT_SIZE:
+            raise ValueError("Batch too large for one report.")
+        res = self.send_report(report)
+        results = []
+        index = 3
+        for i in range(res[2]):
+            response_size = commands[i][1]
+            results.append((res[index], bytes(res[index + 1 : index + 1 + response_size])))
+            index += 1 + response_size
+        if res[1] != report_const.OK and res[2] == 0:
+            raise RuntimeError("Batch error.")
+        return results
+
+    def submit_report(self, report):
+        """Send a tagged command without waiting for its response.
+
+        Several commands can be in flight, the returned tag is given to wait_report() to get
+        the response of this command whatever the completion order. The tag takes 2 bytes of the
+        response: a command reads at most 60 bytes (e.g. I2C, SPI or QSPI reads), it is answered NOK above.
+        """
+        if len(report) > report_const.HID_REPORT_SIZE - 2:
+            raise ValueError("Tagged command is limited to 62 bytes.")
+        self._last_tag = self._last_tag % 255 + 1
+        tag = self._last_tag
+        self._tagged_responses[tag] = deque()
+        self.send_report(bytes([report_const.SYS_TAGGED, tag]) + report, response=False)
+        return tag
+
+    def wait_report(self, tag):
+        """Return the next response (64 bytes) of the tagged command."""
+        while not self._tagged_responses[tag]:
+            self._store_tagged_response(self._hid.read(report_const.HID_REPORT_SIZE))
+        res = self._tagged_responses[tag].popleft()
+        if res[1] == report_const.NOT_CONCERNED:
+            raise RuntimeError(
+                "Unknown command. Maybe the interface is not enabled in firmware."
+            )
+        return res
+
+    def set_command_timeout(self, timeout_ms, report_id=0):
+        """Set the deadline of asynchronous commands (all of them if report_id is 0, 0 ms to disable)."""
+        res = self.send_report(
+            bytes([report_const.SYS_SET_CMD_TIMEOUT, report_id])
+            + timeout_ms.to_bytes(4, byteorder='little')
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("Set command timeout error.")
+
+    def get_queue_stats(self, reset=False):
+        """Return the firmware response queue usage as a dict (counters since boot or last reset)."""
+        res = self.send_report(bytes([report_const.SYS_GET_QUEUE_STATS, 1 if reset else 0]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("Queue stats error.")
+        return {
+            "size": res[2],
+            "level": res[3],
+            "high_water": res[4],
+            "deferred_cmds": int.from_bytes(res[5:9], byteorder='little'),
+            "dropped_cmds": int.from_bytes(res[9:13], byteorder='little'),
+            "dropped_responses": int.from_bytes(res[13:17], byteorder='little'),
+        }
+
+    @staticmethod
+    def _parse_stats_duration(buf):
+        # | COUNT[4] | MAX_US[4] | TOTAL_US[8] | HISTOGRAM[4] * 8 |
+        return {
+            "count": int.from_bytes(buf[0:4], byteorder='little'),
+            "max_us": int.from_bytes(buf[4:8], byteorder='little'),
+            "total_us": int.from_bytes(buf[8:16], byteorder='little'),
+            "histogram": [int.from_bytes(buf[16 + 4 * i:20 + 4 * i], byteorder='little') for i in range(8)],
+        }
+
+    def _get_stats_section(self, section, index=0):
+        res = self.send_report(bytes([report_const.SYS_GET_STATS, section, index]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("Stats error.")
+        return res
+
+    def get_stats(self):
+        """Return the firmware performance counters as a dict (since boot or reset_stats()).
+
+        Durations are in us, histogram bucket 0 counts durations < 4 us, bucket i durations in [4^i, 4^(i+1)[ us.
+        "commands" is indexed by report ID (executed ones only), "interfaces" by interface with their first report ID.
+        """
+        res = self._get_stats_section(report_const.STATS_SUMMARY)
+        stats = {
+            "elapsed_us": int.from_bytes(res[4:12], byteorder='little'),
+            "sleep_us": int.from_bytes(res[12:20], byteorder='little'),
+            "queue_size": res[20],
+            "queue_high_water": res[21],
+        }
+        nb_interfaces = res[22]
+        cmd_mask = int.from_bytes(res[23:55], byteorder='little')
+
+        stats["loop"] = self._parse_stats_duration(self._get_stats_section(report_const.STATS_LOOP, 0)[4:])
+        stats["usb"] = self._parse_stats_duration(self._get_stats_section(report_const.STATS_LOOP, 1)[4:])
+        stats["commands"] = {}
+        for report_id in range(256):
+            if cmd_mask & (1 << report_id):
+                res = self._get_stats_section(report_const.STATS_CMD, report_id)
+                stats["commands"][report_id] = self._parse_stats_duration(res[4:])
+        stats["interfaces"] = []
+        for index in range(nb_interfaces):
+            res = self._get_stats_section(report_const.STATS_TASK, index)
+            interface_stats = self._parse_stats_duration(res[4:])
+            interface_stats["first_report_id"] = res[52]
+            interface_stats["cdc_bytes"] = int.from_bytes(res[53:61], byteorder='little')
+            stats["interfaces"].append(interface_stats)
+        return stats
+
+    def reset_stats(self):
+        """Clear the firmware performance counters and the response queue counters."""
+        res = self.send_report(bytes([report_const.SYS_RESET_STATS]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("Stats reset error.")
+
+    def bench_cdc(self, mode, nb_bytes, chunk_size=0):
+        """Measure the raw CDC throughput: mode "sink" (host to device), "source" (device to host) or "loopback".
+
+        chunk_size is the max bytes per firmware CDC read/write call (0: its buffer size). Returns a dict with the
+        firmware measures (elapsed_us from the first to the last byte, stalls waiting for the host), the host
+        elapsed time and, for source and loopback, whether the received bytes are the expected ones.
+        """
+        report_id = {
+            "sink": report_const.SYS_BENCH_CDC_SINK,
+            "source": report_const.SYS_BENCH_CDC_SOURCE,
+            "loopback": report_const.SYS_BENCH_CDC_LOOPBACK,
+        }[mode]
+        data = bytes(i & 0xFF for i in range(nb_bytes))
+        res = self.send_report(
+            bytes([report_id]) + nb_bytes.to_bytes(4, byteorder='little') + chunk_size.to_bytes(2, byteorder='little')
+        )
+        if res[1] != report_const.OK:
+            raise RuntimeError("CDC bench error.")
+
+        # Exact size, without the padding byte of write_serial(): the test reads NB_BYTES
+        start = time.perf_counter()
+        received = None
+        if mode == "sink":
+            self._serial.write(data)
+            self._serial.flush()
+        elif mode == "source":
+            received = self._serial.read(nb_bytes)
+        else:
+            # Written while reading, the echo stops when the host does not read
+            writer = threading.Thread(target=lambda: (self._serial.write(data), self._serial.flush()))
+            writer.start()
+            received = self._serial.read(nb_bytes)
+            writer.join()
+        res = self.read_hid(report_id)
+        host_elapsed = time.perf_counter() - start
+        if res[1] != report_const.OK:
+            raise RuntimeError("CDC bench error.")
+
+        elapsed_us = int.from_bytes(res[2:6], byteorder='little')
+        result = {
+            "elapsed_us": elapsed_us,
+            "nb_bytes": int.from_bytes(res[6:10], byteorder='little'),
+            "bytes_per_s": nb_bytes * 1e6 / elapsed_us if elapsed_us else 0.0,
+            "stalls": int.from_bytes(res[10:14], byteorder='little'),
+            "stall_us": int.from_bytes(res[14:18], byteorder='little'),
+            "max_stall_us": int.from_bytes(res[18:22], byteorder='little'),
+            "host_elapsed_s": host_elapsed,
+        }
+        if received is not None:
+            result["data_ok"] = bytes(received) == data
+        return result
+
+    def record_start(self, path):
+        """Record the HID reports and CDC data sent from now on to path, for machine.replay. See record.py."""
+        from . import record
+
+        self.record_stop()
+        self._recorder = record.Recorder(path)
+        self._hid = record.RecordingHid(self._hid, self._recorder)
+        self._serial = record.RecordingSerial(self._serial, self._recorder)
+        atexit.register(self.record_stop)
+
+    def record_stop(self):
+        if self._recorder is None:
+            return
+        self._hid = self._hid.wrapped
+        self._serial = self._serial.wrapped
+        self._recorder.close()
+        self._recorder = None
+        atexit.unregister(self.record_stop)
+
+    def _trace_ctrl(self, enable):
+        res = self.send_report(bytes([report_const.SYS_TRACE_CTRL, 1 if enable else 0]))
+        if res[1] != report_const.OK:
+            raise RuntimeError("Trace error.")
+        return {
+            "size": int.from_bytes(res[2:6], byteorder='little'),
+            "level": int.from_bytes(res[6:10], byteorder='little'),
+            "dropped_events": int.from_bytes(res[10:14], byteorder='little'),
+        }
+
+    def trace_start(self):
+        """Clear the firmware events trace and start recording."""
+        return self._trace_ctrl(True)
+
+    def trace_stop(self):
+        """Stop recording, the recorded events are kept for read_trace()."""
+        return self._trace_ctrl(False)
+
+    def read_trace(self):
+        """Drain the firmware events trace: list of dict (time_us, type, id, arg), oldest first. See trace.py."""
+        events = []
+        while True:
+            res = self.send_report(bytes([report_const.SYS_TRACE_READ]))
+            if res[1] != report_const.OK:
+                raise RuntimeError("Trace read error.")
+            nb_events = res[2]
+            for it in range(nb_events):
+                event = res[7 + it * 8:15 + it * 8]
+                events.append({
+                    "time_us": int.from_bytes(event[0:4], byteorder='little'),
+                    "type": event[4],
+                    "id": event[5],
+                    "arg": int.from_bytes(event[6:8], byteorder='little'),
+                })
+            if nb_events == 0:
+                return events
+
+    def _store_tagged_response(self, res):
+        # Untagged responses are lost as in read_hid()
+        if res[0] == report_const.SYS_TAGGED and res[1] in self._tagged_responses:
+            self._tagged_responses[res[1]].append(bytes(res[2:]) + b"\0\0")
+
+    def program_memory(self, report, data, progress=None):
+        """Send a xxx_MEM_PROGRAM command and its data on CDC, the pages being programmed by the firmware.
+
+        progress(nb_bytes_done) is called on each progress report. Returns the number of bytes programmed,
+        RuntimeError on error.
+        """
+        report_id = report[0]
+        res = self.send_report(report)
+        if res[1] != report_const.OK:
+            raise RuntimeError("Memory program error.")
+        writer = None
+        if data:
+            # Written while the progress reports are read
+            writer = threading.Thread(target=self.write_serial, args=(bytes(data),))
+            writer.start()
+        res = self.read_hid(report_id)
+        while res[1] == report_const.PROGRESS:
+            if progress is not None:
+                progress(int.from_bytes(res[2:6], byteorder='little'))
+            res = self.read_hid(report_id)
+        if writer is not None:
+            writer.join()
+        nb_done = int.from_bytes(res[2:6], byteorder='little')
+        if res[1] != report_const.OK:
+            reason = {1: "bus error", 2: "busy timeout", 3: "verify error"}.get(res[6], "error")
+            raise RuntimeError("Memory program %s after %d bytes." % (reason, nb_done))
+        return nb_done
+
     def read_hid(self, report_id):
         res = self._hid.read(report_const.HID_REPORT_SIZE)
         while res[0] != report_id:
             # self._report_events_list.append(res)
+            self._store_tagged_response(res)
             res = self._hid.read(report_const.HID_REPORT_SIZE)
         return res
 
@@ -88,6 +399,9 @@ class Device(metaclass=helper.Singleton):
             self._serial.write([0])
         self._serial.flush()
 
+    def read_serial(self, size):
+        return self._serial.read(size)
+
     def process_irq(self):
         res = self.send_report(bytes([report_const.GPIO_GET_IRQ]))
         if res[1] != report_const.OK:
@@ -107,14 +421,14 @@ class Device(metaclass=helper.Singleton):
         if gpio in self._irq_event_callbacks:
             del self._irq_event_callbacks[gpio]
 
-    # def _get_serial_number(self):
-    #     response = self.send_report(bytes([report_const.SYS_GET_SN]))
-    #     if response[1] != report_const.OK:
-    #         raise RuntimeError("Retrieve S/N error.")
-    #     sn = "0x"
-    #     for i in range(2,2+8):
-    #         sn += "{0:02X}".format(response[i])
-    #     return sn
+    def _get_serial_number(self):
+        response = self.send_report(bytes([report_const.SYS_GET_SN]))
+        if response[1] != report_const.OK:
+            raise RuntimeError("Retrieve S/N error.")
+        sn = "0x"
+        for i in range(2,2+8):
+            sn += "{0:02X}".format(response[i])
+        return sn
 
     def _get_firmware_version(self):
         response = self.send_report(bytes([report_const.SYS_GET_VN]))